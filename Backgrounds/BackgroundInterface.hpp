@@ -4,6 +4,11 @@
  * This defines a standard Interface for Backgrounds; these are classes that
  * know how to draw specialised backdrops. Done generically for re-use.
  *
+ * As with states, render_interpolated() lets a background draw part way
+ * between simulation steps; by default it just calls render().
+ *
+ * Backgrounds live in the arena (see blitarena.hpp), not the heap.
+ *
  * Copyright (C) 2021 Pete Favelle <pete@fsquared.co.uk>
  *
  * This file is released under the MIT License; see LICENSE for more details.
@@ -12,15 +17,20 @@
 #ifndef   _BACKGROUNDINTERFACE_HPP_
 #define   _BACKGROUNDINTERFACE_HPP_
 
+#include "blitarena.hpp"
+
 
 /* Interfaces. */
 
 class BackgroundInterface
 {
 public:
+  BLITARENA_OBJECT
+
   virtual        ~BackgroundInterface() {};
   virtual void    update( uint32_t ) = 0;
   virtual void    render( uint32_t ) = 0;
+  virtual void    render_interpolated( uint32_t p_time, float p_alpha ) { render( p_time ); };
   virtual void    init( void ) = 0;
   virtual void    fini( void ) = 0;
 };
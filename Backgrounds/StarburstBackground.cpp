@@ -11,15 +11,26 @@
 
 /* System headers. */
 
+#include <math.h>
 
 /* Local headers. */
 
 #include "32blit.hpp"
+#include "blitroids.hpp"
+#include "blitarena.hpp"
 #include "StarburstBackground.hpp"
+#include "AssetManager.hpp"
 
 
 /* Module variables. */
 
+/* Stars are all the one colour; being edge particles, the engine fades */
+/* them in by how far they are from the origin.                         */
+static const blit::Pen m_starburst_ramp[] =
+{
+  blit::Pen( 200, 200, 200, 255 )
+};
+
 
 /* Functions. */
 
@@ -27,14 +38,40 @@
  * StarburstBackground - constructor for the background, setting defaults.
  */
 
-StarburstBackground::StarburstBackground( uint8_t p_velocity, uint16_t p_density )
+StarburstBackground::StarburstBackground( uint8_t p_velocity, uint32_t p_density )
 {
+  particle_emitter_t  l_emitter;
+
+  /* The stars burst out in every direction at the same speed, and */
+  /* slow down as they near the edge they're heading for.          */
+  c_velocity = p_velocity;
+  l_emitter.origin = blit::Vec2( 0.0f, 0.0f );
+  l_emitter.rate = 0.0f;
+  l_emitter.heading = 0;
+  l_emitter.spread = 360;
+  l_emitter.speed_min = l_emitter.speed_max = c_velocity / 5.0f;
+  l_emitter.life_min = 1;
+  l_emitter.life_max = UINT16_MAX;
+  l_emitter.drag = 1.0f;
+  l_emitter.ramp = m_starburst_ramp;
+  l_emitter.ramp_size = sizeof( m_starburst_ramp ) / sizeof( blit::Pen );
+  l_emitter.flags = PARTICLE_EDGE;
+
+  /* Without room in the arena for the engine there are no stars at all, */
+  /* and usable() says so; whoever made us shouldn't go any further.      */
+  c_particles = new ParticleEngine( p_density, blit::screen.clip );
+  if ( nullptr == c_particles )
+  {
+    return;
+  }
+  c_emitter = c_particles->add_emitter( &l_emitter );
+  c_density = c_particles->get_capacity();
+
   /* Default to the origin being the center of the screen. */
   set_origin( blit::screen.clip.center() );
 
-  /* And a sensible density and velocity for the star field. */
-  c_velocity = p_velocity;
-  set_density( p_density, true );
+  /* The starfield starts empty; prepare() fills it, before it's used. */
+  restart();
 
   /* All done. */
   return;
@@ -47,12 +84,9 @@ StarburstBackground::StarburstBackground( uint8_t p_velocity, uint16_t p_density
 
 StarburstBackground::~StarburstBackground()
 {
-  /* If we have any stars allocated, delete them. */
-  if ( nullptr != c_stars )
-  {
-    free( c_stars );
-    c_stars = nullptr;
-  }
+  /* The particle engine holds all the stars. */
+  delete c_particles;
+  c_particles = nullptr;
 
   /* All done. */
   return;
@@ -67,13 +101,18 @@ StarburstBackground::~StarburstBackground()
 
 void StarburstBackground::set_origin( blit::Point p_origin )
 {
+  particle_emitter_t *l_emitter = c_particles->get_emitter( c_emitter );
+
   /* Save the new origin, clamped to the screen. */
   c_origin = blit::screen.clip.clamp( p_origin );
+  if ( nullptr != l_emitter )
+  {
+    l_emitter->origin = blit::Vec2( c_origin.x, c_origin.y );
+  }
 
-  /* And calculate the distances to the corners, for vector factoring. */
-  c_tl_distance = c_origin;
-  c_br_distance.x = blit::screen.bounds.w - c_origin.x;
-  c_br_distance.y = blit::screen.bounds.h - c_origin.y;
+  /* Star lifetimes depend on the distance to the edges, so the spawn */
+  /* rate does too.                                                   */
+  retune();
 
   /* All done. */
   return;
@@ -83,39 +122,151 @@ void StarburstBackground::set_origin( blit::Point p_origin )
 /*
  * set_density - (re)sets the target number of stars to be rendered.
  *
- * uint16_t - the new star density
+ * uint32_t - the new star density
+ */
+
+void StarburstBackground::set_density( uint32_t p_density, bool p_preload )
+{
+  /* The pool is the star field; if it can't be resized, we keep */
+  /* whatever we had.                                             */
+  if ( !c_particles->resize( p_density ) )
+  {
+    return;
+  }
+
+  /* Save the new density; if we've shrunk, the stars past the end are */
+  /* simply dropped, and whatever we last drew is forgotten.           */
+  c_density = p_density;
+
+  /* The spawn rate depends on the density, so needs working out again. */
+  retune();
+
+  /* And if we've been asked to pre-load, fill the starfield straight */
+  /* away to avoid the awkward opening blankness.                     */
+  if ( p_preload )
+  {
+    preload();
+  }
+}
+
+
+/*
+ * set_backdrop - sets a pre-composed layer to restore the screen from, in
+ *                place of clearing it; it must match the screen exactly.
+ *                Anything in it besides the backdrop is taken to sit above
+ *                the stars, and the caller must put it back over them.
+ *
+ * blit::Surface * - the layer, or nullptr to go back to clearing.
+ */
+
+void StarburstBackground::set_backdrop( blit::Surface *p_backdrop )
+{
+  /* Only accept a layer we can copy straight from. */
+  if ( ( nullptr != p_backdrop ) && 
+       ( ( p_backdrop->bounds.w != blit::screen.bounds.w ) ||
+         ( p_backdrop->bounds.h != blit::screen.bounds.h ) ||
+         ( p_backdrop->format != blit::screen.format ) ) )
+  {
+    p_backdrop = nullptr;
+  }
+  c_backdrop = p_backdrop;
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * retune - recalculates the spawn rate, so that the steady state population
+ *          of the starfield matches the requested density. The engine works
+ *          out the mean star lifetime over every heading for us.
  */
 
-void StarburstBackground::set_density( uint16_t p_density, bool p_preload )
+void StarburstBackground::retune( void )
 {
-  uint16_t  l_index;
+  particle_emitter_t *l_emitter = c_particles->get_emitter( c_emitter );
+  float               l_mean, l_longest;
 
-  /* We'll just (re) allocate the star array for this to start. */
-  c_stars = (_star_t *)realloc( c_stars, p_density * sizeof( _star_t ) );
-  if ( nullptr == c_stars )
+  if ( nullptr == l_emitter )
   {
-    /* Memory allocation has failed, we can't proceed. */
     return;
   }
 
-  /* Any new stars, need zeroing. */
-  for( l_index = c_density; l_index < p_density; l_index++ )
+  /* Stars that never leave would eventually fill the field anyway. */
+  l_emitter->life_max = UINT16_MAX;
+  if ( !c_particles->lifetimes( c_emitter, &l_mean, &l_longest ) || ( l_mean <= 0.0f ) )
   {
-    c_stars[l_index].visible = false;
+    l_emitter->rate = 0.0f;
+    return;
   }
 
-  /* Save the new density. */
-  c_density = p_density;
+  /* Population = rate * mean lifetime, so that's our rate; nothing */
+  /* lives longer than the longest, which bounds the preload.       */
+  l_emitter->rate = c_density / l_mean;
+  l_emitter->life_max = ceilf( l_longest );
 
-  /* And if we've been asked to pre-load, run <density> updates to pre-fill */
-  /* the starfield and avoid the awkward opening blankness.                 */
-  if ( p_preload )
+  /* All done. */
+  return;
+}
+
+
+/*
+ * preload - fills the starfield in one pass, as if it had been running for
+ *           long enough to reach its steady state.
+ */
+
+void StarburstBackground::preload( void )
+{
+  /* Start from empty, and do the lot in one go. */
+  restart();
+  c_particles->prewarm( c_emitter, &c_prepare_star, UINT32_MAX );
+  c_preparing = false;
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * restart - empties the starfield, ready for prepare() to fill it again.
+ */
+
+void StarburstBackground::restart( void )
+{
+  c_particles->clear();
+  c_prepare_star = 0;
+  c_preparing = true;
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * prepare - fills the starfield after a restart(), a chunk at a time, until
+ *           it's full or the deadline passes; call it again to carry on.
+ *
+ * uint32_t - the deadline, in blit::now_us() terms.
+ *
+ * Returns bool, true if the starfield is full.
+ */
+
+bool StarburstBackground::prepare( uint32_t p_deadline )
+{
+  while ( c_preparing )
   {
-    for( l_index = 0; l_index < p_density; l_index++ )
+    if ( c_particles->prewarm( c_emitter, &c_prepare_star, STARBURST_PREPARE_CHUNK ) )
     {
-      update(0);
+      c_preparing = false;
+      return true;
+    }
+    if ( deadline_passed( p_deadline ) )
+    {
+      return false;
     }
   }
+
+  return true;
 }
 
 
@@ -127,85 +278,46 @@ void StarburstBackground::set_density( uint16_t p_density, bool p_preload )
 
 void StarburstBackground::update( uint32_t p_time )
 {
-  uint16_t  l_index;
-  uint16_t  l_new_stars = ( c_density / ( 100 * c_density ) ) + 1;
-  float     l_dx, l_dy;
+  /* The engine brings new stars to life, moves everyone along, and */
+  /* drops any that have fallen off the edge.                        */
+  c_particles->update();
 
-  /* Scan through all the stars. */
-  for ( l_index = 0; l_index < c_density; l_index++ )
-  {
-    /* If the star isn't visible, and we haven't hit our threshold of new */
-    /* ones, then set it to the origin and randomise vector / colour.     */
-    if ( ( !c_stars[l_index].visible ) && ( l_new_stars > 0 ) )
-    {
-      /* Make it visible and start at our location. */
-      c_stars[l_index].visible = true;
-      c_stars[l_index].location.x = c_origin.x;
-      c_stars[l_index].location.y = c_origin.y;
+  /* All done. */
+  return;
+}
 
-      /* Randomize our colour; we need to be bright, probably. */
-      c_stars[l_index].colour.r = 200 ; //+ ( blit::random() % 50 );
-      c_stars[l_index].colour.g = 200 ; //+ ( blit::random() % 50 );
-      c_stars[l_index].colour.b = 200 ; //+ ( blit::random() % 50 );
 
-      /* Set the vector to straight up at our main velocity. */
-      c_stars[l_index].vector = blit::Vec2( 0, c_velocity / 10.0f );
+/*
+ * render - called every frame (20ms) to draw our internal state to the screen!
+ *
+ * uint32_t - the time in milliseconds since the epoch.
+ */
 
-      /* And rotate it a random amount. */
-      c_stars[l_index].vector.rotate( ( blit::random() % 360 ) * MY_PI / 180.0f );
+void StarburstBackground::render( uint32_t p_time )
+{
+  /* Without any interpolation, we just draw where the stars are now. */
+  render_interpolated( p_time, 1.0f );
 
-      /* Lastly, keep track of new stars we've made. */
-      l_new_stars--;
-    }
+  /* All done. */
+  return;
+}
 
-    /* For each visible star, update it's location. */
-    if ( c_stars[l_index].visible )
-    {
-      /* Work out how far we are from the origin. */
-      if ( c_stars[l_index].vector.x < 0 )
-      {
-        l_dx = ( c_tl_distance.x + c_stars[l_index].location.x ) / c_tl_distance.x;
-      }
-      else
-      {
-        l_dx = ( c_br_distance.x * 2 + c_origin.x - c_stars[l_index].location.x ) / c_br_distance.x;
-      }
-      if ( c_stars[l_index].vector.y < 0 )
-      {
-        l_dy = ( c_tl_distance.y + c_stars[l_index].location.y ) / c_tl_distance.y;
-      }
-      else
-      {
-        l_dy = ( c_br_distance.y * 2 + c_origin.y - c_stars[l_index].location.y ) / c_br_distance.y;
-      }
-
-      /* Move it. */
-      c_stars[l_index].location.x += c_stars[l_index].vector.x * l_dx;
-      c_stars[l_index].location.y += c_stars[l_index].vector.y * l_dy;
-
-      /* The alpha is tempered by the proximity to the origin. */
-      if ( l_dx > 1.7f && l_dy > 1.7f )
-      {
-        if ( l_dx > l_dy )
-        {
-          c_stars[l_index].colour.a = 50 + ( 2.0f - l_dx ) * 1000.0f;
-        }
-        else
-        {
-          c_stars[l_index].colour.a = 50 + ( 2.0f - l_dy ) * 1000.0f;
-        }
-      }
-      else
-      {
-        c_stars[l_index].colour.a = 255;
-      }
-
-      /* And see if we've dropped off the screen. If so, we become invisible. */
-      if ( !blit::screen.clip.contains( c_stars[l_index].location ) )
-      {
-        c_stars[l_index].visible = false;
-      }
-    }
+
+/*
+ * backdrop - fills the clipped area with the backdrop, from the layer if we
+ *            have one or with a plain clear if not.
+ */
+
+void StarburstBackground::backdrop( void )
+{
+  if ( nullptr != c_backdrop )
+  {
+    AssetManager::copy_surface( c_backdrop, blit::screen.clip );
+  }
+  else
+  {
+    blit::screen.pen = STARBURST_BACKDROP;
+    blit::screen.clear();
   }
 
   /* All done. */
@@ -214,35 +326,103 @@ void StarburstBackground::update( uint32_t p_time )
 
 
 /*
- * render - called every frame (20ms) to draw our internal state to the screen!
+ * render_interpolated - draws the stars part way between their previous
+ *                       and current locations.
  *
  * uint32_t - the time in milliseconds since the epoch.
+ * float    - how far from the previous location to the current (0.0 - 1.0)
  */
 
-void StarburstBackground::render( uint32_t p_time )
+void StarburstBackground::render_interpolated( uint32_t p_time, float p_alpha )
 {
-  uint16_t  l_index;
-
   /* Clear the screen. */
-  blit::screen.pen = blit::Pen( 10, 10, 40 );
-  blit::screen.clear();
+  backdrop();
 
-  /* Work though all our stars, rendering all the visible ones. */
-  for ( l_index = 0; l_index < c_density; l_index++ )
-  {
-    /* Only worry about visible ones. */
-    if ( !c_stars[l_index].visible )
-    {
-      continue;
-    }
+  /* Then work out where the stars are, and draw them. */
+  c_particles->locate( p_alpha );
+  c_particles->draw( blit::screen );
 
-    /* So, switch to the pen. */
-    blit::screen.pen = c_stars[l_index].colour;
+  /* All done. */
+  return;
+}
+
+
+/*
+ * render_dirty - redraws only the stars, assuming the screen still holds
+ *                our last render; old stars are painted over with the
+ *                backdrop, and every pixel touched is added to the region
+ *                so that anything drawn over us can be put back. If there
+ *                is a backdrop layer, old stars are restored from it, and
+ *                only the new locations need reporting.
+ *
+ *                The new star locations are also reset to the plain backdrop
+ *                before drawing, so the stars blend exactly as they would
+ *                onto a freshly cleared screen.
+ *
+ * float         - how far from the previous location to the current.
+ * DirtyRegion * - the region to record the touched pixels in.
+ */
+
+void StarburstBackground::render_dirty( float p_alpha, DirtyRegion *p_dirty )
+{
+  /* Paint out wherever we drew last time. */
+  c_particles->erase( c_backdrop, STARBURST_BACKDROP, p_dirty );
 
-    /* And draw a pixel! */
-    blit::screen.pixel( c_stars[l_index].location );
+  /* Work out the new locations; these may have landed on something */
+  /* other than backdrop (the logo, say) so reset them too.          */
+  c_particles->locate( p_alpha );
+  c_particles->erase( nullptr, STARBURST_BACKDROP, p_dirty );
+
+  /* And then draw them. */
+  c_particles->draw( blit::screen );
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * draw_interpolated - adds the backdrop, and the stars part way between their
+ *                     previous and current locations, to a draw list.
+ *
+ * DrawList * - the list to draw into.
+ * float      - how far from the previous location to the current (0.0 - 1.0)
+ */
+
+void StarburstBackground::draw_interpolated( DrawList *p_list, float p_alpha )
+{
+  /* Work out where the stars are, and then draw it all. */
+  c_particles->locate( p_alpha );
+  draw_region( p_list );
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * draw_region - adds the backdrop and stars to a draw list, with the stars
+ *               where the last render put them; replaying the list within a
+ *               clip redraws just that area.
+ *
+ * DrawList * - the list to draw into.
+ */
+
+void StarburstBackground::draw_region( DrawList *p_list )
+{
+  /* The backdrop, from the layer if we have one... */
+  if ( nullptr != c_backdrop )
+  {
+    p_list->copy( c_backdrop );
+  }
+  else
+  {
+    p_list->clear( STARBURST_BACKDROP );
   }
 
+  /* ...and the stars; the batch drops anything outside the clip. */
+  c_particles->draw( p_list );
+
   /* All done. */
   return;
 }
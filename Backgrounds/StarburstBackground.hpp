@@ -6,6 +6,10 @@
  * By default the origin is the center of the screen, but this can be
  * configured along with the star density and speed.
  *
+ * The stars are just one emitter's worth of particles in a ParticleEngine;
+ * the background sets the emitter's rate so that the field holds a steady
+ * population, and looks after the backdrop the stars are drawn over.
+ *
  * Copyright (C) 2021 Pete Favelle <pete@fsquared.co.uk>
  *
  * This file is released under the MIT License; see LICENSE for more details.
@@ -16,47 +20,66 @@
 
 #include "32blit.hpp"
 #include "BackgroundInterface.hpp"
+#include "DirtyRegion.hpp"
+#include "DrawList.hpp"
+#include "ParticleEngine.hpp"
 
 
 /* Constants & Macros. */
 
-#define   MY_PI    3.141592653f
+#define   STARBURST_BACKDROP    blit::Pen( 10, 10, 40 )
+
+/* How many stars a prepare() slice places between looking at the clock. */
+#define   STARBURST_PREPARE_CHUNK 64
 
 
 /* Enums. */
 
 /* Structs. */
 
-typedef struct 
-{
-  bool        visible;
-  blit::Vec2  location;
-  blit::Vec2  vector;
-  blit::Pen   colour;
-} _star_t;
-
-
 /* Classes. */
 
 class StarburstBackground : public BackgroundInterface
 {
 private:
   blit::Point     c_origin;
-  uint16_t        c_density = 0;
-  uint8_t         c_velocity;
-  _star_t        *c_stars = nullptr;
-  blit::Point     c_tl_distance;
-  blit::Point     c_br_distance;
+  uint32_t        c_density = 0;
+  uint8_t         c_velocity = 0;
+
+  /* The stars are particles from a single edge emitter, in a pool */
+  /* sized to the density.                                         */
+  ParticleEngine *c_particles = nullptr;
+  uint8_t         c_emitter = PARTICLE_NO_EMITTER;
+
+  /* An optional pre-composed layer to restore instead of clearing. */
+  blit::Surface  *c_backdrop = nullptr;
+
+  /* How far through filling the starfield a prepare() has got. */
+  uint32_t        c_prepare_star = 0;
+  bool            c_preparing = false;
+
+  void            retune( void );
+  void            preload( void );
+  void            backdrop( void );
   
 public:
-                  StarburstBackground( uint8_t p_velocity = 5, uint16_t p_density = 200 );
+                  StarburstBackground( uint8_t p_velocity = 5, uint32_t p_density = 200 );
                  ~StarburstBackground();
 
   void            set_origin( blit::Point );
-  void            set_density( uint16_t, bool p_preload = false );
+  void            set_density( uint32_t, bool p_preload = false );
+  uint32_t        get_density( void ) { return c_density; };
+  bool            usable( void ) { return PARTICLE_NO_EMITTER != c_emitter; };
+  void            set_backdrop( blit::Surface * );
+  void            restart( void );
+  bool            prepare( uint32_t );
 
   void            update( uint32_t );
   void            render( uint32_t );
+  void            render_interpolated( uint32_t, float );
+  void            render_dirty( float, DirtyRegion * );
+  void            draw_interpolated( DrawList *, float );
+  void            draw_region( DrawList * );
   void            init( void );
   void            fini( void );
 
@@ -0,0 +1,365 @@
+/*
+ * HostPlatform.cpp - part of Blitroids, a 32Blit game.
+ *
+ * The HostPlatform stands in for the 32Blit hardware / SDL layer when we run
+ * the game code headless on a desktop; it provides a plain memory framebuffer
+ * for blit::screen, a deterministic clock and random source, plain stdio files
+ * and counts all the heap allocations made so we can spot code that churns
+ * memory.
+ *
+ * Copyright (C) 2021 Pete Favelle <pete@fsquared.co.uk>
+ *
+ * This file is released under the MIT License; see LICENSE for more details.
+ */
+
+/* System headers. */
+
+#include <atomic>
+#include <chrono>
+#include <new>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+
+
+/* Local headers. */
+
+#include "32blit.hpp"
+#include "engine/api_private.hpp"
+#include "blitrandom.hpp"
+#include "HostPlatform.hpp"
+
+
+/* Module variables. */
+
+static uint8_t                m_framebuffer[320 * 240 * 3];
+static uint32_t               m_random_state = HOST_RANDOM_SEED;
+
+/* The job system's workers can allocate at the same time as we do. */
+static std::atomic<uint32_t>  m_allocation_count( 0 );
+static std::atomic<uint64_t>  m_allocation_bytes( 0 );
+
+static std::chrono::steady_clock::time_point m_epoch;
+
+/*
+ * The engine reaches the platform through the API table; normally the SDL
+ * layer or the firmware fills this in, so headless we have to provide it.
+ */
+
+static blit::API    m_host_api;
+blit::API          &blit::api = m_host_api;
+
+
+/* Functions. */
+
+/*
+ * host_now - the API clock; milliseconds since we started.
+ */
+
+static uint32_t host_now( void )
+{
+  return std::chrono::duration_cast<std::chrono::milliseconds>(
+    std::chrono::steady_clock::now() - m_epoch ).count();
+}
+
+
+/*
+ * host_us_timer - the API microsecond timer.
+ */
+
+static uint32_t host_us_timer( void )
+{
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+    std::chrono::steady_clock::now() - m_epoch ).count();
+}
+
+
+/*
+ * host_random - the API random source; a fixed-seed xorshift, so that every
+ *               run generates exactly the same workload.
+ */
+
+static uint32_t host_random( void )
+{
+  m_random_state ^= m_random_state << 13;
+  m_random_state ^= m_random_state >> 17;
+  m_random_state ^= m_random_state << 5;
+  return m_random_state;
+}
+
+
+/*
+ * host_open_file - the API file opener; files are just stdio ones, relative
+ *                  to wherever we were run from.
+ *
+ * const std::string & - the path of the file.
+ * int                 - the blit::OpenMode flags.
+ *
+ * Returns void *, the FILE as a handle, or nullptr if it couldn't be opened.
+ */
+
+static void *host_open_file( const std::string &p_path, int p_mode )
+{
+  const char *l_mode = "rb";
+
+  if ( p_mode & blit::OpenMode::write )
+  {
+    l_mode = ( p_mode & blit::OpenMode::read ) ? "r+b" : "wb";
+  }
+
+  return fopen( p_path.c_str(), l_mode );
+}
+
+
+/*
+ * host_read_file - the API file reader.
+ */
+
+static int32_t host_read_file( void *p_handle, uint32_t p_offset, uint32_t p_length, char *p_buffer )
+{
+  if ( 0 != fseek( (FILE *)p_handle, p_offset, SEEK_SET ) )
+  {
+    return -1;
+  }
+  return fread( p_buffer, 1, p_length, (FILE *)p_handle );
+}
+
+
+/*
+ * host_write_file - the API file writer.
+ */
+
+static int32_t host_write_file( void *p_handle, uint32_t p_offset, uint32_t p_length, const char *p_buffer )
+{
+  if ( 0 != fseek( (FILE *)p_handle, p_offset, SEEK_SET ) )
+  {
+    return -1;
+  }
+  return fwrite( p_buffer, 1, p_length, (FILE *)p_handle );
+}
+
+
+/*
+ * host_close_file - the API file closer.
+ */
+
+static int32_t host_close_file( void *p_handle )
+{
+  return fclose( (FILE *)p_handle );
+}
+
+
+/*
+ * host_get_file_length - the API file sizer.
+ */
+
+static uint32_t host_get_file_length( void *p_handle )
+{
+  long  l_length;
+
+  fseek( (FILE *)p_handle, 0, SEEK_END );
+  l_length = ftell( (FILE *)p_handle );
+
+  return ( l_length > 0 ) ? l_length : 0;
+}
+
+
+/*
+ * host_get_save_path - the API save location; saves go alongside us.
+ */
+
+static const char *host_get_save_path( void )
+{
+  return "";
+}
+
+
+/*
+ * host_init - sets up the API table and a default hires screen.
+ */
+
+void host_init( void )
+{
+  /* Start the clock, and reset the random streams; ours and the game's. */
+  m_epoch = std::chrono::steady_clock::now();
+  m_random_state = HOST_RANDOM_SEED;
+  blitrandom_seed( HOST_RANDOM_SEED );
+
+  /* Fill in the bits of the API the game code can reach. */
+  m_host_api.now = host_now;
+  m_host_api.random = host_random;
+  m_host_api.get_us_timer = host_us_timer;
+  m_host_api.open_file = host_open_file;
+  m_host_api.read_file = host_read_file;
+  m_host_api.write_file = host_write_file;
+  m_host_api.close_file = host_close_file;
+  m_host_api.get_file_length = host_get_file_length;
+  m_host_api.get_save_path = host_get_save_path;
+
+  /* And give ourselves a screen to draw on. */
+  host_set_screen_mode( blit::ScreenMode::hires );
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * host_set_screen_mode - points blit::screen at our framebuffer, sized for
+ *                        the requested mode.
+ *
+ * blit::ScreenMode - the mode to emulate.
+ */
+
+void host_set_screen_mode( blit::ScreenMode p_mode )
+{
+  blit::Size  l_size( 320, 240 );
+
+  if ( blit::ScreenMode::lores == p_mode )
+  {
+    l_size = blit::Size( 160, 120 );
+  }
+
+  blit::screen = blit::Surface( m_framebuffer, blit::PixelFormat::RGB, l_size );
+  m_random_state = HOST_RANDOM_SEED;
+  blitrandom_seed( HOST_RANDOM_SEED );
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * host_screen_mode_name - a printable name for a screen mode.
+ *
+ * blit::ScreenMode - the mode to name.
+ *
+ * Returns const char *, the name.
+ */
+
+const char *host_screen_mode_name( blit::ScreenMode p_mode )
+{
+  return ( blit::ScreenMode::lores == p_mode ) ? "lores" : "hires";
+}
+
+
+/*
+ * host_reset_allocations - zeroes the allocation counters.
+ */
+
+void host_reset_allocations( void )
+{
+  m_allocation_count.store( 0, std::memory_order_relaxed );
+  m_allocation_bytes.store( 0, std::memory_order_relaxed );
+  return;
+}
+
+
+/*
+ * host_allocation_count - the number of heap allocations since the reset.
+ */
+
+uint32_t host_allocation_count( void )
+{
+  return m_allocation_count.load( std::memory_order_relaxed );
+}
+
+
+/*
+ * host_allocation_bytes - the number of bytes allocated since the reset.
+ */
+
+uint64_t host_allocation_bytes( void )
+{
+  return m_allocation_bytes.load( std::memory_order_relaxed );
+}
+
+
+/* Allocation counting. */
+
+/*
+ * On Linux the build wraps the C allocator with the linker, so that realloc
+ * and friends in the game code are counted; everywhere else we can only see
+ * operator new. Either way, new goes straight to the real allocator so it
+ * is only counted once.
+ */
+
+#ifdef    BENCH_WRAP_MALLOC
+
+extern "C"
+{
+  void *__real_malloc( size_t );
+  void *__real_calloc( size_t, size_t );
+  void *__real_realloc( void *, size_t );
+
+  void *__wrap_malloc( size_t p_size )
+  {
+    m_allocation_count.fetch_add( 1, std::memory_order_relaxed );
+    m_allocation_bytes.fetch_add( p_size, std::memory_order_relaxed );
+    return __real_malloc( p_size );
+  }
+
+  void *__wrap_calloc( size_t p_count, size_t p_size )
+  {
+    m_allocation_count.fetch_add( 1, std::memory_order_relaxed );
+    m_allocation_bytes.fetch_add( p_count * p_size, std::memory_order_relaxed );
+    return __real_calloc( p_count, p_size );
+  }
+
+  void *__wrap_realloc( void *p_pointer, size_t p_size )
+  {
+    m_allocation_count.fetch_add( 1, std::memory_order_relaxed );
+    m_allocation_bytes.fetch_add( p_size, std::memory_order_relaxed );
+    return __real_realloc( p_pointer, p_size );
+  }
+}
+
+#define HOST_RAW_MALLOC __real_malloc
+
+#else  /* BENCH_WRAP_MALLOC */
+
+#define HOST_RAW_MALLOC malloc
+
+#endif /* BENCH_WRAP_MALLOC */
+
+void *operator new( size_t p_size )
+{
+  void *l_pointer;
+
+  m_allocation_count.fetch_add( 1, std::memory_order_relaxed );
+  m_allocation_bytes.fetch_add( p_size, std::memory_order_relaxed );
+  l_pointer = HOST_RAW_MALLOC( p_size ? p_size : 1 );
+  if ( nullptr == l_pointer )
+  {
+    throw std::bad_alloc();
+  }
+  return l_pointer;
+}
+
+void *operator new[]( size_t p_size )
+{
+  return operator new( p_size );
+}
+
+void operator delete( void *p_pointer ) noexcept
+{
+  free( p_pointer );
+}
+
+void operator delete[]( void *p_pointer ) noexcept
+{
+  free( p_pointer );
+}
+
+void operator delete( void *p_pointer, size_t ) noexcept
+{
+  free( p_pointer );
+}
+
+void operator delete[]( void *p_pointer, size_t ) noexcept
+{
+  free( p_pointer );
+}
+
+
+/* End of file HostPlatform.cpp */
@@ -0,0 +1,38 @@
+/*
+ * HostPlatform.hpp - part of Blitroids, a 32Blit game.
+ *
+ * The HostPlatform stands in for the 32Blit hardware / SDL layer when we run
+ * the game code headless on a desktop; it provides a plain memory framebuffer
+ * for blit::screen, a deterministic clock and random source, plain stdio files
+ * and counts all the heap allocations made so we can spot code that churns
+ * memory.
+ *
+ * Copyright (C) 2021 Pete Favelle <pete@fsquared.co.uk>
+ *
+ * This file is released under the MIT License; see LICENSE for more details.
+ */
+
+#ifndef   _HOSTPLATFORM_HPP_
+#define   _HOSTPLATFORM_HPP_
+
+#include "32blit.hpp"
+
+
+/* Constants & Macros. */
+
+#define HOST_RANDOM_SEED  0x32b117
+
+/* Functions. */
+
+void      host_init( void );
+void      host_set_screen_mode( blit::ScreenMode );
+const char *host_screen_mode_name( blit::ScreenMode );
+
+void      host_reset_allocations( void );
+uint32_t  host_allocation_count( void );
+uint64_t  host_allocation_bytes( void );
+
+
+#endif /* _HOSTPLATFORM_HPP_ */
+
+/* End of file HostPlatform.hpp */
@@ -0,0 +1,553 @@
+/*
+ * blitbench.cpp - part of Blitroids, a 32Blit game.
+ *
+ * This is the headless benchmark; it drives the backgrounds, states and
+ * systems directly against the HostPlatform framebuffer, for a fixed number
+ * of ticks and frames across a sweep of densities and screen modes, and
+ * reports the cost of each in a machine-readable form (CSV or JSON) so
+ * that runs can be compared between commits. The densest starfields are
+ * also run over a sweep of worker threads, to show how the job system
+ * scales.
+ *
+ * Usage: blitroids-bench [--json] [--ticks <n>] [--frames <n>] [--threads <n>]
+ *
+ * Copyright (C) 2021 Pete Favelle <pete@fsquared.co.uk>
+ *
+ * This file is released under the MIT License; see LICENSE for more details.
+ */
+
+/* System headers. */
+
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+/* Local headers. */
+
+#include "32blit.hpp"
+#include "blitroids.hpp"
+#include "blitarena.hpp"
+#include "blitjobs.hpp"
+#include "blitrandom.hpp"
+#include "blittrig.hpp"
+
+#include "AssetManager.hpp"
+#include "StarburstBackground.hpp"
+#include "SplashState.hpp"
+#include "EntityPool.hpp"
+#include "CollisionGrid.hpp"
+#include "HostPlatform.hpp"
+
+
+/* Constants & Macros. */
+
+#define BENCH_DEFAULT_TICKS   1000
+#define BENCH_DEFAULT_FRAMES  500
+#define BENCH_WARMUP          100
+
+/* The collision fields are scattered from this, whatever ran before. */
+#define BENCH_COLLISION_SEED  0xc011de
+
+
+/* Structs. */
+
+typedef struct
+{
+  const char       *component;
+  const char       *screen_mode;
+  uint32_t          density;
+  uint32_t          ticks;
+  double            ns_per_tick;
+  uint32_t          frames;
+  double            ns_per_frame;
+  uint32_t          setup_allocations;
+  uint32_t          allocations;
+  uint64_t          allocated_bytes;
+  uint32_t          arena_high_water;
+  uint8_t           threads;
+} bench_result_t;
+
+
+/* Classes. */
+
+/*
+ * CollisionBench - a field of asteroids with bullets flying through them,
+ *                  collided each tick either through the CollisionGrid or
+ *                  by testing every pair; nothing is destroyed, so the
+ *                  population stays fixed for the whole run. There's
+ *                  nothing to render.
+ */
+
+class CollisionBench
+{
+private:
+  EntityPool     *c_asteroids;
+  EntityPool     *c_bullets;
+  CollisionGrid   c_grid;
+  bool            c_use_grid;
+  uint16_t       *c_found;
+  blit::Rect      c_field;
+  uint32_t        c_hits = 0;
+
+public:
+  BLITARENA_OBJECT
+
+                  CollisionBench( uint16_t, bool );
+                 ~CollisionBench();
+
+  void            update( uint32_t );
+  void            render( uint32_t ) {};
+};
+
+
+/* Module variables. */
+
+static uint32_t     m_ticks = BENCH_DEFAULT_TICKS;
+static uint32_t     m_frames = BENCH_DEFAULT_FRAMES;
+static bool         m_json = false;
+static uint8_t      m_threads = 0;
+static uint32_t     m_result_count = 0;
+
+static const blit::ScreenMode m_modes[] = { blit::ScreenMode::lores, blit::ScreenMode::hires };
+static const uint32_t         m_densities[] = { 200, 2000, 20000 };
+static const uint32_t         m_scaling_densities[] = { 100000, 200000 };
+static const uint8_t          m_scaling_threads[] = { 1, 2, 4, 8 };
+static const uint16_t         m_populations[] = { 10, 100, 250, 500, 1000, 2000 };
+
+
+/* Functions. */
+
+/*
+ * CollisionBench - constructor, which scatters the asteroids and bullets
+ *                  over the screen. They're placed from a fixed seed, so
+ *                  every run (and both ways of colliding them) starts
+ *                  from the same field.
+ *
+ * uint16_t - the number of asteroids; there's a bullet for every four.
+ * bool     - true to collide through the grid, false to test every pair.
+ */
+
+CollisionBench::CollisionBench( uint16_t p_count, bool p_use_grid )
+{
+  uint16_t    l_index;
+  blit::Vec2  l_velocity;
+
+  /* The asteroids are a fully broken-up mix; one large */
+  /* for every three medium and nine small.            */
+  c_field = blit::Rect( blit::Point( 0, 0 ), blit::screen.bounds );
+  c_grid.resize( c_field );
+  c_use_grid = p_use_grid;
+  c_asteroids = new EntityPool( p_count );
+  c_bullets = new EntityPool( p_count / 4 + 1 );
+  c_found = (uint16_t *)blitarena_alloc( p_count * sizeof( uint16_t ) );
+  blitrandom_seed( BENCH_COLLISION_SEED );
+  for ( l_index = 0; l_index < p_count; l_index++ )
+  {
+    l_velocity = g_trig_degrees.vector( blitrandom() % 360, 0.5f );
+    c_asteroids->create( blitrandom() % c_field.w, blitrandom() % c_field.h,
+                         l_velocity.x, l_velocity.y,
+                         ( l_index % 13 == 0 ) ? 16 : ( ( l_index % 13 < 4 ) ? 8 : 4 ) );
+  }
+  for ( l_index = 0; l_index < p_count / 4 + 1; l_index++ )
+  {
+    l_velocity = g_trig_degrees.vector( blitrandom() % 360, 3.0f );
+    c_bullets->create( blitrandom() % c_field.w, blitrandom() % c_field.h,
+                       l_velocity.x, l_velocity.y, 0 );
+  }
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * ~CollisionBench - destructor, cleans up anything we allocated.
+ */
+
+CollisionBench::~CollisionBench()
+{
+  blitarena_free( c_found );
+  delete c_asteroids;
+  delete c_bullets;
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * update - moves everything along, and then collides every bullet with the
+ *          asteroids; the hits are only counted, so nothing changes.
+ *
+ * uint32_t - the time in milliseconds since the epoch.
+ */
+
+void CollisionBench::update( uint32_t p_time )
+{
+  uint16_t  l_bullet, l_asteroid, l_found, l_index;
+  float    *l_ax = c_asteroids->get_x(), *l_ay = c_asteroids->get_y();
+  float    *l_bx = c_bullets->get_x(), *l_by = c_bullets->get_y();
+  uint8_t  *l_ar = c_asteroids->get_radius();
+
+  c_asteroids->move( c_field );
+  c_bullets->move( c_field );
+
+  /* Through the grid, just like the game does it. */
+  if ( c_use_grid )
+  {
+    c_grid.build( l_ax, l_ay, l_ar, c_asteroids->get_count() );
+    for ( l_bullet = 0; l_bullet < c_bullets->get_count(); l_bullet++ )
+    {
+      l_found = c_grid.query( l_bx[l_bullet], l_by[l_bullet], 0.0f, c_found, c_asteroids->get_count() );
+      for ( l_index = 0; l_index < l_found; l_index++ )
+      {
+        l_asteroid = c_found[l_index];
+        c_hits += c_grid.overlap( l_bx[l_bullet], l_by[l_bullet], 0.0f,
+                                  l_ax[l_asteroid], l_ay[l_asteroid], l_ar[l_asteroid] );
+      }
+    }
+    return;
+  }
+
+  /* Or every bullet against every asteroid. */
+  for ( l_bullet = 0; l_bullet < c_bullets->get_count(); l_bullet++ )
+  {
+    for ( l_asteroid = 0; l_asteroid < c_asteroids->get_count(); l_asteroid++ )
+    {
+      c_hits += c_grid.overlap( l_bx[l_bullet], l_by[l_bullet], 0.0f,
+                                l_ax[l_asteroid], l_ay[l_asteroid], l_ar[l_asteroid] );
+    }
+  }
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * bench_elapsed_ns - nanoseconds between two clock readings.
+ */
+
+static double bench_elapsed_ns( std::chrono::steady_clock::time_point p_start,
+                                std::chrono::steady_clock::time_point p_end )
+{
+  return std::chrono::duration<double, std::nano>( p_end - p_start ).count();
+}
+
+
+/*
+ * bench_run - runs a component through a warm-up, then the timed ticks and
+ *             frames. Ticks and frames are timed separately, interleaved
+ *             two ticks to a frame like the engine does.
+ *
+ * T *             - the component to drive; anything with update / render.
+ * bench_result_t  - the result to fill in.
+ */
+
+template <typename T>
+static void bench_run( T *p_component, bench_result_t &p_result )
+{
+  std::chrono::steady_clock::time_point l_start;
+  double    l_tick_ns = 0.0, l_frame_ns = 0.0;
+  uint32_t  l_tick = 0, l_frame = 0, l_time = 0;
+
+  /* Warm up, so preload effects and caches settle. */
+  for ( l_tick = 0; l_tick < BENCH_WARMUP; l_tick++, l_time += 10 )
+  {
+    p_component->update( l_time );
+  }
+
+  /* Then the measured run. */
+  host_reset_allocations();
+  for ( l_tick = 0, l_frame = 0; ( l_tick < m_ticks ) || ( l_frame < m_frames ); l_time += 10 )
+  {
+    if ( l_tick < m_ticks )
+    {
+      l_start = std::chrono::steady_clock::now();
+      p_component->update( l_time );
+      l_tick_ns += bench_elapsed_ns( l_start, std::chrono::steady_clock::now() );
+      l_tick++;
+    }
+    if ( ( l_frame < m_frames ) && ( 0 == ( l_time % 20 ) ) )
+    {
+      l_start = std::chrono::steady_clock::now();
+      p_component->render( l_time );
+      l_frame_ns += bench_elapsed_ns( l_start, std::chrono::steady_clock::now() );
+      l_frame++;
+    }
+  }
+
+  /* Save the results. */
+  p_result.ticks = m_ticks;
+  p_result.ns_per_tick = m_ticks ? l_tick_ns / m_ticks : 0.0;
+  p_result.frames = m_frames;
+  p_result.ns_per_frame = m_frames ? l_frame_ns / m_frames : 0.0;
+  p_result.allocations = host_allocation_count();
+  p_result.allocated_bytes = host_allocation_bytes();
+  p_result.arena_high_water = blitarena_high_water();
+  p_result.threads = blitjobs_workers();
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * bench_report - writes out a single result line, in the chosen format.
+ *
+ * bench_result_t - the result to output.
+ */
+
+static void bench_report( const bench_result_t &p_result )
+{
+  if ( m_json )
+  {
+    printf( "%s\n  { \"component\": \"%s\", \"screen_mode\": \"%s\", \"density\": %u, "
+            "\"ticks\": %u, \"ns_per_tick\": %.1f, \"frames\": %u, \"ns_per_frame\": %.1f, "
+            "\"setup_allocations\": %u, \"allocations\": %u, \"allocated_bytes\": %llu, "
+            "\"arena_high_water\": %u, \"threads\": %u }",
+            m_result_count ? "," : "[",
+            p_result.component, p_result.screen_mode, p_result.density,
+            p_result.ticks, p_result.ns_per_tick, p_result.frames, p_result.ns_per_frame,
+            p_result.setup_allocations, p_result.allocations,
+            (unsigned long long)p_result.allocated_bytes, p_result.arena_high_water,
+            p_result.threads );
+  }
+  else
+  {
+    if ( 0 == m_result_count )
+    {
+      printf( "component,screen_mode,density,ticks,ns_per_tick,frames,ns_per_frame,"
+              "setup_allocations,allocations,allocated_bytes,arena_high_water,threads\n" );
+    }
+    printf( "%s,%s,%u,%u,%.1f,%u,%.1f,%u,%u,%llu,%u,%u\n",
+            p_result.component, p_result.screen_mode, p_result.density,
+            p_result.ticks, p_result.ns_per_tick, p_result.frames, p_result.ns_per_frame,
+            p_result.setup_allocations, p_result.allocations,
+            (unsigned long long)p_result.allocated_bytes, p_result.arena_high_water,
+            p_result.threads );
+  }
+
+  m_result_count++;
+  return;
+}
+
+
+/*
+ * bench_starburst - sweeps the StarburstBackground over a set of densities.
+ *
+ * blit::ScreenMode - the screen mode we're running in.
+ * const char *     - the name to report it under.
+ * const uint32_t * - the densities to run at.
+ * uint8_t          - the number of densities.
+ */
+
+static void bench_starburst( blit::ScreenMode p_mode, const char *p_name,
+                             const uint32_t *p_densities, uint8_t p_count )
+{
+  StarburstBackground  *l_background;
+  bench_result_t        l_result;
+  uint32_t              l_density;
+
+  for ( ; p_count > 0; p_count--, p_densities++ )
+  {
+    l_density = *p_densities;
+
+    /* Set up the background, counting what it costs to create. */
+    host_set_screen_mode( p_mode );
+    host_reset_allocations();
+    l_background = new StarburstBackground( 5, l_density );
+    if ( ( nullptr == l_background ) || !l_background->usable() )
+    {
+      fprintf( stderr, "No room in the arena for %u stars; skipping\n", l_density );
+      delete l_background;
+      continue;
+    }
+    while ( !l_background->prepare( blit::now_us() + STATE_PREPARE_BUDGET_US ) );
+    l_background->init();
+
+    l_result.component = p_name;
+    l_result.screen_mode = host_screen_mode_name( p_mode );
+    l_result.density = l_density;
+    l_result.setup_allocations = host_allocation_count();
+
+    /* Run it, and report. */
+    bench_run( l_background, l_result );
+    bench_report( l_result );
+
+    l_background->fini();
+    delete l_background;
+  }
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * bench_scaling - runs the densest starfields again with each number of
+ *                 worker threads, so the per-tick cost shows how well the
+ *                 update spreads over them.
+ *
+ * blit::ScreenMode - the screen mode we're running in.
+ */
+
+static void bench_scaling( blit::ScreenMode p_mode )
+{
+  for ( uint8_t l_threads : m_scaling_threads )
+  {
+    blitjobs_init( l_threads );
+    bench_starburst( p_mode, "starburst_jobs", m_scaling_densities,
+                     sizeof( m_scaling_densities ) / sizeof( m_scaling_densities[0] ) );
+  }
+
+  /* Put the workers back as they were for everything else. */
+  blitjobs_init( m_threads );
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * bench_splash - runs the SplashState as a whole.
+ *
+ * blit::ScreenMode - the screen mode we're running in.
+ * AssetManager *   - the (shared) asset manager.
+ */
+
+static void bench_splash( blit::ScreenMode p_mode, AssetManager *p_asset_manager )
+{
+  SplashState      *l_state;
+  bench_result_t    l_result;
+
+  /* Set up the state, counting what it costs to create. */
+  host_set_screen_mode( p_mode );
+  host_reset_allocations();
+  l_state = new SplashState( STATE_SPLASH );
+  while ( !l_state->prepare( p_asset_manager, blit::now_us() + STATE_PREPARE_BUDGET_US ) );
+  l_state->init( nullptr, p_asset_manager, nullptr );
+
+  l_result.component = "splash";
+  l_result.screen_mode = host_screen_mode_name( p_mode );
+  l_result.density = 200;
+  l_result.setup_allocations = host_allocation_count();
+
+  /* Run it, and report. */
+  bench_run( l_state, l_result );
+  bench_report( l_result );
+
+  l_state->fini( nullptr );
+  delete l_state;
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * bench_collision - sweeps bullet-against-asteroid collisions over a range
+ *                   of populations, through the grid and pair by pair; the
+ *                   'density' is the number of asteroids, with a quarter
+ *                   as many bullets.
+ *
+ * blit::ScreenMode - the screen mode we're running in.
+ */
+
+static void bench_collision( blit::ScreenMode p_mode )
+{
+  CollisionBench   *l_bench;
+  bench_result_t    l_result;
+
+  for ( bool l_use_grid : { true, false } )
+  {
+    for ( uint16_t l_count : m_populations )
+    {
+      /* Set up the field, counting what it costs to create. */
+      host_set_screen_mode( p_mode );
+      host_reset_allocations();
+      l_bench = new CollisionBench( l_count, l_use_grid );
+
+      l_result.component = l_use_grid ? "collision_grid" : "collision_pairs";
+      l_result.screen_mode = host_screen_mode_name( p_mode );
+      l_result.density = l_count;
+      l_result.setup_allocations = host_allocation_count();
+
+      /* Run it, and report. */
+      bench_run( l_bench, l_result );
+      bench_report( l_result );
+
+      delete l_bench;
+    }
+  }
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * main - entry point; parses the arguments and runs the sweep.
+ */
+
+int main( int argc, char *argv[] )
+{
+  AssetManager *l_asset_manager;
+  int           l_arg;
+
+  /* Look at what we've been asked for. */
+  for ( l_arg = 1; l_arg < argc; l_arg++ )
+  {
+    if ( 0 == strcmp( argv[l_arg], "--json" ) )
+    {
+      m_json = true;
+    }
+    else if ( ( 0 == strcmp( argv[l_arg], "--ticks" ) ) && ( l_arg + 1 < argc ) )
+    {
+      m_ticks = strtoul( argv[++l_arg], nullptr, 10 );
+    }
+    else if ( ( 0 == strcmp( argv[l_arg], "--frames" ) ) && ( l_arg + 1 < argc ) )
+    {
+      m_frames = strtoul( argv[++l_arg], nullptr, 10 );
+    }
+    else if ( ( 0 == strcmp( argv[l_arg], "--threads" ) ) && ( l_arg + 1 < argc ) )
+    {
+      m_threads = strtoul( argv[++l_arg], nullptr, 10 );
+    }
+    else
+    {
+      fprintf( stderr, "Usage: %s [--json] [--ticks <n>] [--frames <n>] [--threads <n>]\n", argv[0] );
+      return 1;
+    }
+  }
+
+  /* Bring up the fake platform, and the assets the states need. */
+  host_init();
+  blitjobs_init( m_threads );
+  l_asset_manager = new AssetManager();
+
+  /* Run everything in every mode. */
+  for ( blit::ScreenMode l_mode : m_modes )
+  {
+    bench_starburst( l_mode, "starburst", m_densities, sizeof( m_densities ) / sizeof( m_densities[0] ) );
+    bench_splash( l_mode, l_asset_manager );
+    bench_collision( l_mode );
+  }
+
+  /* And see how the densest starfield scales, at full resolution. */
+  bench_scaling( blit::ScreenMode::hires );
+
+  /* Close off the JSON array, if we're doing that. */
+  if ( m_json && m_result_count )
+  {
+    printf( "\n]\n" );
+  }
+
+  delete l_asset_manager;
+  return 0;
+}
+
+
+/* End of file blitbench.cpp */
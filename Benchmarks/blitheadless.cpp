@@ -0,0 +1,348 @@
+/*
+ * blitheadless.cpp - part of Blitroids, a 32Blit game.
+ *
+ * This is the headless runner; it drives the whole game, through the same
+ * init / update / render entry points the engine uses, against the
+ * HostPlatform framebuffer. The clock advances by exactly one simulation
+ * step per tick, and update() is called in a tight loop, so the game runs
+ * as fast as the CPU allows; rendering is off unless asked for, and then
+ * only every so many ticks, with each frame rendered hashed so that runs
+ * can be checked against each other. It needs no window, so it runs on
+ * any CI box.
+ *
+ * Input comes from a recorded log with --replay; otherwise, the buttons
+ * are mashed at random (from the host's fixed seed), so that the game gets
+ * played rather than sitting on the splash screen.
+ *
+ * Frames are drawn in as many bands as there are workers, unless --bands
+ * says otherwise. With --verify-bands, every frame is rendered in full
+ * twice over a scribbled screen, banded and then in a single band, and the
+ * two hashes compared; any that differ are reported, and the run fails.
+ *
+ * With --expect-digest, the run also fails unless the digest of all the
+ * frames comes out as given; replaying a checked-in log against its known
+ * digest makes a regression test of the whole game.
+ *
+ * Usage: blitroids-headless [--ticks <n>] [--render-every <k>]
+ *                           [--replay <log>] [--hashes] [--threads <n>]
+ *                           [--bands <n>] [--verify-bands]
+ *                           [--expect-digest <hex>]
+ *
+ * Copyright (C) 2021 Pete Favelle <pete@fsquared.co.uk>
+ *
+ * This file is released under the MIT License; see LICENSE for more details.
+ */
+
+/* System headers. */
+
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+/* Local headers. */
+
+#include "32blit.hpp"
+#include "blitroids.hpp"
+#include "blitarena.hpp"
+#include "blitjobs.hpp"
+
+#include "DrawList.hpp"
+#include "PerfManager.hpp"
+#include "HostPlatform.hpp"
+
+
+/* Constants & Macros. */
+
+#define HEADLESS_DEFAULT_TICKS  100000
+#define HEADLESS_HOLD_TICKS     25
+
+#define HEADLESS_FNV_BASIS      0xcbf29ce484222325ull
+#define HEADLESS_FNV_PRIME      0x100000001b3ull
+
+/* What the screen is filled with before a verifying render, so that any */
+/* pixel a band misses shows up.                                         */
+#define HEADLESS_SCRIBBLE       0xa5
+
+
+/* Module variables. */
+
+static uint32_t     m_ticks = HEADLESS_DEFAULT_TICKS;
+static uint32_t     m_render_every = 0;
+static const char  *m_replay_path = nullptr;
+static bool         m_print_hashes = false;
+static uint8_t      m_threads = 0;
+static uint8_t      m_bands = 0;
+static bool         m_verify_bands = false;
+static bool         m_check_digest = false;
+static uint64_t     m_expected_digest = 0;
+
+static const char  *m_state_names[STATE_MAX] = { "none", "splash", "game", "death", "hiscore", "menu" };
+static const char  *m_phase_names[PERF_MAX] = { "update", "render", "transition" };
+
+/* Only the buttons that play the game get mashed; not the menu, say. */
+static const uint32_t m_mash_buttons[] =
+{
+  blit::Button::DPAD_LEFT, blit::Button::DPAD_RIGHT, blit::Button::DPAD_UP, blit::Button::A
+};
+
+
+/* Functions. */
+
+/*
+ * headless_hash - hashes whatever is on the screen, FNV-1a style.
+ *
+ * Returns uint64_t, the hash.
+ */
+
+static uint64_t headless_hash( void )
+{
+  uint64_t        l_hash = HEADLESS_FNV_BASIS;
+  const uint8_t  *l_byte = blit::screen.data;
+  const uint8_t  *l_end = l_byte + blit::screen.bounds.w * blit::screen.bounds.h * blit::screen.pixel_stride;
+
+  while ( l_byte < l_end )
+  {
+    l_hash = ( l_hash ^ *l_byte++ ) * HEADLESS_FNV_PRIME;
+  }
+
+  return l_hash;
+}
+
+
+/*
+ * headless_scribble - fills the screen with rubbish, and has the game draw
+ *                     its next frame in full, so that any pixel it misses
+ *                     shows up in the hash.
+ */
+
+static void headless_scribble( void )
+{
+  memset( blit::screen.data, HEADLESS_SCRIBBLE, blit::screen.bounds.w * blit::screen.bounds.h * blit::screen.pixel_stride );
+  blitroids_invalidate();
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * headless_verify - draws the frame just rendered again, in a single band,
+ *                   and checks it hashes the same as the banded render did.
+ *                   The serial render is left on screen.
+ *
+ * uint32_t - the time the frame was rendered at.
+ * uint64_t - the hash of the banded render.
+ *
+ * Returns bool, true if the two renders match.
+ */
+
+static bool headless_verify( uint32_t p_time, uint64_t p_hash )
+{
+  uint64_t  l_hash;
+
+  headless_scribble();
+  DrawList::set_bands( 1 );
+  render( p_time );
+  l_hash = headless_hash();
+  DrawList::set_bands( m_bands );
+
+  return l_hash == p_hash;
+}
+
+
+/*
+ * headless_mash - picks some buttons to hold for the next little while.
+ *
+ * Returns uint32_t, the buttons.
+ */
+
+static uint32_t headless_mash( void )
+{
+  uint32_t  l_bits = blit::random();
+  uint32_t  l_buttons = 0;
+  uint8_t   l_index;
+
+  for ( l_index = 0; l_index < sizeof( m_mash_buttons ) / sizeof( m_mash_buttons[0] ); l_index++ )
+  {
+    if ( l_bits & ( 1 << l_index ) )
+    {
+      l_buttons |= m_mash_buttons[l_index];
+    }
+  }
+
+  return l_buttons;
+}
+
+
+/*
+ * headless_report - prints where the time went, state by state, from the
+ *                   totals the game's PerfManager kept.
+ */
+
+static void headless_report( void )
+{
+  PerfManager    *l_perf_manager = blitroids_perf_manager();
+  perf_totals_t   l_totals;
+  uint8_t         l_state, l_phase;
+
+  printf( "state,phase,count,total_ms,mean_us\n" );
+  if ( nullptr == l_perf_manager )
+  {
+    return;
+  }
+  for ( l_state = 0; l_state < STATE_MAX; l_state++ )
+  {
+    for ( l_phase = 0; l_phase < PERF_MAX; l_phase++ )
+    {
+      l_totals = l_perf_manager->totals( (state_t)l_state, (perf_phase_t)l_phase );
+      if ( 0 == l_totals.count )
+      {
+        continue;
+      }
+      printf( "%s,%s,%u,%.3f,%.2f\n", m_state_names[l_state], m_phase_names[l_phase],
+              l_totals.count, l_totals.us / 1000.0, (double)l_totals.us / l_totals.count );
+    }
+  }
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * main - entry point; parses the arguments and runs the game.
+ */
+
+int main( int argc, char *argv[] )
+{
+  std::chrono::steady_clock::time_point l_start;
+  double      l_seconds;
+  uint64_t    l_hash, l_digest = HEADLESS_FNV_BASIS;
+  uint32_t    l_tick, l_time = 0, l_frames = 0, l_buttons = 0, l_mismatches = 0;
+  int         l_arg;
+
+  /* Look at what we've been asked for. */
+  for ( l_arg = 1; l_arg < argc; l_arg++ )
+  {
+    if ( ( 0 == strcmp( argv[l_arg], "--ticks" ) ) && ( l_arg + 1 < argc ) )
+    {
+      m_ticks = strtoul( argv[++l_arg], nullptr, 10 );
+    }
+    else if ( ( 0 == strcmp( argv[l_arg], "--render-every" ) ) && ( l_arg + 1 < argc ) )
+    {
+      m_render_every = strtoul( argv[++l_arg], nullptr, 10 );
+    }
+    else if ( ( 0 == strcmp( argv[l_arg], "--replay" ) ) && ( l_arg + 1 < argc ) )
+    {
+      m_replay_path = argv[++l_arg];
+    }
+    else if ( 0 == strcmp( argv[l_arg], "--hashes" ) )
+    {
+      m_print_hashes = true;
+    }
+    else if ( ( 0 == strcmp( argv[l_arg], "--threads" ) ) && ( l_arg + 1 < argc ) )
+    {
+      m_threads = strtoul( argv[++l_arg], nullptr, 10 );
+    }
+    else if ( ( 0 == strcmp( argv[l_arg], "--bands" ) ) && ( l_arg + 1 < argc ) )
+    {
+      m_bands = strtoul( argv[++l_arg], nullptr, 10 );
+    }
+    else if ( 0 == strcmp( argv[l_arg], "--verify-bands" ) )
+    {
+      m_verify_bands = true;
+    }
+    else if ( ( 0 == strcmp( argv[l_arg], "--expect-digest" ) ) && ( l_arg + 1 < argc ) )
+    {
+      m_check_digest = true;
+      m_expected_digest = strtoull( argv[++l_arg], nullptr, 16 );
+    }
+    else
+    {
+      fprintf( stderr, "Usage: %s [--ticks <n>] [--render-every <k>] [--replay <log>] [--hashes] [--threads <n>] "
+                       "[--bands <n>] [--verify-bands] [--expect-digest <hex>]\n", argv[0] );
+      return 1;
+    }
+  }
+
+  /* Bring up the fake platform, and any replay before the game starts. */
+  host_init();
+  if ( ( nullptr != m_replay_path ) && !blitroids_replay( m_replay_path ) )
+  {
+    fprintf( stderr, "Unable to replay %s\n", m_replay_path );
+    return 1;
+  }
+  init();
+  blitjobs_init( m_threads );
+  DrawList::set_bands( m_bands );
+
+  /* Then run it flat out; a replay overrides our clock and buttons, and */
+  /* the run stops at the tick that finds it has run out.                */
+  l_start = std::chrono::steady_clock::now();
+  for ( l_tick = 0; l_tick < m_ticks; l_tick++ )
+  {
+    if ( 0 == l_tick % HEADLESS_HOLD_TICKS )
+    {
+      l_buttons = headless_mash();
+    }
+    blit::buttons = l_buttons;
+
+    l_time += SIM_STEP_MS;
+    update( l_time );
+    if ( ( nullptr != m_replay_path ) && !blitroids_replaying() )
+    {
+      break;
+    }
+
+    /* Every so often, render and hash a frame. */
+    if ( ( m_render_every > 0 ) && ( 0 == ( l_tick + 1 ) % m_render_every ) )
+    {
+      if ( m_verify_bands )
+      {
+        headless_scribble();
+      }
+      render( l_time );
+      l_hash = headless_hash();
+      l_digest = ( l_digest ^ l_hash ) * HEADLESS_FNV_PRIME;
+      l_frames++;
+      if ( m_print_hashes )
+      {
+        printf( "frame,%u,%016llx\n", l_tick + 1, (unsigned long long)l_hash );
+      }
+      if ( m_verify_bands && !headless_verify( l_time, l_hash ) )
+      {
+        fprintf( stderr, "Banded render of tick %u differs from the serial one\n", l_tick + 1 );
+        l_mismatches++;
+      }
+    }
+  }
+  l_seconds = std::chrono::duration<double>( std::chrono::steady_clock::now() - l_start ).count();
+
+  /* Finish off any replay, so it reports any drift. */
+  if ( blitroids_replaying() )
+  {
+    blitroids_replay_stop();
+  }
+
+  /* And say how it went. */
+  printf( "ticks,seconds,ticks_per_sec,frames,digest,arena_high_water,threads,bands\n" );
+  printf( "%u,%.3f,%.0f,%u,%016llx,%u,%u,%u\n", l_tick, l_seconds,
+          ( l_seconds > 0.0 ) ? l_tick / l_seconds : 0.0, l_frames,
+          (unsigned long long)l_digest, blitarena_high_water(), blitjobs_workers(), DrawList::get_bands() );
+  headless_report();
+
+  /* A digest we were told to expect has to match, down to the last bit. */
+  if ( m_check_digest && ( l_digest != m_expected_digest ) )
+  {
+    fprintf( stderr, "Digest %016llx is not the expected %016llx\n",
+             (unsigned long long)l_digest, (unsigned long long)m_expected_digest );
+    l_mismatches++;
+  }
+
+  return ( l_mismatches > 0 ) ? 1 : 0;
+}
+
+
+/* End of file blitheadless.cpp */
@@ -12,29 +12,73 @@
 
 /* System headers. */
 
+#include <stdlib.h>
+#include <string.h>
 
 /* Local headers. */
 
 #include "32blit.hpp"
 #include "blitroids.hpp"
+#include "blittrig.hpp"
 
 #include "blitstrings.hpp"
 #include "AssetsImages.hpp"
 #include "AssetManager.hpp"
 
 
+/* Module variables. */
+
+static const uint8_t *m_image_assets[ASSET_IMG_MAX] = 
+{
+  a_img_logo,
+  a_img_spritesheet
+};
+
+static const uint32_t *m_image_lengths[ASSET_IMG_MAX] = 
+{
+  &a_img_logo_length,
+  &a_img_spritesheet_length
+};
+
+
 /* Functions. */
 
 /*
- * AssetManager - constructor, which basically just loads everything up
- *                if we can, setting sensible defaults as we go.
+ * AssetManager - constructor, which sets sensible defaults; images aren't
+ *                loaded until they're first asked for.
  */
 
 AssetManager::AssetManager( void )
 {
-  /* Load the images into Surfaces. */
-  c_img_logo = blit::Surface::load_read_only( a_img_logo );
-  c_img_spritesheet = blit::Surface::load_read_only( a_img_spritesheet );
+  /* No images have been loaded yet. */
+  memset( c_images, 0, sizeof( c_images ) );
+  c_image_budget = ASSET_RAM_BUDGET;
+  c_image_bytes = 0;
+  c_image_clock = 0;
+
+  /* The arena is only allocated when something needs decoding. */
+  c_arena = nullptr;
+  c_arena_size = c_arena_used = 0;
+
+  /* Default to English, until told otherwise. */
+  c_language = LANG_EN;
+
+  /* No layers have been registered yet. */
+  memset( c_layers, 0, sizeof( c_layers ) );
+
+  /* And no text has been rasterised. */
+  for ( uint8_t l_index = 0; l_index < ASSET_MAX_TEXTS; l_index++ )
+  {
+    c_texts[l_index] = asset_text_t();
+  }
+  c_text_clock = 0;
+
+  /* Collision masks are made when the spritesheet is first loaded. */
+  c_masks = nullptr;
+  memset( c_mask_first, 0, sizeof( c_mask_first ) );
+  memset( c_rotations, 0, sizeof( c_rotations ) );
+  c_atlas = nullptr;
+  c_atlas_palette = nullptr;
 
   /* All done. */
   return;
@@ -48,16 +92,42 @@ AssetManager::AssetManager( void )
 AssetManager::~AssetManager()
 {
   /* Throw away our image Surfaces. */
-  if ( nullptr != c_img_logo )
+  for ( uint8_t l_index = 0; l_index < ASSET_IMG_MAX; l_index++ )
+  {
+    unload_image( (asset_image_t)l_index );
+  }
+  blitarena_free( c_arena );
+  c_arena = nullptr;
+
+  /* And any layers that are still hanging around. */
+  for ( uint8_t l_index = 0; l_index < ASSET_MAX_LAYERS; l_index++ )
   {
-    delete c_img_logo;
-    c_img_logo = nullptr;
+    discard_layer( &c_layers[l_index] );
   }
-  if ( nullptr != c_img_spritesheet )
+
+  /* Along with any rasterised text. */
+  for ( uint8_t l_index = 0; l_index < ASSET_MAX_TEXTS; l_index++ )
+  {
+    discard_text( &c_texts[l_index] );
+  }
+
+  /* And the collision masks. */
+  for ( uint16_t l_index = 0; ( nullptr != c_masks ) && ( l_index < c_mask_first[SPRITE_MAX] ); l_index++ )
   {
-    delete c_img_spritesheet;
-    c_img_spritesheet = nullptr;
+    blitmask_free( &c_masks[l_index] );
   }
+  blitarena_free( c_masks );
+  c_masks = nullptr;
+
+  /* And the rotation atlas. */
+  if ( nullptr != c_atlas )
+  {
+    blitarena_free( c_atlas->data );
+    blitarena_delete( c_atlas );
+    c_atlas = nullptr;
+  }
+  blitarena_free( c_atlas_palette );
+  c_atlas_palette = nullptr;
 
   /* All done. */
   return;
@@ -72,6 +142,18 @@ AssetManager::~AssetManager()
 
 void AssetManager::set_language( blit_lang_t p_language )
 {
+  /* Any text we've rasterised is now in the wrong language; digits aren't. */
+  if ( p_language != c_language )
+  {
+    for ( uint8_t l_index = 0; l_index < ASSET_MAX_TEXTS; l_index++ )
+    {
+      if ( c_texts[l_index].text < STR_MAX )
+      {
+        discard_text( &c_texts[l_index] );
+      }
+    }
+  }
+
   c_language = p_language;
   return;
 }
@@ -101,4 +183,1200 @@ const char *AssetManager::get_string( blit_string_t p_string )
 }
 
 
+/*
+ * font_id - works out which of the bundled fonts a Font is, so we can find
+ *           its entries in the layout table.
+ *
+ * const blit::Font& - the font.
+ *
+ * Returns blit_font_t, the font, or FONT_MAX if it isn't one of ours.
+ */
+
+blit_font_t AssetManager::font_id( const blit::Font &p_font )
+{
+  if ( &p_font == &font_null )
+  {
+    return FONT_NULL16;
+  }
+  return FONT_MAX;
+}
+
+
+/*
+ * get_layout - returns the layout of a string in the given font, worked out
+ *              when the string table was built; its size, and the text as
+ *              it should be drawn, broken into lines if it needed wrapping.
+ *
+ * blit_string_t     - the id of the string.
+ * const blit::Font& - the font it's to be drawn in.
+ *
+ * Returns const blit_layout_t *, the layout, or nullptr for unknown fonts.
+ */
+
+const blit_layout_t *AssetManager::get_layout( blit_string_t p_string, const blit::Font &p_font )
+{
+  blit_font_t   l_font = font_id( p_font );
+
+  if ( FONT_MAX == l_font )
+  {
+    return nullptr;
+  }
+  return &g_blit_layout[l_font][c_language][p_string];
+}
+
+
+#ifndef   TARGET_32BLIT_HW
+/*
+ * check_layouts - compares the layouts in the string table with what the
+ *                 engine measures, for the current language; if they don't
+ *                 agree then string-table.py has drifted from the engine.
+ *                 Desktop builds only; the handheld has better things to
+ *                 do with its boot time, and runs the same tables.
+ */
+
+void AssetManager::check_layouts( void )
+{
+  const blit_layout_t  *l_layout;
+  blit::Size            l_size;
+  uint8_t               l_index;
+
+  for ( l_index = 0; l_index < STR_MAX; l_index++ )
+  {
+    l_layout = get_layout( (blit_string_t)l_index, font_null );
+    l_size = blit::screen.measure_text( l_layout->text, font_null );
+    if ( ( l_size.w != l_layout->width ) || ( l_size.h != l_layout->height ) )
+    {
+      debug_printf( "String %d is %dx%d, but the table says %dx%d\n", l_index,
+                    l_size.w, l_size.h, l_layout->width, l_layout->height );
+    }
+  }
+
+  /* All done. */
+  return;
+}
+#endif /* TARGET_32BLIT_HW */
+
+
+/*
+ * load_image - loads an image into a Surface; if it can be used straight
+ *              from flash it is, otherwise it's decoded into the arena,
+ *              making room there first if we can.
+ *
+ * asset_image_t - the image to load.
+ */
+
+void AssetManager::load_image( asset_image_t p_image )
+{
+  asset_image_entry_t      *l_entry = &c_images[p_image];
+  const blit::packed_image *l_header = (const blit::packed_image *)m_image_assets[p_image];
+  uint8_t                  *l_buffer;
+  uint32_t                  l_bytes, l_entries;
+
+  /* Read only is best; it costs us nothing. */
+  l_entry->palette = l_entry->loader_palette = nullptr;
+  l_entry->surface = blit::Surface::load_read_only( m_image_assets[p_image] );
+  if ( nullptr != l_entry->surface )
+  {
+    l_entry->bytes = 0;
+    l_entry->in_arena = false;
+    return;
+  }
+
+  /* Otherwise, it's decoded to one byte per pixel; find room for that. */
+  l_bytes = l_header->width * l_header->height;
+  l_buffer = arena_alloc( l_bytes, p_image );
+
+  /* If the arena can't take it, the engine will allocate it for us. */
+  l_entry->surface = blit::Surface::load( m_image_assets[p_image], l_buffer );
+  if ( nullptr == l_entry->surface )
+  {
+    debug_printf( "Failed to load image %d\n", p_image );
+    if ( nullptr != l_buffer )
+    {
+      c_arena_used -= l_bytes;
+    }
+    return;
+  }
+  l_entry->bytes = l_bytes;
+  l_entry->in_arena = ( nullptr != l_buffer );
+  c_image_bytes += l_bytes;
+
+  /* An indexed image is drawn through our own copy of its palette, in the */
+  /* arena, so that's all we ever free; whatever the loader gave it is put */
+  /* back before the Surface is deleted, and left to the engine.           */
+  if ( ( blit::PixelFormat::P == l_entry->surface->format ) && ( nullptr != l_entry->surface->palette ) )
+  {
+    l_entries = ( 0 == l_header->palette_entry_count ) ? 256 : l_header->palette_entry_count;
+    l_entry->palette = (blit::Pen *)blitarena_alloc( l_entries * sizeof( blit::Pen ) );
+    if ( nullptr != l_entry->palette )
+    {
+      memcpy( l_entry->palette, l_entry->surface->palette, l_entries * sizeof( blit::Pen ) );
+      l_entry->loader_palette = l_entry->surface->palette;
+      l_entry->surface->palette = l_entry->palette;
+    }
+  }
+
+  if ( !l_entry->in_arena )
+  {
+    debug_printf( "Image budget exceeded; %lu of %lu bytes\n", 
+                  (unsigned long)c_image_bytes, (unsigned long)c_image_budget );
+  }
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * unload_image - throws away an image; anything decoded outside the arena
+ *                is freed, while arena space is reclaimed by compaction.
+ *
+ * asset_image_t - the image to unload.
+ */
+
+void AssetManager::unload_image( asset_image_t p_image )
+{
+  asset_image_entry_t  *l_entry = &c_images[p_image];
+
+  if ( nullptr == l_entry->surface )
+  {
+    return;
+  }
+
+  /* Decoded images own their pixel data; read only ones point at flash. */
+  if ( ( l_entry->bytes > 0 ) && !l_entry->in_arena )
+  {
+    delete[] l_entry->surface->data;
+  }
+
+  /* Our copy of the palette goes, and the loader's own is handed back. */
+  if ( nullptr != l_entry->palette )
+  {
+    l_entry->surface->palette = l_entry->loader_palette;
+    blitarena_free( l_entry->palette );
+    l_entry->palette = l_entry->loader_palette = nullptr;
+  }
+  c_image_bytes -= l_entry->bytes;
+  l_entry->bytes = 0;
+  l_entry->in_arena = false;
+  delete l_entry->surface;
+  l_entry->surface = nullptr;
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * arena_alloc - finds room in the arena for a decoded image, evicting the
+ *               least recently used images until it fits. The arena itself
+ *               is allocated the first time it's needed.
+ *
+ * uint32_t      - the number of bytes needed.
+ * asset_image_t - the image being loaded, which mustn't be evicted.
+ *
+ * Returns uint8_t *, the space, or nullptr if it can't be found.
+ */
+
+uint8_t *AssetManager::arena_alloc( uint32_t p_bytes, asset_image_t p_image )
+{
+  uint8_t  *l_space;
+
+  /* Allocate the arena itself, if this is the first time. */
+  if ( nullptr == c_arena )
+  {
+    c_arena = (uint8_t *)blitarena_alloc( c_image_budget );
+    if ( nullptr == c_arena )
+    {
+      return nullptr;
+    }
+    c_arena_size = c_image_budget;
+    c_arena_used = 0;
+  }
+
+  /* Make room, within both the arena and the budget. */
+  while ( ( c_arena_used + p_bytes > c_arena_size ) || ( c_image_bytes + p_bytes > c_image_budget ) )
+  {
+    if ( !evict_image( p_image ) )
+    {
+      return nullptr;
+    }
+    arena_compact();
+  }
+
+  /* And take it off the end. */
+  l_space = c_arena + c_arena_used;
+  c_arena_used += p_bytes;
+  return l_space;
+}
+
+
+/*
+ * arena_compact - slides the images in the arena down, to close any gaps
+ *                 left by evictions; their surfaces are pointed at the new
+ *                 location, which is why nobody should hold on to them.
+ */
+
+void AssetManager::arena_compact( void )
+{
+  uint8_t  *l_cursor = c_arena;
+  uint8_t   l_index, l_next;
+
+  while ( true )
+  {
+    /* Find the lowest image that's still above the cursor. */
+    l_next = ASSET_IMG_MAX;
+    for ( l_index = 0; l_index < ASSET_IMG_MAX; l_index++ )
+    {
+      if ( !c_images[l_index].in_arena || ( c_images[l_index].surface->data < l_cursor ) )
+      {
+        continue;
+      }
+      if ( ( ASSET_IMG_MAX == l_next ) || 
+           ( c_images[l_index].surface->data < c_images[l_next].surface->data ) )
+      {
+        l_next = l_index;
+      }
+    }
+    if ( ASSET_IMG_MAX == l_next )
+    {
+      break;
+    }
+
+    /* Slide it down, if there's a gap. */
+    if ( c_images[l_next].surface->data != l_cursor )
+    {
+      memmove( l_cursor, c_images[l_next].surface->data, c_images[l_next].bytes );
+      c_images[l_next].surface->data = l_cursor;
+    }
+    l_cursor += c_images[l_next].bytes;
+  }
+
+  /* Everything past the cursor is free. */
+  c_arena_used = l_cursor - c_arena;
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * evict_image - throws away the least recently used decoded image.
+ *
+ * asset_image_t - an image that must be kept, whatever its age.
+ *
+ * Returns bool, true if an image was evicted.
+ */
+
+bool AssetManager::evict_image( asset_image_t p_keep )
+{
+  uint8_t   l_index, l_oldest = ASSET_IMG_MAX;
+
+  /* Only decoded images are worth throwing away. */
+  for ( l_index = 0; l_index < ASSET_IMG_MAX; l_index++ )
+  {
+    if ( ( l_index == p_keep ) || ( 0 == c_images[l_index].bytes ) )
+    {
+      continue;
+    }
+    if ( ( ASSET_IMG_MAX == l_oldest ) || 
+         ( c_images[l_index].last_used < c_images[l_oldest].last_used ) )
+    {
+      l_oldest = l_index;
+    }
+  }
+
+  /* Nothing we can do. */
+  if ( ASSET_IMG_MAX == l_oldest )
+  {
+    return false;
+  }
+
+  /* Otherwise, throw it away. */
+  unload_image( (asset_image_t)l_oldest );
+  return true;
+}
+
+
+/*
+ * get_image - fetches an image, loading it if it isn't already. Decoded
+ *             images may be evicted by later loads, so don't hold on to
+ *             the Surface; ask for it again each time it's needed.
+ *
+ * asset_image_t - the image to fetch.
+ *
+ * Returns blit::Surface *, the image, or nullptr if it couldn't be loaded.
+ */
+
+blit::Surface *AssetManager::get_image( asset_image_t p_image )
+{
+  /* Check that it's a sane image. */
+  if ( p_image >= ASSET_IMG_MAX )
+  {
+    return nullptr;
+  }
+
+  /* Load it if we need to. */
+  if ( nullptr == c_images[p_image].surface )
+  {
+    load_image( p_image );
+
+    /* The first time the spritesheet arrives, bake its rotations and */
+    /* make its collision masks.                                        */
+    if ( ( ASSET_IMG_SPRITESHEET == p_image ) && ( nullptr == c_masks ) )
+    {
+      bake_rotations( c_images[p_image].surface );
+      build_masks( c_images[p_image].surface );
+    }
+  }
+
+  /* Note that it's been used, and hand it over. */
+  c_images[p_image].last_used = ++c_image_clock;
+  return c_images[p_image].surface;
+}
+
+
+/*
+ * bake_rotations - turns the first frame of each sprite that asked for
+ *                  rotations through that many evenly spaced headings, and
+ *                  packs the results into one atlas. Each rotation is a
+ *                  square big enough for the sprite to turn in, with the
+ *                  pivot in the middle; they're laid out in rows, each
+ *                  sprite starting a fresh one. Pixels are sampled nearest
+ *                  neighbour, so no new colours are needed and the atlas
+ *                  shares the sheet's palette (although it keeps its own
+ *                  copy, in case the sheet is evicted).
+ *
+ * const blit::Surface * - the spritesheet.
+ */
+
+void AssetManager::bake_rotations( const blit::Surface *p_sheet )
+{
+  uint8_t               l_sprite, l_rotation, l_transparent = 0;
+  uint16_t              l_height = 0, l_entries, l_index;
+  int32_t               l_reach, l_x, l_y, l_u, l_v, l_half;
+  float                 l_sin, l_cos, l_dx, l_dy;
+  uint8_t              *l_data, *l_pixel;
+  blit::Rect            l_frame;
+  const sprite_info_t  *l_info;
+
+  /* We can only bake from an indexed sheet. */
+  if ( ( nullptr == p_sheet ) || ( blit::PixelFormat::P != p_sheet->format ) || ( nullptr == p_sheet->palette ) )
+  {
+    return;
+  }
+
+  /* Lay the atlas out; each sprite needs a square as wide as the furthest */
+  /* corner from its pivot, either side, and rows of as many as will fit.  */
+  for ( l_sprite = 0; l_sprite < SPRITE_MAX; l_sprite++ )
+  {
+    l_info = &g_sprite_index[l_sprite];
+    c_rotations[l_sprite] = asset_rotation_t();
+    if ( 0 == l_info->rotations )
+    {
+      continue;
+    }
+
+    l_x = ( l_info->pivot_x > l_info->w - 1 - l_info->pivot_x ) ? l_info->pivot_x : l_info->w - 1 - l_info->pivot_x;
+    l_y = ( l_info->pivot_y > l_info->h - 1 - l_info->pivot_y ) ? l_info->pivot_y : l_info->h - 1 - l_info->pivot_y;
+    for ( l_reach = 0; l_reach * l_reach < l_x * l_x + l_y * l_y; l_reach++ );
+    if ( 2 * l_reach + 1 > ASSET_ATLAS_WIDTH )
+    {
+      debug_printf( "Sprite %d is too big to rotate\n", l_sprite );
+      continue;
+    }
+
+    c_rotations[l_sprite].y = l_height;
+    c_rotations[l_sprite].size = 2 * l_reach + 1;
+    c_rotations[l_sprite].columns = ASSET_ATLAS_WIDTH / c_rotations[l_sprite].size;
+    l_height += ( l_info->rotations + c_rotations[l_sprite].columns - 1 ) / c_rotations[l_sprite].columns *
+                c_rotations[l_sprite].size;
+  }
+
+  /* Nothing wants rotating? */
+  if ( 0 == l_height )
+  {
+    return;
+  }
+
+  /* Take our own copy of the palette, and find a transparent entry in it. */
+  l_entries = ( (const blit::packed_image *)m_image_assets[ASSET_IMG_SPRITESHEET] )->palette_entry_count;
+  l_entries = ( 0 == l_entries ) ? 256 : l_entries;
+  c_atlas_palette = (blit::Pen *)blitarena_alloc( l_entries * sizeof( blit::Pen ) );
+  l_data = (uint8_t *)blitarena_alloc( ASSET_ATLAS_WIDTH * l_height );
+  if ( nullptr != l_data )
+  {
+    c_atlas = blitarena_new<blit::Surface>( l_data, blit::PixelFormat::P, blit::Size( ASSET_ATLAS_WIDTH, l_height ) );
+  }
+  if ( ( nullptr == c_atlas_palette ) || ( nullptr == l_data ) || ( nullptr == c_atlas ) )
+  {
+    debug_printf( "No room to bake %d rows of rotations\n", l_height );
+    blitarena_free( c_atlas_palette );
+    blitarena_free( l_data );
+    c_atlas_palette = nullptr;
+    c_atlas = nullptr;
+    memset( c_rotations, 0, sizeof( c_rotations ) );
+    return;
+  }
+  for ( l_index = l_entries; l_index-- > 0; )
+  {
+    c_atlas_palette[l_index] = p_sheet->palette[l_index];
+    if ( 0 == c_atlas_palette[l_index].a )
+    {
+      l_transparent = l_index;
+    }
+  }
+  c_atlas->palette = c_atlas_palette;
+  memset( l_data, l_transparent, ASSET_ATLAS_WIDTH * l_height );
+
+  /* And then bake each rotation, working back from each pixel of it to */
+  /* where it would have come from in the upright sprite.               */
+  for ( l_sprite = 0; l_sprite < SPRITE_MAX; l_sprite++ )
+  {
+    l_info = &g_sprite_index[l_sprite];
+    l_half = c_rotations[l_sprite].size / 2;
+    for ( l_rotation = 0; ( c_rotations[l_sprite].size > 0 ) && ( l_rotation < l_info->rotations ); l_rotation++ )
+    {
+      l_sin = (float)trig_sine( 2.0 * TRIG_PI * l_rotation / l_info->rotations );
+      l_cos = (float)trig_sine( 2.0 * TRIG_PI * l_rotation / l_info->rotations + TRIG_PI / 2.0 );
+      l_frame = blit::Rect(
+        ( l_rotation % c_rotations[l_sprite].columns ) * c_rotations[l_sprite].size,
+        c_rotations[l_sprite].y + ( l_rotation / c_rotations[l_sprite].columns ) * c_rotations[l_sprite].size,
+        c_rotations[l_sprite].size, c_rotations[l_sprite].size
+      );
+
+      for ( l_y = 0; l_y < l_frame.h; l_y++ )
+      {
+        for ( l_x = 0; l_x < l_frame.w; l_x++ )
+        {
+          /* Turning back anticlockwise, to the nearest source pixel. */
+          l_dx = l_x - l_half;
+          l_dy = l_y - l_half;
+          l_u = (int32_t)( l_info->pivot_x + l_dx * l_cos + l_dy * l_sin + 1.5f ) - 1;
+          l_v = (int32_t)( l_info->pivot_y - l_dx * l_sin + l_dy * l_cos + 1.5f ) - 1;
+          if ( ( l_u < 0 ) || ( l_v < 0 ) || ( l_u >= l_info->w ) || ( l_v >= l_info->h ) )
+          {
+            continue;
+          }
+
+          l_pixel = &l_data[( l_frame.y + l_y ) * ASSET_ATLAS_WIDTH + l_frame.x + l_x];
+          *l_pixel = p_sheet->data[( sprite_frame_y( *l_info, 0 ) + l_v ) * p_sheet->bounds.w +
+                                   sprite_frame_x( *l_info, 0 ) + l_u];
+        }
+      }
+    }
+  }
+
+  /* Keep an eye on what that cost. */
+  debug_printf( "Baked rotations into a %dx%d atlas\n", ASSET_ATLAS_WIDTH, l_height );
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * build_masks - makes the collision masks for every sprite in the sheet;
+ *               one for every frame at each quarter turn, followed by one
+ *               for each of its baked rotations. They're all kept in one
+ *               table, with each sprite's masks starting at its entry in
+ *               c_mask_first.
+ *
+ * const blit::Surface * - the spritesheet.
+ */
+
+void AssetManager::build_masks( const blit::Surface *p_sheet )
+{
+  uint8_t               l_sprite, l_frame, l_quarter, l_rotation;
+  uint16_t              l_index;
+  const sprite_info_t  *l_info;
+  asset_pose_t          l_pose;
+
+  /* Nothing to build from? */
+  if ( nullptr == p_sheet )
+  {
+    return;
+  }
+
+  /* Work out where each sprite's masks start, and so how many we need. */
+  c_mask_first[0] = 0;
+  for ( l_sprite = 0; l_sprite < SPRITE_MAX; l_sprite++ )
+  {
+    c_mask_first[l_sprite + 1] = c_mask_first[l_sprite] + g_sprite_index[l_sprite].frames * 4 +
+                                 ( c_rotations[l_sprite].size ? g_sprite_index[l_sprite].rotations : 0 );
+  }
+  c_masks = (blit_mask_t *)blitarena_calloc( c_mask_first[SPRITE_MAX], sizeof( blit_mask_t ) );
+  if ( nullptr == c_masks )
+  {
+    return;
+  }
+
+  /* And then make them. */
+  for ( l_sprite = 0; l_sprite < SPRITE_MAX; l_sprite++ )
+  {
+    l_info = &g_sprite_index[l_sprite];
+    for ( l_frame = 0; l_frame < l_info->frames; l_frame++ )
+    {
+      for ( l_quarter = 0; l_quarter < 4; l_quarter++ )
+      {
+        l_index = c_mask_first[l_sprite] + l_frame * 4 + l_quarter;
+        blitmask_build( &c_masks[l_index], p_sheet, sprite_rect( *l_info, l_frame ), g_sprite_quarter[l_quarter] );
+      }
+    }
+
+    /* The rotations are made from the atlas, so they match what's drawn. */
+    for ( l_rotation = 0; ( c_rotations[l_sprite].size > 0 ) && ( l_rotation < l_info->rotations ); l_rotation++ )
+    {
+      l_index = c_mask_first[l_sprite] + l_info->frames * 4 + l_rotation;
+      get_pose( (sprite_t)l_sprite, l_rotation * 360 / l_info->rotations, &l_pose );
+      blitmask_build( &c_masks[l_index], c_atlas, l_pose.rect );
+    }
+  }
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * get_mask - fetches the collision mask of a frame of a sprite, turned
+ *            through some quarter turns (as by g_sprite_quarter).
+ *
+ * sprite_t - the sprite.
+ * uint8_t  - the frame.
+ * uint8_t  - how many quarter turns.
+ *
+ * Returns const blit_mask_t *, the mask, or nullptr if there isn't one.
+ */
+
+const blit_mask_t *AssetManager::get_mask( sprite_t p_sprite, uint8_t p_frame, uint8_t p_quarter )
+{
+  /* The masks come with the spritesheet. */
+  if ( nullptr == c_masks )
+  {
+    get_image( ASSET_IMG_SPRITESHEET );
+  }
+  if ( ( nullptr == c_masks ) || ( p_sprite >= SPRITE_MAX ) )
+  {
+    return nullptr;
+  }
+
+  return &c_masks[c_mask_first[p_sprite] + ( p_frame % g_sprite_index[p_sprite].frames ) * 4 + p_quarter % 4];
+}
+
+
+/*
+ * get_pose - works out how to draw a sprite at a heading; from its nearest
+ *            baked rotation if it has them, or else its first frame turned
+ *            to the nearest quarter. The collision mask to match is filled
+ *            in too, if there is one.
+ *
+ * sprite_t       - the sprite.
+ * uint16_t       - the heading, in degrees clockwise from as drawn.
+ * asset_pose_t * - the pose to fill in.
+ *
+ * Returns bool, true if the sprite can be drawn.
+ */
+
+bool AssetManager::get_pose( sprite_t p_sprite, uint16_t p_degrees, asset_pose_t *p_pose )
+{
+  const sprite_info_t  *l_info;
+  const blit::Surface  *l_sheet;
+  uint8_t               l_rotation, l_quarter;
+  int32_t               l_swap;
+
+  /* Make sure the sheet, and so the atlas, are there. */
+  l_sheet = get_image( ASSET_IMG_SPRITESHEET );
+  if ( ( nullptr == l_sheet ) || ( p_sprite >= SPRITE_MAX ) )
+  {
+    return false;
+  }
+  l_info = &g_sprite_index[p_sprite];
+
+  /* A baked rotation is just a square of the atlas, pivot in the middle. */
+  if ( c_rotations[p_sprite].size > 0 )
+  {
+    l_rotation = sprite_rotation( *l_info, p_degrees );
+    p_pose->surface = c_atlas;
+    p_pose->rect = blit::Rect(
+      ( l_rotation % c_rotations[p_sprite].columns ) * c_rotations[p_sprite].size,
+      c_rotations[p_sprite].y + ( l_rotation / c_rotations[p_sprite].columns ) * c_rotations[p_sprite].size,
+      c_rotations[p_sprite].size, c_rotations[p_sprite].size
+    );
+    p_pose->pivot = blit::Point( c_rotations[p_sprite].size / 2, c_rotations[p_sprite].size / 2 );
+    p_pose->transform = 0;
+    p_pose->mask = ( nullptr == c_masks ) ? nullptr : &c_masks[c_mask_first[p_sprite] + l_info->frames * 4 + l_rotation];
+    return true;
+  }
+
+  /* Otherwise, the first frame turned to the nearest quarter; the pivot */
+  /* has to be turned with it.                                           */
+  l_quarter = ( ( p_degrees % 360 ) + 45 ) / 90 % 4;
+  p_pose->surface = l_sheet;
+  p_pose->rect = sprite_rect( *l_info, 0 );
+  p_pose->transform = g_sprite_quarter[l_quarter];
+  p_pose->pivot = blit::Point( l_info->pivot_x, l_info->pivot_y );
+  if ( p_pose->transform & blit::SpriteTransform::HORIZONTAL )
+  {
+    p_pose->pivot.x = l_info->w - 1 - p_pose->pivot.x;
+  }
+  if ( p_pose->transform & blit::SpriteTransform::VERTICAL )
+  {
+    p_pose->pivot.y = l_info->h - 1 - p_pose->pivot.y;
+  }
+  if ( p_pose->transform & blit::SpriteTransform::XYSWAP )
+  {
+    l_swap = p_pose->pivot.x;
+    p_pose->pivot.x = p_pose->pivot.y;
+    p_pose->pivot.y = l_swap;
+  }
+  p_pose->mask = get_mask( p_sprite, 0, l_quarter );
+  return true;
+}
+
+
+/*
+ * preload - a hint that an image will be needed soon, so load it now while
+ *           nobody is waiting on it.
+ *
+ * asset_image_t - the image to load.
+ */
+
+void AssetManager::preload( asset_image_t p_image )
+{
+  get_image( p_image );
+  return;
+}
+
+
+/*
+ * set_image_budget - sets how much RAM decoded images may use; if we're
+ *                    already over, older images are evicted to fit.
+ *
+ * uint32_t - the budget, in bytes.
+ */
+
+void AssetManager::set_image_budget( uint32_t p_budget )
+{
+  uint8_t   l_index;
+
+  c_image_budget = p_budget;
+
+  /* Growing past the arena means starting it again, at the new size. */
+  if ( ( nullptr != c_arena ) && ( c_image_budget > c_arena_size ) )
+  {
+    for ( l_index = 0; l_index < ASSET_IMG_MAX; l_index++ )
+    {
+      if ( c_images[l_index].in_arena )
+      {
+        unload_image( (asset_image_t)l_index );
+      }
+    }
+    blitarena_free( c_arena );
+    c_arena = nullptr;
+    c_arena_size = c_arena_used = 0;
+  }
+
+  /* Otherwise, just evict until we fit and tidy up. */
+  while ( ( c_image_bytes > c_image_budget ) && evict_image( ASSET_IMG_MAX ) );
+  if ( nullptr != c_arena )
+  {
+    arena_compact();
+  }
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * report_images - reports, for every image, how much flash it takes and how
+ *                 much that saves over storing it as raw RGBA.
+ */
+
+void AssetManager::report_images( void )
+{
+  const blit::packed_image *l_header;
+  uint32_t                  l_raw, l_total_flash = 0, l_total_raw = 0;
+  uint8_t                   l_index;
+
+  for ( l_index = 0; l_index < ASSET_IMG_MAX; l_index++ )
+  {
+    l_header = (const blit::packed_image *)m_image_assets[l_index];
+    l_raw = l_header->width * l_header->height * 4;
+    l_total_flash += *m_image_lengths[l_index];
+    l_total_raw += l_raw;
+
+    debug_printf( "Image %d (%dx%d): %lu bytes in flash, %lu as RGBA, %lu saved\n",
+                  l_index, l_header->width, l_header->height, 
+                  (unsigned long)*m_image_lengths[l_index], (unsigned long)l_raw,
+                  (unsigned long)( l_raw - *m_image_lengths[l_index] ) );
+  }
+
+  debug_printf( "All images: %lu bytes in flash, %lu as RGBA, %lu saved\n",
+                (unsigned long)l_total_flash, (unsigned long)l_total_raw, 
+                (unsigned long)( l_total_raw - l_total_flash ) );
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * text_origin - works out where the top left of a block of text goes, given
+ *               the point and alignment it would have been drawn with.
+ *
+ * blit::Point     - the point the text is aligned to.
+ * blit::Size      - the size of the text.
+ * blit::TextAlign - the alignment.
+ *
+ * Returns blit::Point, the top left corner of the text.
+ */
+
+static blit::Point text_origin( blit::Point p_point, blit::Size p_size, blit::TextAlign p_align )
+{
+  if ( (int)p_align & (int)blit::TextAlign::center_h )
+  {
+    p_point.x -= p_size.w / 2;
+  }
+  else if ( (int)p_align & (int)blit::TextAlign::right )
+  {
+    p_point.x -= p_size.w;
+  }
+
+  if ( (int)p_align & (int)blit::TextAlign::center_v )
+  {
+    p_point.y -= p_size.h / 2;
+  }
+  else if ( (int)p_align & (int)blit::TextAlign::bottom )
+  {
+    p_point.y -= p_size.h;
+  }
+
+  return p_point;
+}
+
+
+/*
+ * discard_text - frees up a rasterised text mask, and its slot.
+ *
+ * asset_text_t * - the text to discard.
+ */
+
+void AssetManager::discard_text( asset_text_t *p_text )
+{
+  if ( nullptr != p_text->surface )
+  {
+    blitarena_free( p_text->surface->data );
+    blitarena_delete( p_text->surface );
+  }
+  *p_text = asset_text_t();
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * find_text - finds the mask for a string (or a single digit) in the given
+ *             font and the current language, rasterising it if we haven't
+ *             already. The least recently used mask makes way if we're full.
+ *
+ * uint16_t          - the string id, or ASSET_TEXT_DIGIT() of a digit.
+ * const blit::Font& - the font to rasterise in.
+ *
+ * Returns asset_text_t *, the cached text, or nullptr if it couldn't be made.
+ */
+
+asset_text_t *AssetManager::find_text( uint16_t p_text, const blit::Font &p_font )
+{
+  asset_text_t   *l_entry, *l_victim = &c_texts[0];
+  const blit_layout_t *l_layout;
+  blit_lang_t     l_language = ( p_text < STR_MAX ) ? c_language : LANG_MAX;
+  char            l_digits[3];
+  const char     *l_string;
+  blit::Size      l_size;
+  uint8_t        *l_scratch, *l_mask;
+  int32_t         l_index;
+
+  /* Look for it, keeping an eye out for a slot to reuse if it's not there. */
+  for ( l_index = 0; l_index < ASSET_MAX_TEXTS; l_index++ )
+  {
+    l_entry = &c_texts[l_index];
+    if ( nullptr == l_entry->surface )
+    {
+      l_victim = l_entry;
+      continue;
+    }
+    if ( ( l_entry->text == p_text ) && ( l_entry->font == &p_font ) && ( l_entry->language == l_language ) )
+    {
+      l_entry->last_used = ++c_text_clock;
+      return l_entry;
+    }
+    if ( ( nullptr != l_victim->surface ) && ( l_entry->last_used < l_victim->last_used ) )
+    {
+      l_victim = l_entry;
+    }
+  }
+  discard_text( l_victim );
+
+  /* Strings were measured when the table was built; digits weren't. */
+  if ( p_text < STR_MAX )
+  {
+    l_layout = get_layout( (blit_string_t)p_text, p_font );
+    l_string = ( nullptr == l_layout ) ? get_string( (blit_string_t)p_text ) : l_layout->text;
+  }
+  else
+  {
+    l_layout = nullptr;
+    l_digits[0] = l_digits[1] = '0' + ( p_text - ASSET_TEXT_DIGIT( 0 ) );
+    l_digits[2] = '\0';
+    l_string = l_digits + 1;
+  }
+  if ( nullptr != l_layout )
+  {
+    l_size = blit::Size( l_layout->width, l_layout->height );
+  }
+  else
+  {
+    l_size = blit::screen.measure_text( l_string, p_font );
+  }
+  if ( l_size.empty() )
+  {
+    return nullptr;
+  }
+
+  /* Let the engine draw it in white on black, in a scratch surface... */
+  l_scratch = (uint8_t *)blitarena_calloc( l_size.area(), 3 );
+  l_mask = (uint8_t *)blitarena_alloc( l_size.area() );
+  l_victim->surface = blitarena_new<blit::Surface>( l_mask, blit::PixelFormat::P, l_size );
+  if ( ( nullptr == l_scratch ) || ( nullptr == l_mask ) || ( nullptr == l_victim->surface ) )
+  {
+    blitarena_free( l_scratch );
+    blitarena_free( l_mask );
+    blitarena_delete( l_victim->surface );
+    l_victim->surface = nullptr;
+    return nullptr;
+  }
+  {
+    blit::Surface l_surface( l_scratch, blit::PixelFormat::RGB, l_size );
+    l_surface.pen = blit::Pen( 255, 255, 255 );
+    l_surface.text( l_string, p_font, blit::Point( 0, 0 ) );
+  }
+
+  /* ...and keep only which pixels it touched, as palette indices. */
+  for ( l_index = 0; l_index < l_size.area(); l_index++ )
+  {
+    l_mask[l_index] = ( 0 != l_scratch[l_index * 3] ) ? 1 : 0;
+  }
+  blitarena_free( l_scratch );
+
+  /* Index 0 is see-through, and index 1 is coloured in as it's drawn. */
+  l_victim->surface->palette = l_victim->palette;
+  l_victim->palette[0] = blit::Pen( 0, 0, 0, 0 );
+  l_victim->palette[1] = blit::Pen( 255, 255, 255 );
+  l_victim->font = &p_font;
+  l_victim->text = p_text;
+  l_victim->language = l_language;
+  l_victim->last_used = ++c_text_clock;
+
+  /* Digits also need to know the gap the font leaves before the next one. */
+  if ( p_text >= STR_MAX )
+  {
+    l_victim->spacing = blit::screen.measure_text( l_digits, p_font ).w - l_size.w * 2;
+  }
+
+  return l_victim;
+}
+
+
+/*
+ * get_text - fetches the rasterised mask for a string, in the current
+ *            language; as with images, don't hold on to it.
+ *
+ * blit_string_t     - the id of the string.
+ * const blit::Font& - the font to rasterise in.
+ *
+ * Returns blit::Surface *, the mask, or nullptr if it couldn't be made.
+ */
+
+blit::Surface *AssetManager::get_text( blit_string_t p_text, const blit::Font &p_font )
+{
+  asset_text_t   *l_entry = find_text( p_text, p_font );
+
+  return ( nullptr == l_entry ) ? nullptr : l_entry->surface;
+}
+
+
+/*
+ * render_text - adds a string to a draw list, in the given colour, from its
+ *               cached mask; the mask is only referenced by the list, so a
+ *               frame mustn't draw more different strings and digits than
+ *               the cache holds, or the oldest will be reused under it.
+ *
+ * DrawList *        - the list to draw into.
+ * blit_string_t     - the id of the string.
+ * const blit::Font& - the font to draw in.
+ * blit::Point       - the point to draw it at.
+ * blit::Pen         - the colour to draw it in.
+ * blit::TextAlign   - how the text is aligned to the point.
+ */
+
+void AssetManager::render_text( DrawList *p_list, blit_string_t p_text, const blit::Font &p_font, 
+                                blit::Point p_point, blit::Pen p_pen, blit::TextAlign p_align )
+{
+  asset_text_t   *l_entry = find_text( p_text, p_font );
+
+  /* If we couldn't cache it, the engine can still draw it the slow way. */
+  if ( nullptr == l_entry )
+  {
+    p_list->text( get_string( p_text ), p_font, p_point, p_pen, p_align );
+    return;
+  }
+
+  /* Otherwise, just colour in the mask as we blit it. */
+  p_list->mask( l_entry->surface, text_origin( p_point, l_entry->surface->bounds, p_align ), p_pen );
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * render_number - adds a number to a draw list, in the given colour, a
+ *                 cached digit at a time.
+ *
+ * DrawList *        - the list to draw into.
+ * uint32_t          - the number to draw.
+ * const blit::Font& - the font to draw in.
+ * blit::Point       - the point to draw it at.
+ * blit::Pen         - the colour to draw it in.
+ * blit::TextAlign   - how the number is aligned to the point.
+ */
+
+void AssetManager::render_number( DrawList *p_list, uint32_t p_number, const blit::Font &p_font,
+                                  blit::Point p_point, blit::Pen p_pen, blit::TextAlign p_align )
+{
+  uint8_t         l_digits[10];
+  uint8_t         l_count = 0, l_index;
+  asset_text_t   *l_entry;
+  blit::Size      l_size( 0, 0 );
+
+  /* Split the number up, most significant digit last. */
+  do
+  {
+    l_digits[l_count++] = p_number % 10;
+    p_number /= 10;
+  } while ( p_number > 0 );
+
+  /* Work out how big the whole thing is, so we can align it. */
+  for ( l_index = l_count; l_index > 0; l_index-- )
+  {
+    l_entry = find_text( ASSET_TEXT_DIGIT( l_digits[l_index - 1] ), p_font );
+    if ( nullptr == l_entry )
+    {
+      return;
+    }
+    l_size.w += l_entry->surface->bounds.w + ( ( l_index > 1 ) ? l_entry->spacing : 0 );
+    l_size.h = l_entry->surface->bounds.h;
+  }
+  p_point = text_origin( p_point, l_size, p_align );
+
+  /* And then draw it, a digit at a time. */
+  for ( l_index = l_count; l_index > 0; l_index-- )
+  {
+    l_entry = find_text( ASSET_TEXT_DIGIT( l_digits[l_index - 1] ), p_font );
+    if ( nullptr == l_entry )
+    {
+      return;
+    }
+    p_list->mask( l_entry->surface, p_point, p_pen );
+    p_point.x += l_entry->surface->bounds.w + l_entry->spacing;
+  }
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * discard_layer - frees up the surface behind a layer, if it has one; it
+ *                 will be rebuilt the next time anyone asks for it.
+ *
+ * asset_layer_t * - the layer to discard.
+ */
+
+void AssetManager::discard_layer( asset_layer_t *p_layer )
+{
+  if ( nullptr != p_layer->surface )
+  {
+    blitarena_delete( p_layer->surface );
+    p_layer->surface = nullptr;
+  }
+  blitarena_free( p_layer->data );
+  p_layer->data = nullptr;
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * register_layer - registers a static layer; nothing is drawn until the
+ *                  layer is first fetched.
+ *
+ * asset_layer_builder_t - the function that draws the layer into a surface.
+ * void *                - context passed through to the builder.
+ *
+ * Returns int8_t, the layer identifier, or ASSET_NO_LAYER if we're full.
+ */
+
+int8_t AssetManager::register_layer( asset_layer_builder_t p_builder, void *p_context )
+{
+  int8_t  l_index;
+
+  /* Find a free slot. */
+  for ( l_index = 0; l_index < ASSET_MAX_LAYERS; l_index++ )
+  {
+    if ( nullptr == c_layers[l_index].builder )
+    {
+      c_layers[l_index].builder = p_builder;
+      c_layers[l_index].context = p_context;
+      return l_index;
+    }
+  }
+
+  /* No room at the inn. */
+  return ASSET_NO_LAYER;
+}
+
+
+/*
+ * release_layer - releases a layer, and the memory that goes with it.
+ *
+ * int8_t - the layer identifier.
+ */
+
+void AssetManager::release_layer( int8_t p_layer )
+{
+  /* Check that it's a sane layer. */
+  if ( ( p_layer < 0 ) || ( p_layer >= ASSET_MAX_LAYERS ) )
+  {
+    return;
+  }
+
+  /* Free up the surface, and the slot. */
+  discard_layer( &c_layers[p_layer] );
+  c_layers[p_layer].builder = nullptr;
+  c_layers[p_layer].context = nullptr;
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * get_layer - fetches the surface for a layer, building it if it hasn't been
+ *             yet or if the screen mode has changed since it was.
+ *
+ * int8_t - the layer identifier.
+ *
+ * Returns blit::Surface *, the layer, or nullptr if it isn't available.
+ */
+
+blit::Surface *AssetManager::get_layer( int8_t p_layer )
+{
+  asset_layer_t  *l_layer;
+
+  /* Check that it's a sane layer. */
+  if ( ( p_layer < 0 ) || ( p_layer >= ASSET_MAX_LAYERS ) || ( nullptr == c_layers[p_layer].builder ) )
+  {
+    return nullptr;
+  }
+  l_layer = &c_layers[p_layer];
+
+  /* If the screen has changed shape or format, the layer is stale. */
+  if ( ( nullptr != l_layer->surface ) && 
+       ( ( l_layer->surface->bounds.w != blit::screen.bounds.w ) ||
+         ( l_layer->surface->bounds.h != blit::screen.bounds.h ) ||
+         ( l_layer->surface->format != blit::screen.format ) ) )
+  {
+    discard_layer( l_layer );
+  }
+
+  /* Build it if we need to, matching the screen so it can be copied. */
+  if ( nullptr == l_layer->surface )
+  {
+    l_layer->data = (uint8_t *)blitarena_alloc( blit::screen.bounds.h * blit::screen.row_stride );
+    l_layer->surface = blitarena_new<blit::Surface>( l_layer->data, blit::screen.format, blit::screen.bounds );
+    if ( ( nullptr == l_layer->data ) || ( nullptr == l_layer->surface ) )
+    {
+      discard_layer( l_layer );
+      return nullptr;
+    }
+    l_layer->surface->palette = blit::screen.palette;
+    l_layer->builder( l_layer->surface, l_layer->context );
+  }
+
+  /* And hand it back. */
+  return l_layer->surface;
+}
+
+
+/*
+ * restore_layer - copies an area of a layer back into the framebuffer.
+ *
+ * int8_t     - the layer identifier.
+ * blit::Rect - the area to restore.
+ */
+
+void AssetManager::restore_layer( int8_t p_layer, blit::Rect p_rect )
+{
+  blit::Surface  *l_surface = get_layer( p_layer );
+
+  if ( nullptr != l_surface )
+  {
+    copy_surface( l_surface, p_rect );
+  }
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * copy_surface - copies an area of a screen-shaped surface straight into the
+ *                framebuffer, a row at a time; no blending is done, so this
+ *                is only useful for opaque, pre-composed layers.
+ *
+ * blit::Surface * - the surface to copy from.
+ * blit::Rect      - the area to copy, which is clipped to the target's clip.
+ * blit::Surface & - the framebuffer (or a banded copy of it) to copy into.
+ */
+
+void AssetManager::copy_surface( const blit::Surface *p_surface, blit::Rect p_rect, blit::Surface &p_target )
+{
+  uint32_t  l_offset, l_length;
+  int32_t   l_row;
+
+  /* Only copy what we're allowed to draw on. */
+  p_rect = p_rect.intersection( p_target.clip );
+  if ( p_rect.empty() )
+  {
+    return;
+  }
+
+  /* Then it's just a row at a time. */
+  l_length = p_rect.w * p_target.pixel_stride;
+  for ( l_row = p_rect.y; l_row < p_rect.y + p_rect.h; l_row++ )
+  {
+    l_offset = l_row * p_target.row_stride + p_rect.x * p_target.pixel_stride;
+    memcpy( p_target.data + l_offset, p_surface->data + l_offset, l_length );
+  }
+
+  /* All done. */
+  return;
+}
+
+
 /* End of file AssetManager.cpp */
@@ -5,6 +5,37 @@
  * neat and tidy. Managers are created in the main init, and passed into each
  * GameState object in turn.
  *
+ * Images are loaded lazily, the first time they're asked for. Images that
+ * can be used straight from flash cost nothing; packed images are decoded
+ * once, as 8 bit indexed surfaces, into a single arena allocated up front.
+ * When the arena is full the least recently used images are thrown away
+ * (to be decoded again if needed) and the rest slid down to close the gap.
+ * Indexed surfaces are only expanded to RGB through their palette as they
+ * are blitted. States can call preload() as they prepare, to get their images
+ * ready before they need them.
+ *
+ * It also keeps a small cache of static layers; full screen surfaces that a
+ * state composes once (through a builder function) and can then restore
+ * into the framebuffer with straight row copies. Layers are rebuilt if the
+ * screen mode changes, and should be released when a state is done with
+ * them, because each one costs a full framebuffer of RAM.
+ *
+ * Strings are compiled from strings/ at build time, along with how big each
+ * one is in every font (see tools/string-table.py), so get_layout() can say
+ * where text will go without measuring it.
+ *
+ * Text that's drawn every frame can be rasterised once into a mask, keyed
+ * on the string, language and font, and coloured in as it's blitted; the
+ * masks are thrown away when the language changes. Numbers are built up
+ * from a cached mask for each digit, so a score doesn't need a mask for
+ * every value it passes through.
+ *
+ * When the spritesheet is loaded, any sprites that asked for rotations (in
+ * sprites.yml) have them baked into a single rotation atlas, so that they
+ * can be drawn at any heading with a plain blit; and a collision mask is
+ * made for every frame of every sprite, at each quarter turn, and for each
+ * baked rotation. These are all kept even if the sheet itself is evicted.
+ *
  * Copyright (C) 2021 Pete Favelle <pete@fsquared.co.uk>
  *
  * This file is released under the MIT License; see LICENSE for more details.
@@ -13,35 +44,160 @@
 #ifndef   _ASSETMANAGER_HPP_
 #define   _ASSETMANAGER_HPP_
 
+#include "blitarena.hpp"
 #include "blitstrings.hpp"
+#include "blitmask.hpp"
+#include "DrawList.hpp"
+#include "SpriteIndex.hpp"
 #include "AssetsFonts.hpp"
 
 
 /* Constants & Macros. */
 
+#define ASSET_MAX_LAYERS    4
+#define ASSET_NO_LAYER      -1
+#define ASSET_MAX_TEXTS     16
+#define ASSET_TEXT_DIGIT(d) ( STR_MAX + (d) )
+
+#ifndef ASSET_RAM_BUDGET
+#define ASSET_RAM_BUDGET    ( 128 * 1024 )
+#endif
+
+/* Baked rotations are packed into rows of an atlas this wide. */
+#ifndef ASSET_ATLAS_WIDTH
+#define ASSET_ATLAS_WIDTH   256
+#endif
+
+
 /* Enums. */
 
+typedef enum
+{
+  ASSET_IMG_LOGO,
+  ASSET_IMG_SPRITESHEET,
+  ASSET_IMG_MAX
+} asset_image_t;
+
+
 /* Structs. */
 
+typedef struct
+{
+  blit::Surface          *surface;
+  blit::Pen              *palette;
+  blit::Pen              *loader_palette;
+  uint32_t                bytes;
+  uint32_t                last_used;
+  bool                    in_arena;
+} asset_image_entry_t;
+
+typedef struct
+{
+  blit::Surface          *surface;
+  const blit::Font       *font;
+  blit::Pen               palette[2];
+  uint16_t                text;
+  uint8_t                 spacing;
+  blit_lang_t             language;
+  uint32_t                last_used;
+} asset_text_t;
+
+typedef struct
+{
+  uint16_t                y;
+  uint8_t                 size;
+  uint8_t                 columns;
+} asset_rotation_t;
+
+typedef struct
+{
+  const blit::Surface    *surface;
+  blit::Rect              rect;
+  blit::Point             pivot;
+  uint8_t                 transform;
+  const blit_mask_t      *mask;
+} asset_pose_t;
+
+typedef void (*asset_layer_builder_t)( blit::Surface *, void * );
+
+typedef struct
+{
+  asset_layer_builder_t   builder;
+  void                   *context;
+  blit::Surface          *surface;
+  uint8_t                *data;
+} asset_layer_t;
+
+
 /* Classes. */
 
 class AssetManager
 {
 private:
   blit_lang_t       c_language;
+  asset_layer_t     c_layers[ASSET_MAX_LAYERS];
+  asset_image_entry_t c_images[ASSET_IMG_MAX];
+  uint32_t          c_image_budget;
+  uint32_t          c_image_bytes;
+  uint32_t          c_image_clock;
+  uint8_t          *c_arena;
+  uint32_t          c_arena_size;
+  uint32_t          c_arena_used;
+  asset_text_t      c_texts[ASSET_MAX_TEXTS];
+  uint32_t          c_text_clock;
+  blit_mask_t      *c_masks;
+  uint16_t          c_mask_first[SPRITE_MAX + 1];
+  asset_rotation_t  c_rotations[SPRITE_MAX];
+  blit::Surface    *c_atlas;
+  blit::Pen        *c_atlas_palette;
+
+  void              discard_layer( asset_layer_t * );
+  void              load_image( asset_image_t );
+  void              unload_image( asset_image_t );
+  bool              evict_image( asset_image_t );
+  uint8_t          *arena_alloc( uint32_t, asset_image_t );
+  void              arena_compact( void );
+  void              discard_text( asset_text_t * );
+  asset_text_t     *find_text( uint16_t, const blit::Font & );
+  blit_font_t       font_id( const blit::Font & );
+  void              build_masks( const blit::Surface * );
+  void              bake_rotations( const blit::Surface * );
 
 public:
+  BLITARENA_OBJECT
+
                     AssetManager( void );
                    ~AssetManager();
 
-  blit::Surface    *c_img_logo;
-  blit::Surface    *c_img_spritesheet;
-
   const blit::Font  font_null = blit::Font( a_font_null16 );
 
   void              set_language( blit_lang_t );
   blit_lang_t       get_language( void );
   const char       *get_string( blit_string_t );
+  const blit_layout_t *get_layout( blit_string_t, const blit::Font & );
+#ifndef   TARGET_32BLIT_HW
+  void              check_layouts( void );
+#endif /* TARGET_32BLIT_HW */
+
+  blit::Surface    *get_image( asset_image_t );
+  void              preload( asset_image_t );
+  void              set_image_budget( uint32_t );
+  uint32_t          get_image_bytes( void ) { return c_image_bytes; };
+  void              report_images( void );
+  const blit_mask_t *get_mask( sprite_t, uint8_t, uint8_t );
+  bool              get_pose( sprite_t, uint16_t, asset_pose_t * );
+
+  blit::Surface    *get_text( blit_string_t, const blit::Font & );
+  void              render_text( DrawList *, blit_string_t, const blit::Font &, blit::Point, blit::Pen,
+                                 blit::TextAlign = blit::TextAlign::top_left );
+  void              render_number( DrawList *, uint32_t, const blit::Font &, blit::Point, blit::Pen,
+                                   blit::TextAlign = blit::TextAlign::top_left );
+
+  int8_t            register_layer( asset_layer_builder_t, void * );
+  void              release_layer( int8_t );
+  blit::Surface    *get_layer( int8_t );
+  void              restore_layer( int8_t, blit::Rect );
+  static void       copy_surface( const blit::Surface *, blit::Rect, blit::Surface & = blit::screen );
 
 };
 
@@ -13,6 +13,8 @@
 #ifndef   _OUTPUTMANAGER_HPP_
 #define   _OUTPUTMANAGER_HPP_
 
+#include "blitarena.hpp"
+
 /* Constants & Macros. */
 
 /* Enums. */
@@ -34,6 +36,8 @@ private:
   output_flags_t  c_flags;
 
 public:
+  BLITARENA_OBJECT
+
                   OutputManager( void );
                  ~OutputManager();
 };
@@ -0,0 +1,239 @@
+/*
+ * PerfManager.cpp - part of Blitroids, a 32Blit game.
+ *
+ * The PerfManager keeps track of how long each state spends in update,
+ * render and transitions, so we can tell where a dropped frame came from;
+ * it holds a short history of timings per state, as well as running totals,
+ * counts skipped frames and can draw a summary over the top of the game.
+ *
+ * Copyright (C) 2021 Pete Favelle <pete@fsquared.co.uk>
+ *
+ * This file is released under the MIT License; see LICENSE for more details.
+ */
+
+/* System headers. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+/* Local headers. */
+
+#include "32blit.hpp"
+#include "blitroids.hpp"
+#include "PerfManager.hpp"
+
+
+/* Module variables. */
+
+static const char *m_phase_names[PERF_MAX] = { "upd", "rnd", "trn" };
+
+
+/* Functions. */
+
+/*
+ * perf_compare - qsort comparison for sample values.
+ */
+
+static int perf_compare( const void *p_a, const void *p_b )
+{
+  return *(const uint16_t *)p_a - *(const uint16_t *)p_b;
+}
+
+
+/*
+ * PerfManager - constructor, which starts with empty histories.
+ */
+
+PerfManager::PerfManager( void )
+{
+  /* Clear out all the sample rings, and the totals. */
+  memset( c_rings, 0, sizeof( c_rings ) );
+  memset( c_totals, 0, sizeof( c_totals ) );
+
+  /* No frames seen yet, and the overlay starts off. */
+  c_frame_skips = 0;
+  c_last_frame = 0;
+  c_overlay = false;
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * ~PerfManager - destructor, and cleanup that needs doing.
+ */
+
+PerfManager::~PerfManager()
+{
+  /* All done. */
+  return;
+}
+
+
+/*
+ * record - adds a timing sample to the history of a state.
+ *
+ * state_t      - the state the time was spent in.
+ * perf_phase_t - which phase of the state it was spent in.
+ * uint32_t     - the time taken, in microseconds.
+ */
+
+void PerfManager::record( state_t p_state, perf_phase_t p_phase, uint32_t p_us )
+{
+  perf_ring_t *l_ring = &c_rings[p_state][p_phase];
+
+  /* Save it in the next slot, clamping anything silly. */
+  l_ring->samples[l_ring->next] = ( p_us > UINT16_MAX ) ? UINT16_MAX : p_us;
+  l_ring->next = ( l_ring->next + 1 ) % PERF_SAMPLES;
+  if ( l_ring->count < PERF_SAMPLES )
+  {
+    l_ring->count++;
+  }
+
+  /* The totals keep everything, unclamped. */
+  c_totals[p_state][p_phase].count++;
+  c_totals[p_state][p_phase].us += p_us;
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * frame - called once per rendered frame, to spot frames the engine had
+ *         to skip because we ran out of time.
+ *
+ * uint32_t - the time in milliseconds since the epoch.
+ */
+
+void PerfManager::frame( uint32_t p_time )
+{
+  uint32_t  l_gap = p_time - c_last_frame;
+
+  /* Any gap of more than a frame and a half means we lost some. */
+  if ( ( c_last_frame > 0 ) && ( l_gap > PERF_FRAME_MS + PERF_FRAME_MS / 2 ) )
+  {
+    c_frame_skips += ( l_gap + PERF_FRAME_MS / 2 ) / PERF_FRAME_MS - 1;
+  }
+  c_last_frame = p_time;
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * stats - summarises the recent history of a state.
+ *
+ * state_t      - the state to summarise.
+ * perf_phase_t - which phase of the state to summarise.
+ *
+ * Returns perf_stats_t, the min, mean and 99th percentile times in us.
+ */
+
+perf_stats_t PerfManager::stats( state_t p_state, perf_phase_t p_phase )
+{
+  const perf_ring_t  *l_ring = &c_rings[p_state][p_phase];
+  perf_stats_t        l_stats = { 0, 0, 0 };
+  uint16_t            l_sorted[PERF_SAMPLES];
+  uint32_t            l_total = 0;
+  uint16_t            l_index;
+
+  /* Nothing to do if we have no samples. */
+  if ( 0 == l_ring->count )
+  {
+    return l_stats;
+  }
+
+  /* Sort a copy of the samples, so we can pick out the percentiles. */
+  memcpy( l_sorted, l_ring->samples, l_ring->count * sizeof( uint16_t ) );
+  qsort( l_sorted, l_ring->count, sizeof( uint16_t ), perf_compare );
+  for ( l_index = 0; l_index < l_ring->count; l_index++ )
+  {
+    l_total += l_sorted[l_index];
+  }
+
+  l_stats.min = l_sorted[0];
+  l_stats.avg = l_total / l_ring->count;
+  l_stats.p99 = l_sorted[( l_ring->count * 99 ) / 100];
+
+  return l_stats;
+}
+
+
+/*
+ * totals - how much time a state has spent in a phase, ever.
+ *
+ * state_t      - the state to total.
+ * perf_phase_t - which phase of the state to total.
+ *
+ * Returns perf_totals_t, the number of timings recorded and their sum in us.
+ */
+
+perf_totals_t PerfManager::totals( state_t p_state, perf_phase_t p_phase )
+{
+  return c_totals[p_state][p_phase];
+}
+
+
+/*
+ * get_frame_skips - the number of frames skipped since we started.
+ */
+
+uint32_t PerfManager::get_frame_skips( void )
+{
+  return c_frame_skips;
+}
+
+
+/*
+ * toggle_overlay - switches the on-screen overlay on or off.
+ */
+
+void PerfManager::toggle_overlay( void )
+{
+  c_overlay = !c_overlay;
+  return;
+}
+
+
+/*
+ * render_overlay - draws the timing summary for a state over the top of
+ *                  whatever is on the screen; only called when enabled.
+ *
+ * state_t - the state to summarise.
+ */
+
+void PerfManager::render_overlay( state_t p_state )
+{
+  char          l_buffer[32];
+  perf_stats_t  l_stats;
+  uint8_t       l_phase;
+  blit::Point   l_cursor( 4, 4 );
+
+  /* Dim a box in the corner, to keep the text readable. */
+  blit::screen.pen = blit::Pen( 0, 0, 0, 160 );
+  blit::screen.rectangle( blit::Rect( 0, 0, 120, 48 ) );
+
+  /* Then a line for each phase, and the skip count. */
+  blit::screen.pen = blit::Pen( 255, 255, 0 );
+  for ( l_phase = 0; l_phase < PERF_MAX; l_phase++ )
+  {
+    l_stats = stats( p_state, (perf_phase_t)l_phase );
+    snprintf( l_buffer, sizeof( l_buffer ), "%s %u/%u/%u",
+              m_phase_names[l_phase], l_stats.min, l_stats.avg, l_stats.p99 );
+    blit::screen.text( l_buffer, blit::minimal_font, l_cursor );
+    l_cursor.y += 10;
+  }
+  snprintf( l_buffer, sizeof( l_buffer ), "skip %lu", (unsigned long)c_frame_skips );
+  blit::screen.text( l_buffer, blit::minimal_font, l_cursor );
+
+  /* All done. */
+  return;
+}
+
+
+/* End of file PerfManager.cpp */
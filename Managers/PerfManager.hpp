@@ -0,0 +1,120 @@
+/*
+ * PerfManager.hpp - part of Blitroids, a 32Blit game.
+ *
+ * The PerfManager keeps track of how long each state spends in update,
+ * render and transitions, so we can tell where a dropped frame came from;
+ * it holds a short history of timings per state, as well as running totals,
+ * counts skipped frames and can draw a summary over the top of the game.
+ *
+ * Copyright (C) 2021 Pete Favelle <pete@fsquared.co.uk>
+ *
+ * This file is released under the MIT License; see LICENSE for more details.
+ */
+
+#ifndef   _PERFMANAGER_HPP_
+#define   _PERFMANAGER_HPP_
+
+#include "32blit.hpp"
+#include "StateInterface.hpp"
+
+
+/* Constants & Macros. */
+
+#define PERF_SAMPLES        128
+#define PERF_FRAME_MS       20
+
+
+/* Enums. */
+
+typedef enum
+{
+  PERF_UPDATE,
+  PERF_RENDER,
+  PERF_TRANSITION,
+  PERF_MAX
+} perf_phase_t;
+
+
+/* Structs. */
+
+typedef struct
+{
+  uint16_t  samples[PERF_SAMPLES];
+  uint16_t  next;
+  uint16_t  count;
+} perf_ring_t;
+
+typedef struct
+{
+  uint16_t  min;
+  uint16_t  avg;
+  uint16_t  p99;
+} perf_stats_t;
+
+typedef struct
+{
+  uint32_t  count;
+  uint64_t  us;
+} perf_totals_t;
+
+
+/* Classes. */
+
+class PerfManager
+{
+private:
+  perf_ring_t       c_rings[STATE_MAX][PERF_MAX];
+  perf_totals_t     c_totals[STATE_MAX][PERF_MAX];
+  uint32_t          c_frame_skips;
+  uint32_t          c_last_frame;
+  bool              c_overlay;
+
+public:
+  BLITARENA_OBJECT
+
+                    PerfManager( void );
+                   ~PerfManager();
+
+  void              record( state_t, perf_phase_t, uint32_t );
+  void              frame( uint32_t );
+  perf_stats_t      stats( state_t, perf_phase_t );
+  perf_totals_t     totals( state_t, perf_phase_t );
+  uint32_t          get_frame_skips( void );
+
+  void              toggle_overlay( void );
+  bool              overlay_enabled( void ) { return c_overlay; };
+  void              render_overlay( state_t );
+};
+
+
+/*
+ * PerfTimer - a scoped timer; measures from construction to destruction,
+ *             and records the time against the given state and phase. With
+ *             no manager to record to, it does nothing.
+ */
+
+class PerfTimer
+{
+private:
+  PerfManager      *c_manager;
+  state_t           c_state;
+  perf_phase_t      c_phase;
+  uint32_t          c_start;
+
+public:
+                    PerfTimer( PerfManager *p_manager, state_t p_state, perf_phase_t p_phase )
+                      : c_manager( p_manager ), c_state( p_state ), c_phase( p_phase ),
+                        c_start( blit::now_us() ) {};
+                   ~PerfTimer()
+                    {
+                      if ( nullptr != c_manager )
+                      {
+                        c_manager->record( c_state, c_phase, blit::us_diff( c_start, blit::now_us() ) );
+                      }
+                    };
+};
+
+
+#endif /* _PERFMANAGER_HPP_ */
+
+/* End of file PerfManager.hpp */
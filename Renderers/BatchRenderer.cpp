@@ -0,0 +1,428 @@
+/*
+ * BatchRenderer.cpp - part of Blitroids, a 32Blit game.
+ *
+ * The BatchRenderer draws large numbers of single pixel points (stars,
+ * particles and the like) straight into the framebuffer. Points are given
+ * as parallel arrays of positions and colours; the positions are clipped
+ * in one pass into packed screen coordinates, and then blended in bulk,
+ * rather than going through the engine's per-pixel path for each one.
+ *
+ * The blend matches the engine's own RGBA onto RGB blend exactly. On the
+ * handheld (and anywhere without SSE2) the red and blue channels share a
+ * single 32 bit multiply; with SSE2, four points are blended at once.
+ *
+ * Copyright (C) 2021 Pete Favelle <pete@fsquared.co.uk>
+ *
+ * This file is released under the MIT License; see LICENSE for more details.
+ */
+
+/* System headers. */
+
+#include <string.h>
+
+#if defined( __SSE2__ )
+#include <emmintrin.h>
+#endif
+
+
+/* Local headers. */
+
+#include "32blit.hpp"
+#include "BatchRenderer.hpp"
+
+
+/* Constants & Macros. */
+
+/* How many points a band picks out before blending them. */
+#define BATCH_KEPT        64
+
+
+/* Functions. */
+
+/*
+ * batch_alpha - works out the blend weight for a pen on a surface, as the
+ *               engine does; fully opaque is returned as 256 so that the
+ *               blend below becomes a straight copy.
+ *
+ * uint8_t - the pen alpha.
+ * uint8_t - the surface alpha.
+ *
+ * Returns uint32_t, the weight (0 - 256).
+ */
+
+static inline uint32_t batch_alpha( uint8_t p_pen_alpha, uint8_t p_surface_alpha )
+{
+  uint32_t  l_alpha;
+
+  /* A transparent pen leaves the pixel alone. */
+  if ( 0 == p_pen_alpha )
+  {
+    return 0;
+  }
+
+  l_alpha = ( ( p_pen_alpha + 1 ) * ( p_surface_alpha + 1 ) ) >> 8;
+  return ( l_alpha >= 255 ) ? 256 : l_alpha;
+}
+
+
+/*
+ * batch_blend - blends a single pen into an RGB pixel. The engine works out
+ *               d + ( ( a * ( s - d ) + 127 ) >> 8 ), which is the same as
+ *               ( d * ( 256 - a ) + s * a + 127 ) >> 8; the latter never
+ *               goes negative, so red and blue can share a multiply.
+ *
+ * uint8_t *         - the pixel to blend into.
+ * const blit::Pen & - the pen to blend.
+ * uint32_t          - the weight, from batch_alpha().
+ */
+
+static inline void batch_blend( uint8_t *p_pixel, const blit::Pen &p_pen, uint32_t p_alpha )
+{
+  uint32_t  l_rb, l_g;
+
+  l_rb = ( ( ( p_pixel[0] | ( p_pixel[2] << 16 ) ) * ( 256 - p_alpha ) 
+         + ( p_pen.r | ( p_pen.b << 16 ) ) * p_alpha + 0x007f007f ) >> 8 ) & 0x00ff00ff;
+  l_g = ( p_pixel[1] * ( 256 - p_alpha ) + p_pen.g * p_alpha + 0x7f ) >> 8;
+
+  p_pixel[0] = l_rb;
+  p_pixel[1] = l_g;
+  p_pixel[2] = l_rb >> 16;
+
+  /* All done. */
+  return;
+}
+
+
+#if defined( __SSE2__ )
+/*
+ * batch_blend4 - blends four pens into four distinct RGB pixels at once.
+ *                Each pixel is read as a whole 32 bit word, so none of them
+ *                can be the very last pixel in the framebuffer.
+ *
+ * uint8_t **        - the four pixels to blend into.
+ * const blit::Pen * - the four pens to blend.
+ * const uint32_t *  - the four weights, from batch_alpha().
+ */
+
+static inline void batch_blend4( uint8_t **p_pixel, const blit::Pen *p_pen, const uint32_t *p_alpha )
+{
+  const __m128i l_zero = _mm_setzero_si128();
+  const __m128i l_full = _mm_set1_epi16( 256 );
+  const __m128i l_half = _mm_set1_epi16( 127 );
+  __m128i       l_dest, l_src, l_alpha_lo, l_alpha_hi, l_lo, l_hi;
+  uint32_t      l_words[4];
+  uint8_t       l_lane;
+
+  /* Gather the destination pixels, one per 32 bit lane; the pens are */
+  /* already laid out as r, g, b, a so can be loaded as they are.     */
+  for ( l_lane = 0; l_lane < 4; l_lane++ )
+  {
+    memcpy( &l_words[l_lane], p_pixel[l_lane], sizeof( uint32_t ) );
+  }
+  l_dest = _mm_loadu_si128( (const __m128i *)l_words );
+  l_src = _mm_loadu_si128( (const __m128i *)p_pen );
+  l_alpha_lo = _mm_set_epi16( p_alpha[1], p_alpha[1], p_alpha[1], p_alpha[1],
+                              p_alpha[0], p_alpha[0], p_alpha[0], p_alpha[0] );
+  l_alpha_hi = _mm_set_epi16( p_alpha[3], p_alpha[3], p_alpha[3], p_alpha[3],
+                              p_alpha[2], p_alpha[2], p_alpha[2], p_alpha[2] );
+
+  /* Widen to 16 bit channels, and blend; nothing here exceeds 65535. */
+  l_lo = _mm_add_epi16( 
+    _mm_mullo_epi16( _mm_unpacklo_epi8( l_dest, l_zero ), _mm_sub_epi16( l_full, l_alpha_lo ) ),
+    _mm_mullo_epi16( _mm_unpacklo_epi8( l_src, l_zero ), l_alpha_lo )
+  );
+  l_hi = _mm_add_epi16( 
+    _mm_mullo_epi16( _mm_unpackhi_epi8( l_dest, l_zero ), _mm_sub_epi16( l_full, l_alpha_hi ) ),
+    _mm_mullo_epi16( _mm_unpackhi_epi8( l_src, l_zero ), l_alpha_hi )
+  );
+  l_lo = _mm_srli_epi16( _mm_add_epi16( l_lo, l_half ), 8 );
+  l_hi = _mm_srli_epi16( _mm_add_epi16( l_hi, l_half ), 8 );
+
+  /* Narrow back down, and scatter just the RGB bytes back out. */
+  _mm_storeu_si128( (__m128i *)l_words, _mm_packus_epi16( l_lo, l_hi ) );
+  for ( l_lane = 0; l_lane < 4; l_lane++ )
+  {
+    memcpy( p_pixel[l_lane], &l_words[l_lane], 3 );
+  }
+
+  /* All done. */
+  return;
+}
+#endif
+
+
+/*
+ * batch_point - blends one packed point into an RGB surface, if it's inside
+ *               the clip.
+ *
+ * blit::Surface &   - the surface to draw on.
+ * uint32_t          - the packed point.
+ * const blit::Pen & - the colour of the point.
+ * bool              - true if the point is known to be inside the clip.
+ */
+
+static inline void batch_point( blit::Surface &p_surface, uint32_t p_point, 
+                                const blit::Pen &p_pen, bool p_clipped )
+{
+  if ( BATCH_OFFSCREEN == p_point )
+  {
+    return;
+  }
+  if ( !p_clipped && !p_surface.clip.contains( blit::Point( BATCH_X( p_point ), BATCH_Y( p_point ) ) ) )
+  {
+    return;
+  }
+
+  batch_blend( p_surface.data + BATCH_Y( p_point ) * p_surface.row_stride + BATCH_X( p_point ) * 3,
+               p_pen, batch_alpha( p_pen.a, p_surface.alpha ) );
+
+  /* All done. */
+  return;
+}
+
+
+#if defined( __SSE2__ )
+/*
+ * batch_kept - blends points picked out by batch_band(), four at a time;
+ *              they're all inside the clip, so only a group where two share
+ *              a pixel, or one is the very last pixel (which can't be read
+ *              as a word), has to be done one at a time, to keep the order.
+ *
+ * blit::Surface &   - the surface to draw on.
+ * const uint32_t *  - the packed points.
+ * const blit::Pen * - the colour of each point.
+ * const uint32_t *  - the indices of the points picked out, in order.
+ * uint32_t          - the number of points picked out.
+ */
+
+static void batch_kept( blit::Surface &p_surface, const uint32_t *p_points,
+                        const blit::Pen *p_pens, const uint32_t *p_kept, uint32_t p_count )
+{
+  const uint32_t  l_last = BATCH_PACK( p_surface.bounds.w - 1, p_surface.bounds.h - 1 );
+  uint8_t        *l_pixels[4];
+  uint32_t        l_alphas[4], l_point[4], l_index;
+  blit::Pen       l_pens[4];
+  uint8_t         l_lane;
+
+  for ( l_index = 0; l_index + 4 <= p_count; l_index += 4 )
+  {
+    for ( l_lane = 0; l_lane < 4; l_lane++ )
+    {
+      l_point[l_lane] = p_points[p_kept[l_index+l_lane]];
+      l_pens[l_lane] = p_pens[p_kept[l_index+l_lane]];
+    }
+
+    if ( ( l_point[0] == l_last ) || ( l_point[1] == l_last ) ||
+         ( l_point[2] == l_last ) || ( l_point[3] == l_last ) ||
+         ( l_point[0] == l_point[1] ) || ( l_point[0] == l_point[2] ) || ( l_point[0] == l_point[3] ) ||
+         ( l_point[1] == l_point[2] ) || ( l_point[1] == l_point[3] ) || ( l_point[2] == l_point[3] ) )
+    {
+      for ( l_lane = 0; l_lane < 4; l_lane++ )
+      {
+        batch_point( p_surface, l_point[l_lane], l_pens[l_lane], true );
+      }
+      continue;
+    }
+
+    for ( l_lane = 0; l_lane < 4; l_lane++ )
+    {
+      l_pixels[l_lane] = p_surface.data + BATCH_Y( l_point[l_lane] ) * p_surface.row_stride
+                       + BATCH_X( l_point[l_lane] ) * 3;
+      l_alphas[l_lane] = batch_alpha( l_pens[l_lane].a, p_surface.alpha );
+    }
+    batch_blend4( l_pixels, l_pens, l_alphas );
+  }
+
+  /* And the odd few left over. */
+  for ( ; l_index < p_count; l_index++ )
+  {
+    batch_point( p_surface, p_points[p_kept[l_index]], p_pens[p_kept[l_index]], true );
+  }
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * batch_band - blends points into a surface clipped to a band of its rows,
+ *              the full width across, as DrawList draws in parallel. Packed
+ *              points sort by row, so a single range test says whether one
+ *              is in the band; the ones that are get picked out, in order
+ *              and without branching, and then blended four at a time, so a
+ *              band costs a quick scan plus its own share of the blending.
+ *
+ * blit::Surface &   - the surface to draw on.
+ * const uint32_t *  - the packed points, from batch_project().
+ * const blit::Pen * - the colour of each point.
+ * uint32_t          - the number of points.
+ */
+
+static void batch_band( blit::Surface &p_surface, const uint32_t *p_points,
+                        const blit::Pen *p_pens, uint32_t p_count )
+{
+  const uint32_t  l_first = BATCH_PACK( 0, p_surface.clip.y );
+  const uint32_t  l_span = BATCH_PACK( 0, p_surface.clip.y + p_surface.clip.h ) - l_first;
+  uint32_t        l_kept[BATCH_KEPT];
+  uint32_t        l_index, l_count = 0;
+
+  for ( l_index = 0; l_index < p_count; l_index++ )
+  {
+    /* Every index is written, but only ours move the count on; anything */
+    /* off screen is BATCH_OFFSCREEN, which is never in range.           */
+    l_kept[l_count] = l_index;
+    l_count += ( ( p_points[l_index] - l_first ) < l_span );
+
+    if ( BATCH_KEPT == l_count )
+    {
+      batch_kept( p_surface, p_points, p_pens, l_kept, l_count );
+      l_count = 0;
+    }
+  }
+  batch_kept( p_surface, p_points, p_pens, l_kept, l_count );
+
+  /* All done. */
+  return;
+}
+#endif
+
+
+/*
+ * batch_project - the single clip pass; works out where each point falls
+ *                 part way between its previous and current location, and
+ *                 packs it into screen coordinates, or BATCH_OFFSCREEN if it
+ *                 falls outside the clip. Written to be vectorised.
+ *
+ * const blit::Rect & - the clip rectangle.
+ * const float *      - the previous x coordinates.
+ * const float *      - the previous y coordinates.
+ * const float *      - the current x coordinates.
+ * const float *      - the current y coordinates.
+ * float              - how far from previous to current (0.0 - 1.0)
+ * uint32_t           - the number of points.
+ * uint32_t *         - where to write the packed points.
+ */
+
+void batch_project( const blit::Rect &p_clip, 
+                    const float *__restrict p_prev_x, const float *__restrict p_prev_y,
+                    const float *__restrict p_x, const float *__restrict p_y, 
+                    float p_alpha, uint32_t p_count, uint32_t *__restrict p_points )
+{
+  const int32_t l_left = p_clip.x, l_right = p_clip.x + p_clip.w;
+  const int32_t l_top = p_clip.y, l_bottom = p_clip.y + p_clip.h;
+  int32_t       l_x, l_y;
+  uint32_t      l_index;
+
+  for ( l_index = 0; l_index < p_count; l_index++ )
+  {
+    /* Truncate, as blit::Point does. */
+    l_x = (int32_t)( p_prev_x[l_index] + ( p_x[l_index] - p_prev_x[l_index] ) * p_alpha );
+    l_y = (int32_t)( p_prev_y[l_index] + ( p_y[l_index] - p_prev_y[l_index] ) * p_alpha );
+
+    p_points[l_index] = ( ( l_x >= l_left ) & ( l_x < l_right ) & ( l_y >= l_top ) & ( l_y < l_bottom ) )
+                      ? BATCH_PACK( l_x, l_y ) : BATCH_OFFSCREEN;
+  }
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * batch_points - blends a batch of packed points into a surface, in order,
+ *                so that later points land on top of earlier ones. Points
+ *                outside the surface's current clip are skipped; anything
+ *                but a plain RGB surface goes through the engine instead.
+ *
+ * blit::Surface &   - the surface to draw on.
+ * const uint32_t *  - the packed points, from batch_project().
+ * const blit::Pen * - the colour of each point.
+ * uint32_t          - the number of points.
+ */
+
+void batch_points( blit::Surface &p_surface, const uint32_t *p_points, 
+                   const blit::Pen *p_pens, uint32_t p_count )
+{
+  uint32_t    l_index;
+  bool        l_full_clip;
+#if defined( __SSE2__ )
+  uint8_t    *l_pixels[4];
+  uint32_t    l_alphas[4];
+  uint32_t    l_last;
+  uint8_t     l_lane;
+#endif
+
+  /* If we can't write directly, let the engine deal with it. */
+  if ( ( blit::PixelFormat::RGB != p_surface.format ) || ( nullptr != p_surface.mask ) )
+  {
+    for ( l_index = 0; l_index < p_count; l_index++ )
+    {
+      if ( BATCH_OFFSCREEN != p_points[l_index] )
+      {
+        p_surface.pen = p_pens[l_index];
+        p_surface.pixel( blit::Point( BATCH_X( p_points[l_index] ), BATCH_Y( p_points[l_index] ) ) );
+      }
+    }
+    return;
+  }
+
+  /* Points were clipped to the screen; only check them again if the */
+  /* surface is currently clipped to something smaller.              */
+  l_full_clip = ( 0 == p_surface.clip.x ) && ( 0 == p_surface.clip.y ) &&
+                ( p_surface.bounds.w == p_surface.clip.w ) && ( p_surface.bounds.h == p_surface.clip.h );
+
+  l_index = 0;
+
+#if defined( __SSE2__ )
+  /* Four at a time, if they're all visible and no two share a pixel; */
+  /* any group that isn't gets done one at a time, to keep the order. */
+  /* The very last pixel can't be read as a word, so avoid that too.  */
+  if ( l_full_clip )
+  {
+    l_last = BATCH_PACK( p_surface.bounds.w - 1, p_surface.bounds.h - 1 );
+    for ( ; l_index + 4 <= p_count; l_index += 4 )
+    {
+      if ( ( p_points[l_index] >= l_last ) || ( p_points[l_index+1] >= l_last ) ||
+           ( p_points[l_index+2] >= l_last ) || ( p_points[l_index+3] >= l_last ) ||
+           ( p_points[l_index] == p_points[l_index+1] ) || ( p_points[l_index] == p_points[l_index+2] ) ||
+           ( p_points[l_index] == p_points[l_index+3] ) || ( p_points[l_index+1] == p_points[l_index+2] ) ||
+           ( p_points[l_index+1] == p_points[l_index+3] ) || ( p_points[l_index+2] == p_points[l_index+3] ) )
+      {
+        for ( l_lane = 0; l_lane < 4; l_lane++ )
+        {
+          batch_point( p_surface, p_points[l_index+l_lane], p_pens[l_index+l_lane], true );
+        }
+        continue;
+      }
+
+      for ( l_lane = 0; l_lane < 4; l_lane++ )
+      {
+        l_pixels[l_lane] = p_surface.data + BATCH_Y( p_points[l_index+l_lane] ) * p_surface.row_stride
+                         + BATCH_X( p_points[l_index+l_lane] ) * 3;
+        l_alphas[l_lane] = batch_alpha( p_pens[l_index+l_lane].a, p_surface.alpha );
+      }
+      batch_blend4( l_pixels, &p_pens[l_index], l_alphas );
+    }
+  }
+
+  /* A band of the surface, the full width across, can still go four at */
+  /* a time once its own points are picked out.                         */
+  if ( !l_full_clip && ( 0 == p_surface.clip.x ) && ( p_surface.bounds.w == p_surface.clip.w ) )
+  {
+    batch_band( p_surface, p_points, p_pens, p_count );
+    return;
+  }
+#endif
+
+  /* And anything left over, one at a time. */
+  for ( ; l_index < p_count; l_index++ )
+  {
+    batch_point( p_surface, p_points[l_index], p_pens[l_index], l_full_clip );
+  }
+
+  /* All done. */
+  return;
+}
+
+
+/* End of file BatchRenderer.cpp */
@@ -0,0 +1,38 @@
+/*
+ * BatchRenderer.hpp - part of Blitroids, a 32Blit game.
+ *
+ * The BatchRenderer draws large numbers of single pixel points (stars,
+ * particles and the like) straight into the framebuffer. Points are given
+ * as parallel arrays of positions and colours; the positions are clipped
+ * in one pass into packed screen coordinates, and then blended in bulk,
+ * rather than going through the engine's per-pixel path for each one.
+ *
+ * Copyright (C) 2021 Pete Favelle <pete@fsquared.co.uk>
+ *
+ * This file is released under the MIT License; see LICENSE for more details.
+ */
+
+#ifndef   _BATCHRENDERER_HPP_
+#define   _BATCHRENDERER_HPP_
+
+#include "32blit.hpp"
+
+
+/* Constants & Macros. */
+
+#define BATCH_OFFSCREEN         0xffffffff
+#define BATCH_PACK( x, y )      ( ( (uint32_t)(y) << 16 ) | ( (uint32_t)(x) & 0xffff ) )
+#define BATCH_X( p )            ( (int32_t)( (p) & 0xffff ) )
+#define BATCH_Y( p )            ( (int32_t)( (p) >> 16 ) )
+
+
+/* Functions. */
+
+void  batch_project( const blit::Rect &, const float *, const float *,
+                     const float *, const float *, float, uint32_t, uint32_t * );
+void  batch_points( blit::Surface &, const uint32_t *, const blit::Pen *, uint32_t );
+
+
+#endif /* _BATCHRENDERER_HPP_ */
+
+/* End of file BatchRenderer.hpp */
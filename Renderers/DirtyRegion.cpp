@@ -0,0 +1,144 @@
+/*
+ * DirtyRegion.cpp - part of Blitroids, a 32Blit game.
+ *
+ * A DirtyRegion keeps track of the parts of the screen that have changed
+ * since the last frame, so that a state can redraw just those rather than
+ * the whole screen. Changes are tracked as individual pixels (for things
+ * like stars) and as rectangles (for things like text); if too much has
+ * changed to track, or something has disturbed the screen behind our back,
+ * the whole region is simply marked invalid and a full redraw is needed.
+ *
+ * Copyright (C) 2021 Pete Favelle <pete@fsquared.co.uk>
+ *
+ * This file is released under the MIT License; see LICENSE for more details.
+ */
+
+/* System headers. */
+
+#include <stdlib.h>
+
+
+/* Local headers. */
+
+#include "32blit.hpp"
+#include "blitarena.hpp"
+#include "DirtyRegion.hpp"
+
+
+/* Functions. */
+
+/*
+ * ~DirtyRegion - destructor, cleans up anything we allocated.
+ */
+
+DirtyRegion::~DirtyRegion()
+{
+  /* Throw away the pixel list. */
+  blitarena_free( c_pixels );
+  c_pixels = nullptr;
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * set_capacity - sizes the pixel list; anything that needs more pixels than
+ *                this in a frame falls back to a full redraw.
+ *
+ * uint32_t - the number of pixels we can track.
+ */
+
+void DirtyRegion::set_capacity( uint32_t p_capacity )
+{
+  uint32_t *l_pixels;
+
+  /* Nothing to do if we're already this size. */
+  if ( p_capacity == c_pixel_capacity )
+  {
+    return;
+  }
+
+  /* Reallocate the list; if that fails, we'll just always be invalid. */
+  l_pixels = ( 0 == p_capacity ) ? nullptr : (uint32_t *)blitarena_realloc( c_pixels, p_capacity * sizeof( uint32_t ) );
+  if ( nullptr == l_pixels )
+  {
+    c_pixel_capacity = 0;
+    blitarena_free( c_pixels );
+    c_pixels = nullptr;
+  }
+  else
+  {
+    c_pixels = l_pixels;
+    c_pixel_capacity = p_capacity;
+  }
+
+  /* Whatever we were tracking is lost now. */
+  c_pixel_count = 0;
+  c_invalid = true;
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * reset - empties the region, ready to track a new frame.
+ */
+
+void DirtyRegion::reset( void )
+{
+  c_pixel_count = 0;
+  c_rect_count = 0;
+  c_invalid = false;
+  return;
+}
+
+
+/*
+ * add_pixel - marks a single pixel as changed.
+ *
+ * int32_t - the x coordinate of the pixel.
+ * int32_t - the y coordinate of the pixel.
+ */
+
+void DirtyRegion::add_pixel( int32_t p_x, int32_t p_y )
+{
+  /* If we've run out of room, the whole frame needs redrawing. */
+  if ( c_pixel_count >= c_pixel_capacity )
+  {
+    c_invalid = true;
+    return;
+  }
+
+  /* Otherwise, pack it into the list. */
+  c_pixels[c_pixel_count++] = ( (uint32_t)p_y << 16 ) | ( (uint32_t)p_x & 0xffff );
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * add_rect - marks a rectangle as changed.
+ *
+ * blit::Rect - the changed area.
+ */
+
+void DirtyRegion::add_rect( blit::Rect p_rect )
+{
+  /* If we've run out of room, the whole frame needs redrawing. */
+  if ( c_rect_count >= DIRTY_MAX_RECTS )
+  {
+    c_invalid = true;
+    return;
+  }
+
+  c_rects[c_rect_count++] = p_rect;
+
+  /* All done. */
+  return;
+}
+
+
+/* End of file DirtyRegion.cpp */
@@ -0,0 +1,63 @@
+/*
+ * DirtyRegion.hpp - part of Blitroids, a 32Blit game.
+ *
+ * A DirtyRegion keeps track of the parts of the screen that have changed
+ * since the last frame, so that a state can redraw just those rather than
+ * the whole screen. Changes are tracked as individual pixels (for things
+ * like stars) and as rectangles (for things like text); if too much has
+ * changed to track, or something has disturbed the screen behind our back,
+ * the whole region is simply marked invalid and a full redraw is needed.
+ *
+ * Copyright (C) 2021 Pete Favelle <pete@fsquared.co.uk>
+ *
+ * This file is released under the MIT License; see LICENSE for more details.
+ */
+
+#ifndef   _DIRTYREGION_HPP_
+#define   _DIRTYREGION_HPP_
+
+#include "32blit.hpp"
+
+
+/* Constants & Macros. */
+
+#define DIRTY_MAX_RECTS   8
+
+
+/* Classes. */
+
+class DirtyRegion
+{
+private:
+  uint32_t         *c_pixels = nullptr;
+  uint32_t          c_pixel_count = 0;
+  uint32_t          c_pixel_capacity = 0;
+  blit::Rect        c_rects[DIRTY_MAX_RECTS];
+  uint8_t           c_rect_count = 0;
+  bool              c_invalid = true;
+
+public:
+                    DirtyRegion( void ) {};
+                   ~DirtyRegion();
+
+  void              set_capacity( uint32_t );
+  void              reset( void );
+  void              invalidate( void ) { c_invalid = true; };
+  bool              is_invalid( void ) { return c_invalid; };
+
+  void              add_pixel( int32_t, int32_t );
+  void              add_rect( blit::Rect );
+
+  uint32_t          get_pixel_count( void ) { return c_pixel_count; };
+  blit::Point       get_pixel( uint32_t p_index )
+                    {
+                      return blit::Point( c_pixels[p_index] & 0xffff, c_pixels[p_index] >> 16 );
+                    };
+  uint8_t           get_rect_count( void ) { return c_rect_count; };
+  blit::Rect        get_rect( uint8_t p_index ) { return c_rects[p_index]; };
+};
+
+
+#endif /* _DIRTYREGION_HPP_ */
+
+/* End of file DirtyRegion.hpp */
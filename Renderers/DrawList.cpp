@@ -0,0 +1,462 @@
+/*
+ * DrawList.cpp - part of Blitroids, a 32Blit game.
+ *
+ * A DrawList records a frame's drawing as a list of commands, rather than
+ * drawing it straight away; clears, layer copies, circles, pixels, batches
+ * of points, sprite blits and text. Once the frame is recorded, the whole
+ * list is replayed onto a surface, within whatever clip that surface has.
+ *
+ * Replaying the list is the only thing that touches the framebuffer, so on
+ * desktop builds it can be split into horizontal bands, each replayed by a
+ * worker from the job system onto its own copy of the surface, clipped to
+ * just those rows. No two bands share a pixel, so there's no locking; and
+ * every command draws exactly the same pixels whichever band it lands in,
+ * so the result matches a single serial replay to the byte.
+ *
+ * Copyright (C) 2021 Pete Favelle <pete@fsquared.co.uk>
+ *
+ * This file is released under the MIT License; see LICENSE for more details.
+ */
+
+/* Local headers. */
+
+#include "32blit.hpp"
+#include "blitarena.hpp"
+#include "blitjobs.hpp"
+#include "AssetManager.hpp"
+#include "BatchRenderer.hpp"
+#include "DrawList.hpp"
+
+
+/* Structs. */
+
+typedef struct
+{
+  DrawList         *list;
+  blit::Surface    *target;
+} drawlist_band_t;
+
+
+/* Module variables. */
+
+/* How many bands to render in; zero means one for each worker. */
+static uint8_t  m_bands = 0;
+
+
+/* Functions. */
+
+/*
+ * drawlist_band - a job from the job system; replays the list onto its own
+ *                 copy of the target, clipped to a band of rows.
+ *
+ * void *   - the band context.
+ * uint32_t - the band number.
+ * uint32_t - the first row, counted down from the top of the target clip.
+ * uint32_t - the row after the last.
+ */
+
+static void drawlist_band( void *p_context, uint32_t p_band, uint32_t p_first, uint32_t p_last )
+{
+  drawlist_band_t  *l_context = (drawlist_band_t *)p_context;
+  blit::Surface     l_band = *l_context->target;
+
+  /* The copy shares the framebuffer, but has a clip (and pen) of its own. */
+  l_band.clip.y += p_first;
+  l_band.clip.h = p_last - p_first;
+  l_context->list->replay( l_band );
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * ~DrawList - destructor, cleans up anything we allocated.
+ */
+
+DrawList::~DrawList()
+{
+  /* Throw away the command list. */
+  blitarena_free( c_commands );
+  c_commands = nullptr;
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * release - empties the list, and hands its commands back to the arena; it
+ *           grows again as it's next used.
+ */
+
+void DrawList::release( void )
+{
+  blitarena_free( c_commands );
+  c_commands = nullptr;
+  c_count = c_capacity = 0;
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * add - finds room for another command at the end of the list, growing it
+ *       if need be. If the arena can't spare any more, the command is lost
+ *       and the frame goes without it; nothing else is upset.
+ *
+ * draw_op_t - the command being added.
+ *
+ * Returns draw_command_t *, the new command, or nullptr if there's no room.
+ */
+
+draw_command_t *DrawList::add( draw_op_t p_op )
+{
+  draw_command_t *l_commands;
+
+  /* Make more room, if we're full. */
+  if ( c_count >= c_capacity )
+  {
+    l_commands = (draw_command_t *)blitarena_realloc( c_commands, ( c_capacity + DRAWLIST_GROW ) * sizeof( draw_command_t ) );
+    if ( nullptr == l_commands )
+    {
+      return nullptr;
+    }
+    c_commands = l_commands;
+    c_capacity += DRAWLIST_GROW;
+  }
+
+  /* Only the op is set; each command fills in whatever else it uses. */
+  c_commands[c_count].op = p_op;
+  return &c_commands[c_count++];
+}
+
+
+/*
+ * clear - fills the clip with a pen.
+ *
+ * blit::Pen - the pen to fill with.
+ */
+
+void DrawList::clear( blit::Pen p_pen )
+{
+  draw_command_t *l_command = add( DRAW_CLEAR );
+
+  if ( nullptr != l_command )
+  {
+    l_command->pen = p_pen;
+  }
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * copy - fills the clip from a pre-composed, screen-shaped layer.
+ *
+ * const blit::Surface * - the layer to copy from.
+ */
+
+void DrawList::copy( const blit::Surface *p_layer )
+{
+  draw_command_t *l_command = add( DRAW_COPY );
+
+  if ( nullptr != l_command )
+  {
+    l_command->image.surface = p_layer;
+  }
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * circle - draws a filled circle.
+ *
+ * blit::Point - the centre of the circle.
+ * int32_t     - the radius.
+ * blit::Pen   - the pen to draw with.
+ */
+
+void DrawList::circle( blit::Point p_centre, int32_t p_radius, blit::Pen p_pen )
+{
+  draw_command_t *l_command = add( DRAW_CIRCLE );
+
+  if ( nullptr != l_command )
+  {
+    l_command->point = p_centre;
+    l_command->radius = p_radius;
+    l_command->pen = p_pen;
+  }
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * pixel - draws a single pixel.
+ *
+ * blit::Point - the pixel to draw.
+ * blit::Pen   - the pen to draw with.
+ */
+
+void DrawList::pixel( blit::Point p_point, blit::Pen p_pen )
+{
+  draw_command_t *l_command = add( DRAW_PIXEL );
+
+  if ( nullptr != l_command )
+  {
+    l_command->point = p_point;
+    l_command->pen = p_pen;
+  }
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * points - draws a batch of points, through the batch renderer.
+ *
+ * const uint32_t *  - the packed points, from batch_project().
+ * const blit::Pen * - the colour of each point.
+ * uint32_t          - the number of points.
+ */
+
+void DrawList::points( const uint32_t *p_points, const blit::Pen *p_pens, uint32_t p_count )
+{
+  draw_command_t *l_command = add( DRAW_POINTS );
+
+  if ( nullptr != l_command )
+  {
+    l_command->batch.points = p_points;
+    l_command->batch.pens = p_pens;
+    l_command->batch.count = p_count;
+  }
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * blit - copies part of a surface, as the engine's blit() does.
+ *
+ * const blit::Surface * - the surface to copy from.
+ * blit::Rect            - the area of it to copy.
+ * blit::Point           - where to put it.
+ * uint8_t               - any sprite transform to apply.
+ */
+
+void DrawList::blit( const blit::Surface *p_surface, blit::Rect p_rect, blit::Point p_point, uint8_t p_transform )
+{
+  draw_command_t *l_command = add( DRAW_BLIT );
+
+  if ( nullptr != l_command )
+  {
+    l_command->image.surface = p_surface;
+    l_command->image.rect = p_rect;
+    l_command->image.transform = p_transform;
+    l_command->point = p_point;
+  }
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * mask - blits the whole of a two colour mask (the asset manager's cached
+ *        text, say), with index 1 coloured in with a pen. The colour is
+ *        kept with the command, rather than in the mask's own palette, so
+ *        the same mask can be drawn in different colours in one frame, and
+ *        the palette is never written to while bands are being drawn.
+ *
+ * const blit::Surface * - the mask.
+ * blit::Point           - where to put it.
+ * blit::Pen             - the pen to colour it in with.
+ */
+
+void DrawList::mask( const blit::Surface *p_mask, blit::Point p_point, blit::Pen p_pen )
+{
+  draw_command_t *l_command = add( DRAW_MASK );
+
+  if ( nullptr != l_command )
+  {
+    l_command->image.surface = p_mask;
+    l_command->point = p_point;
+    l_command->pen = p_pen;
+  }
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * text - draws a string through the engine; for anything that couldn't be
+ *        cached as a mask.
+ *
+ * const char *       - the string, which must outlive the list.
+ * const blit::Font & - the font to draw in.
+ * blit::Point        - the point to draw it at.
+ * blit::Pen          - the colour to draw it in.
+ * blit::TextAlign    - how the text is aligned to the point.
+ */
+
+void DrawList::text( const char *p_text, const blit::Font &p_font, blit::Point p_point,
+                     blit::Pen p_pen, blit::TextAlign p_align )
+{
+  draw_command_t *l_command = add( DRAW_TEXT );
+
+  if ( nullptr != l_command )
+  {
+    l_command->text.string = p_text;
+    l_command->text.font = &p_font;
+    l_command->text.align = p_align;
+    l_command->point = p_point;
+    l_command->pen = p_pen;
+  }
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * replay - draws every command in the list onto a surface, in order, within
+ *          its current clip. The surface's pen is left as the last command
+ *          set it.
+ *
+ * blit::Surface & - the surface to draw on.
+ */
+
+void DrawList::replay( blit::Surface &p_surface )
+{
+  uint32_t        l_index;
+  draw_command_t *l_command;
+
+  for ( l_index = 0; l_index < c_count; l_index++ )
+  {
+    l_command = &c_commands[l_index];
+    switch( l_command->op )
+    {
+      case DRAW_CLEAR:
+        p_surface.pen = l_command->pen;
+        p_surface.clear();
+        break;
+
+      case DRAW_COPY:
+        AssetManager::copy_surface( l_command->image.surface, p_surface.clip, p_surface );
+        break;
+
+      case DRAW_CIRCLE:
+        p_surface.pen = l_command->pen;
+        p_surface.circle( l_command->point, l_command->radius );
+        break;
+
+      case DRAW_PIXEL:
+        p_surface.pen = l_command->pen;
+        p_surface.pixel( l_command->point );
+        break;
+
+      case DRAW_POINTS:
+        batch_points( p_surface, l_command->batch.points, l_command->batch.pens, l_command->batch.count );
+        break;
+
+      case DRAW_BLIT:
+        p_surface.blit( (blit::Surface *)l_command->image.surface, l_command->image.rect, l_command->point, l_command->image.transform );
+        break;
+
+      case DRAW_MASK:
+      {
+        /* A copy of the mask, so that it can be given a palette of our own. */
+        blit::Surface l_mask( *l_command->image.surface );
+        blit::Pen     l_palette[2] = { l_mask.palette[0], l_command->pen };
+        l_mask.palette = l_palette;
+        p_surface.blit( &l_mask, blit::Rect( blit::Point( 0, 0 ), l_mask.bounds ), l_command->point );
+        break;
+      }
+
+      case DRAW_TEXT:
+        p_surface.pen = l_command->pen;
+        p_surface.text( l_command->text.string, *l_command->text.font, l_command->point, true, l_command->text.align, p_surface.clip );
+        break;
+    }
+  }
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * render - replays the list onto a surface, split into horizontal bands of
+ *          its clip that are each replayed by the job system. With just the
+ *          one band (or too few rows to be worth splitting), the list is
+ *          simply replayed here.
+ *
+ * blit::Surface & - the surface to draw on.
+ */
+
+void DrawList::render( blit::Surface &p_surface )
+{
+  drawlist_band_t l_context = { this, &p_surface };
+  uint32_t        l_bands = get_bands();
+  uint32_t        l_rows;
+
+  /* Work out how tall each band is; short ones aren't worth the bother. */
+  l_rows = ( p_surface.clip.h + l_bands - 1 ) / l_bands;
+  if ( l_rows < DRAWLIST_MIN_BAND )
+  {
+    l_rows = DRAWLIST_MIN_BAND;
+  }
+
+  /* One band is just a straight replay. */
+  if ( ( l_bands <= 1 ) || ( (uint32_t)p_surface.clip.h <= l_rows ) )
+  {
+    replay( p_surface );
+    return;
+  }
+
+  /* Otherwise, let the workers have a band each. */
+  blitjobs_run( p_surface.clip.h, l_rows, drawlist_band, &l_context );
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * set_bands - sets how many bands lists are rendered in.
+ *
+ * uint8_t - the number of bands; 1 renders serially, and zero has one band
+ *           for each worker in the job system.
+ */
+
+void DrawList::set_bands( uint8_t p_bands )
+{
+  m_bands = p_bands;
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * get_bands - how many bands lists are rendered in, right now.
+ *
+ * Returns uint8_t, the number of bands.
+ */
+
+uint8_t DrawList::get_bands( void )
+{
+  return ( 0 == m_bands ) ? blitjobs_workers() : m_bands;
+}
+
+
+/* End of file DrawList.cpp */
@@ -0,0 +1,130 @@
+/*
+ * DrawList.hpp - part of Blitroids, a 32Blit game.
+ *
+ * A DrawList records a frame's drawing as a list of commands, rather than
+ * drawing it straight away; clears, layer copies, circles, pixels, batches
+ * of points, sprite blits and text. Once the frame is recorded, the whole
+ * list is replayed onto a surface, within whatever clip that surface has.
+ *
+ * Replaying the list is the only thing that touches the framebuffer, so on
+ * desktop builds it can be split into horizontal bands, each replayed by a
+ * worker from the job system onto its own copy of the surface, clipped to
+ * just those rows. No two bands share a pixel, so there's no locking; and
+ * every command draws exactly the same pixels whichever band it lands in,
+ * so the result matches a single serial replay to the byte. The handheld
+ * only has the one worker, so there it's always a single band.
+ *
+ * The list only holds pointers to surfaces, points and strings, so those
+ * must stay put until the list has been replayed.
+ *
+ * Copyright (C) 2021 Pete Favelle <pete@fsquared.co.uk>
+ *
+ * This file is released under the MIT License; see LICENSE for more details.
+ */
+
+#ifndef   _DRAWLIST_HPP_
+#define   _DRAWLIST_HPP_
+
+#include "32blit.hpp"
+
+
+/* Constants & Macros. */
+
+/* How many commands the list grows by when it fills up. */
+#define DRAWLIST_GROW         64
+
+/* Bands narrower than this cost more to hand out than they save. */
+#define DRAWLIST_MIN_BAND     8
+
+
+/* Enums. */
+
+typedef enum
+{
+  DRAW_CLEAR,
+  DRAW_COPY,
+  DRAW_CIRCLE,
+  DRAW_PIXEL,
+  DRAW_POINTS,
+  DRAW_BLIT,
+  DRAW_MASK,
+  DRAW_TEXT
+} draw_op_t;
+
+
+/* Structs. */
+
+/*
+ * Every command has an op, a pen and a point; the rest depends on the op,
+ * so is shared to keep the list small on the handheld.
+ */
+
+typedef struct
+{
+  draw_op_t                 op;
+  blit::Pen                 pen;
+  blit::Point               point;
+  union
+  {
+    int32_t                 radius;       /* DRAW_CIRCLE                     */
+    struct
+    {
+      const blit::Surface  *surface;      /* DRAW_COPY, DRAW_BLIT, DRAW_MASK */
+      blit::Rect            rect;
+      uint8_t               transform;
+    }                       image;
+    struct
+    {
+      const uint32_t       *points;       /* DRAW_POINTS, packed as          */
+      const blit::Pen      *pens;         /* batch_project() has them.       */
+      uint32_t              count;
+    }                       batch;
+    struct
+    {
+      const char           *string;       /* DRAW_TEXT                       */
+      const blit::Font     *font;
+      blit::TextAlign       align;
+    }                       text;
+  };
+} draw_command_t;
+
+
+/* Classes. */
+
+class DrawList
+{
+private:
+  draw_command_t   *c_commands = nullptr;
+  uint32_t          c_count = 0;
+  uint32_t          c_capacity = 0;
+
+  draw_command_t   *add( draw_op_t );
+
+public:
+                    DrawList( void ) {};
+                   ~DrawList();
+
+  void              reset( void ) { c_count = 0; };
+  void              release( void );
+  uint32_t          get_count( void ) { return c_count; };
+
+  void              clear( blit::Pen );
+  void              copy( const blit::Surface * );
+  void              circle( blit::Point, int32_t, blit::Pen );
+  void              pixel( blit::Point, blit::Pen );
+  void              points( const uint32_t *, const blit::Pen *, uint32_t );
+  void              blit( const blit::Surface *, blit::Rect, blit::Point, uint8_t p_transform = 0 );
+  void              mask( const blit::Surface *, blit::Point, blit::Pen );
+  void              text( const char *, const blit::Font &, blit::Point, blit::Pen, blit::TextAlign );
+
+  void              replay( blit::Surface & );
+  void              render( blit::Surface & );
+
+  static void       set_bands( uint8_t );
+  static uint8_t    get_bands( void );
+};
+
+
+#endif /* _DRAWLIST_HPP_ */
+
+/* End of file DrawList.hpp */
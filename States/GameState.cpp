@@ -0,0 +1,856 @@
+/*
+ * GameState.cpp - part of Blitroids, a 32Blit game.
+ *
+ * The GameState runs the game itself. Everything in play is held in one of
+ * three EntityPools (the ship, the asteroids and the bullets), and each step
+ * is a handful of systems run over those pools in turn; steering, firing,
+ * movement, ageing and then collisions. There are no per-entity objects or
+ * virtual calls, and nothing is allocated once the state is running.
+ *
+ * The field wraps round at the edges, so anything near one is drawn, and
+ * collided, on the far side too.
+ *
+ * Copyright (C) 2021 Pete Favelle <pete@fsquared.co.uk>
+ *
+ * This file is released under the MIT License; see LICENSE for more details.
+ */
+
+/* System headers. */
+
+#include <stdlib.h>
+#include <string.h>
+
+/* Local headers. */
+
+#include "32blit.hpp"
+#include "blitroids.hpp"
+#include "blitarena.hpp"
+#include "blittrig.hpp"
+#include "blitrandom.hpp"
+#include "SpriteIndex.hpp"
+#include "AssetManager.hpp"
+#include "OutputManager.hpp"
+#include "EntityPool.hpp"
+#include "CollisionGrid.hpp"
+#include "blitmask.hpp"
+#include "GameState.hpp"
+
+
+/* Module variables. */
+
+/* The radius, speed and score of each size of asteroid. */
+static const uint8_t  m_asteroid_radius[GAME_ASTEROID_SIZES] = { 16, 8, 4 };
+static const float    m_asteroid_speed[GAME_ASTEROID_SIZES] = { 0.3f, 0.6f, 1.0f };
+static const uint16_t m_asteroid_score[GAME_ASTEROID_SIZES] = { 20, 50, 100 };
+static const uint8_t  m_asteroid_debris[GAME_ASTEROID_SIZES] = { 16, 10, 6 };
+
+/* The colours exhaust and debris fade through, as they burn out. */
+static const blit::Pen m_exhaust_ramp[] =
+{
+  blit::Pen( 255, 255, 200 ), blit::Pen( 255, 200, 60 ),
+  blit::Pen( 220, 80, 20, 160 ), blit::Pen( 120, 20, 10, 0 )
+};
+static const blit::Pen m_debris_ramp[] =
+{
+  blit::Pen( 200, 190, 180 ), blit::Pen( 140, 130, 120 ), blit::Pen( 80, 75, 70, 0 )
+};
+static const blit::Pen m_wreckage_ramp[] =
+{
+  blit::Pen( 255, 255, 255 ), blit::Pen( 255, 220, 120 ),
+  blit::Pen( 200, 100, 40 ), blit::Pen( 100, 30, 10, 0 )
+};
+
+/* The emitters; exhaust trails out behind the ship while it thrusts, and */
+/* the others are bursts, from wherever something has broken up.          */
+static const particle_emitter_t m_exhaust_emitter =
+{
+  blit::Vec2( 0.0f, 0.0f ), 0.0f, 0, 40, 0.5f, 1.0f, 10, 25, 0.95f,
+  m_exhaust_ramp, sizeof( m_exhaust_ramp ) / sizeof( blit::Pen ), 0
+};
+static const particle_emitter_t m_debris_emitter =
+{
+  blit::Vec2( 0.0f, 0.0f ), 0.0f, 0, 360, 0.3f, 1.2f, 20, 50, 0.97f,
+  m_debris_ramp, sizeof( m_debris_ramp ) / sizeof( blit::Pen ), 0
+};
+static const particle_emitter_t m_wreckage_emitter =
+{
+  blit::Vec2( 0.0f, 0.0f ), 0.0f, 0, 360, 0.2f, 2.0f, 30, 80, 0.96f,
+  m_wreckage_ramp, sizeof( m_wreckage_ramp ) / sizeof( blit::Pen ), 0
+};
+
+
+/* Functions. */
+
+/*
+ * GameState - constructor for the state, which creates the entity pools;
+ *             they're sized for the busiest level we expect, up front.
+ *
+ * state_t, the state identifier that we represent.
+ */
+
+GameState::GameState( state_t p_state )
+{
+  /* Save our state identifier. */
+  c_state = p_state;
+
+  /* Create the pools. */
+  c_ship = new EntityPool( 1 );
+  c_asteroids = new EntityPool( GAME_MAX_ASTEROIDS );
+  c_bullets = new EntityPool( GAME_MAX_BULLETS );
+  c_ship_entity = ENTITY_NONE;
+
+  /* The particles only take room in the arena while a game is running, */
+  /* since the splash screen needs it; the emitters are set up now. The  */
+  /* bounds are only a placeholder, until init() knows the field.        */
+  c_particles = new ParticleEngine( 0, blit::Rect( blit::Point( 0, 0 ), blit::screen.bounds ) );
+  c_exhaust = c_debris = c_wreckage = PARTICLE_NO_EMITTER;
+  if ( nullptr != c_particles )
+  {
+    c_exhaust = c_particles->add_emitter( &m_exhaust_emitter );
+    c_debris = c_particles->add_emitter( &m_debris_emitter );
+    c_wreckage = c_particles->add_emitter( &m_wreckage_emitter );
+  }
+
+  /* Without any one of them, there's no game; the arena must be full. */
+  c_usable = ( nullptr != c_ship ) && ( c_ship->get_capacity() > 0 ) &&
+             ( nullptr != c_asteroids ) && ( c_asteroids->get_capacity() > 0 ) &&
+             ( nullptr != c_bullets ) && ( c_bullets->get_capacity() > 0 ) &&
+             ( nullptr != c_particles );
+
+  /* The asteroids are drawn as circles, so that's the shape they collide. */
+  for ( uint8_t l_size = 0; l_size < GAME_ASTEROID_SIZES; l_size++ )
+  {
+    if ( !blitmask_circle( &c_rock_masks[l_size], m_asteroid_radius[l_size] ) )
+    {
+      c_usable = false;
+    }
+  }
+
+  /* And set some sensible defaults. */
+  c_asset_manager = nullptr;
+  c_output_manager = nullptr;
+  c_score = 0;
+  c_level = 0;
+  c_lives = 0;
+  c_respawn = 0;
+  c_safe = 0;
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * ~GameState - destructor, to tidy up after ourselves.
+ */
+
+GameState::~GameState()
+{
+  /* Release the pools. */
+  delete c_ship;
+  delete c_asteroids;
+  delete c_bullets;
+  delete c_particles;
+
+  /* And the masks. */
+  for ( uint8_t l_size = 0; l_size < GAME_ASTEROID_SIZES; l_size++ )
+  {
+    blitmask_free( &c_rock_masks[l_size] );
+  }
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * spawn_asteroid - adds an asteroid, heading off in a random direction.
+ *
+ * float   - the x position.
+ * float   - the y position.
+ * uint8_t - the size (a game_asteroid_t).
+ */
+
+void GameState::spawn_asteroid( float p_x, float p_y, uint8_t p_size )
+{
+  blit::Vec2  l_velocity;
+  entity_t    l_entity;
+  uint16_t    l_index;
+
+  /* Pick a heading, and head off along it. */
+  l_velocity = g_trig_degrees.vector( blitrandom() % 360, m_asteroid_speed[p_size] );
+  l_entity = c_asteroids->create( p_x, p_y, l_velocity.x, l_velocity.y, m_asteroid_radius[p_size], p_size );
+
+  /* If the pool is full, the fragment just never appears. */
+  l_index = c_asteroids->index( l_entity );
+  if ( ENTITY_NO_INDEX != l_index )
+  {
+    c_asteroids->get_spin()[l_index] = (int16_t)( blitrandom() % 5 ) - 2;
+  }
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * split_asteroid - breaks an asteroid into smaller fragments, or just
+ *                  destroys it if it's already as small as they get.
+ *
+ * uint16_t - the index of the asteroid in its pool.
+ */
+
+void GameState::split_asteroid( uint16_t p_index )
+{
+  float     l_x, l_y;
+  uint8_t   l_size, l_fragment;
+
+  /* Remember where it was, before it's swapped away. */
+  l_x = c_asteroids->get_x()[p_index];
+  l_y = c_asteroids->get_y()[p_index];
+  l_size = c_asteroids->get_kind()[p_index];
+  c_asteroids->destroy_index( p_index );
+
+  /* Score it, and leave some dust behind. */
+  c_score += m_asteroid_score[l_size];
+  explode( c_debris, l_x, l_y, m_asteroid_debris[l_size] );
+
+  /* And anything but the smallest leaves fragments behind. */
+  if ( l_size + 1 < GAME_ASTEROID_SIZES )
+  {
+    for ( l_fragment = 0; l_fragment < GAME_ASTEROID_SPLIT; l_fragment++ )
+    {
+      spawn_asteroid( l_x, l_y, l_size + 1 );
+    }
+  }
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * explode - sends out a burst of particles from one of the burst emitters,
+ *           from wherever something has just broken up.
+ *
+ * uint8_t  - the emitter.
+ * float    - the x position.
+ * float    - the y position.
+ * uint16_t - the number of particles.
+ */
+
+void GameState::explode( uint8_t p_emitter, float p_x, float p_y, uint16_t p_count )
+{
+  particle_emitter_t *l_emitter = c_particles->get_emitter( p_emitter );
+
+  if ( nullptr != l_emitter )
+  {
+    l_emitter->origin = blit::Vec2( p_x, p_y );
+    c_particles->burst( p_emitter, p_count );
+  }
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * spawn_ship - puts the ship in the middle of the field, stationary and
+ *              safe from collisions for a little while.
+ */
+
+void GameState::spawn_ship( void )
+{
+  c_ship->clear();
+  c_ship_entity = c_ship->create( c_field.x + c_field.w / 2.0f, c_field.y + c_field.h / 2.0f,
+                                  0.0f, 0.0f, g_sprite_index[SPRITE_SHIP].radius );
+  c_safe = GAME_SHIP_SAFE_STEPS;
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * start_level - clears the field and scatters the level's asteroids around
+ *               the edges of it, well away from the ship.
+ */
+
+void GameState::start_level( void )
+{
+  uint16_t  l_count;
+
+  /* Clear away anything left over. */
+  c_asteroids->clear();
+  c_bullets->clear();
+
+  /* Each level has one more large asteroid than the last. */
+  for ( l_count = 0; l_count < GAME_ASTEROID_START + c_level; l_count++ )
+  {
+    if ( l_count % 2 )
+    {
+      spawn_asteroid( c_field.x, c_field.y + blitrandom() % c_field.h, GAME_ASTEROID_LARGE );
+    }
+    else
+    {
+      spawn_asteroid( c_field.x + blitrandom() % c_field.w, c_field.y, GAME_ASTEROID_LARGE );
+    }
+  }
+
+  /* And give the ship a moment to get its bearings. */
+  c_safe = GAME_SHIP_SAFE_STEPS;
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * steer - the ship's control system; turning, thrust and drag.
+ */
+
+void GameState::steer( void )
+{
+  uint16_t            l_index;
+  blit::Vec2          l_heading;
+  particle_emitter_t *l_exhaust = c_particles->get_emitter( c_exhaust );
+
+  /* No ship, no steering; and no exhaust either. */
+  l_exhaust->rate = 0.0f;
+  l_index = c_ship->index( c_ship_entity );
+  if ( ENTITY_NO_INDEX == l_index )
+  {
+    return;
+  }
+
+  /* The dpad turns the ship. */
+  c_ship->get_spin()[l_index] = 0;
+  if ( blit::buttons & blit::Button::DPAD_LEFT )
+  {
+    c_ship->get_spin()[l_index] = -GAME_SHIP_TURN;
+  }
+  if ( blit::buttons & blit::Button::DPAD_RIGHT )
+  {
+    c_ship->get_spin()[l_index] = GAME_SHIP_TURN;
+  }
+
+  /* Drag always applies, thrust only when asked for. The heading is the */
+  /* opposite of the trig vector, so that zero degrees is straight up.   */
+  c_ship->get_dx()[l_index] *= GAME_SHIP_DRAG;
+  c_ship->get_dy()[l_index] *= GAME_SHIP_DRAG;
+  if ( blit::buttons & blit::Button::DPAD_UP )
+  {
+    l_heading = g_trig_degrees.vector( c_ship->get_angle()[l_index], GAME_SHIP_THRUST );
+    c_ship->get_dx()[l_index] -= l_heading.x;
+    c_ship->get_dy()[l_index] -= l_heading.y;
+
+    /* The exhaust streams out of the tail, the way the trig vector points. */
+    l_heading = g_trig_degrees.vector( c_ship->get_angle()[l_index], c_ship->get_radius()[l_index] );
+    l_exhaust->origin = blit::Vec2( c_ship->get_x()[l_index] + l_heading.x, c_ship->get_y()[l_index] + l_heading.y );
+    l_exhaust->heading = c_ship->get_angle()[l_index];
+    l_exhaust->rate = GAME_EXHAUST_RATE;
+  }
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * fire - launches a bullet from the nose of the ship, if asked to.
+ */
+
+void GameState::fire( void )
+{
+  uint16_t    l_index;
+  blit::Vec2  l_heading;
+  entity_t    l_bullet;
+
+  /* Only on a fresh press, and only if there's a ship to fire from. */
+  l_index = c_ship->index( c_ship_entity );
+  if ( ( ENTITY_NO_INDEX == l_index ) || !( blitroids_pressed() & blit::Button::A ) )
+  {
+    return;
+  }
+
+  /* Bullets inherit the ship's velocity, and fly for a fixed time. */
+  l_heading = g_trig_degrees.vector( c_ship->get_angle()[l_index], 1.0f );
+  l_bullet = c_bullets->create(
+    c_ship->get_x()[l_index] - l_heading.x * g_sprite_index[SPRITE_SHIP].radius,
+    c_ship->get_y()[l_index] - l_heading.y * g_sprite_index[SPRITE_SHIP].radius,
+    c_ship->get_dx()[l_index] - l_heading.x * GAME_BULLET_SPEED,
+    c_ship->get_dy()[l_index] - l_heading.y * GAME_BULLET_SPEED,
+    1
+  );
+
+  l_index = c_bullets->index( l_bullet );
+  if ( ENTITY_NO_INDEX != l_index )
+  {
+    c_bullets->get_life()[l_index] = GAME_BULLET_STEPS;
+  }
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * collide - the collision system; bullets against asteroids, and then the
+ *           ship against asteroids. Everything is a circle; the asteroids
+ *           are filed in the grid, and each bullet (and the ship) is only
+ *           tested against those in the cells around it. Hits are marked
+ *           first and the asteroids broken up afterwards, because breaking
+ *           them shuffles the pool and the grid would no longer match it.
+ */
+
+void GameState::collide( void )
+{
+  uint16_t    l_bullet, l_asteroid, l_ship, l_found, l_index;
+  float      *l_ax = c_asteroids->get_x(), *l_ay = c_asteroids->get_y();
+  float      *l_bx = c_bullets->get_x(), *l_by = c_bullets->get_y();
+  uint8_t    *l_ar = c_asteroids->get_radius();
+
+  /* File the asteroids where they are now. */
+  c_grid.build( l_ax, l_ay, l_ar, c_asteroids->get_count() );
+  memset( c_hit, 0, c_asteroids->get_count() );
+
+  /* Bullets first; a bullet stops at the first asteroid it hits, and */
+  /* is done with straight away, so run backwards over them.          */
+  for ( l_bullet = c_bullets->get_count(); l_bullet-- > 0; )
+  {
+    l_found = c_grid.query( l_bx[l_bullet], l_by[l_bullet], 0.0f, c_candidates, GAME_MAX_ASTEROIDS );
+    for ( l_index = 0; l_index < l_found; l_index++ )
+    {
+      l_asteroid = c_candidates[l_index];
+      if ( !c_hit[l_asteroid] &&
+           c_grid.overlap( l_bx[l_bullet], l_by[l_bullet], 0.0f, l_ax[l_asteroid], l_ay[l_asteroid], l_ar[l_asteroid] ) )
+      {
+        c_hit[l_asteroid] = 1;
+        c_bullets->destroy_index( l_bullet );
+        break;
+      }
+    }
+  }
+
+  /* Then the ship, unless it's still safe from harm; the circles only */
+  /* say it's close, its mask says whether it's actually been hit.     */
+  l_ship = c_ship->index( c_ship_entity );
+  if ( ( ENTITY_NO_INDEX != l_ship ) && ( 0 == c_safe ) )
+  {
+    l_found = c_grid.query( c_ship->get_x()[l_ship], c_ship->get_y()[l_ship], c_ship->get_radius()[l_ship],
+                            c_candidates, GAME_MAX_ASTEROIDS );
+    for ( l_index = 0; l_index < l_found; l_index++ )
+    {
+      l_asteroid = c_candidates[l_index];
+      if ( c_grid.overlap( c_ship->get_x()[l_ship], c_ship->get_y()[l_ship], c_ship->get_radius()[l_ship],
+                           l_ax[l_asteroid], l_ay[l_asteroid], l_ar[l_asteroid] ) &&
+           ship_touches( l_ship, l_asteroid ) )
+      {
+        /* The asteroid breaks up, and so does the ship. */
+        c_hit[l_asteroid] = 1;
+        explode( c_wreckage, c_ship->get_x()[l_ship], c_ship->get_y()[l_ship], GAME_WRECK_PARTICLES );
+        c_ship->destroy( c_ship_entity );
+        c_ship_entity = ENTITY_NONE;
+        c_lives--;
+        c_respawn = GAME_RESPAWN_STEPS;
+        break;
+      }
+    }
+  }
+
+  /* Now break up everything that was hit; backwards, so that the swaps */
+  /* only ever bring down asteroids we've already dealt with.           */
+  for ( l_asteroid = c_asteroids->get_count(); l_asteroid-- > 0; )
+  {
+    if ( c_hit[l_asteroid] )
+    {
+      split_asteroid( l_asteroid );
+    }
+  }
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * ship_touches - the exact test between the ship and an asteroid, once the
+ *                circles say they're close; the ship's mask, for the pose
+ *                it's drawn in, is ANDed against the asteroid's. They're
+ *                lined up the way they're drawn, the short way round.
+ *
+ * uint16_t - the index of the ship.
+ * uint16_t - the index of the asteroid.
+ *
+ * Returns bool, true if they touch.
+ */
+
+bool GameState::ship_touches( uint16_t p_ship, uint16_t p_asteroid )
+{
+  asset_pose_t  l_pose;
+  uint8_t       l_radius = c_asteroids->get_radius()[p_asteroid];
+  int32_t       l_dx, l_dy;
+
+  /* Without a mask, the circles will have to do. */
+  if ( !c_asset_manager->get_pose( SPRITE_SHIP, c_ship->get_angle()[p_ship], &l_pose ) || ( nullptr == l_pose.mask ) )
+  {
+    return true;
+  }
+
+  /* Where the asteroid is, relative to the ship, in whole pixels. */
+  l_dx = (int32_t)c_asteroids->get_x()[p_asteroid] - (int32_t)c_ship->get_x()[p_ship];
+  l_dy = (int32_t)c_asteroids->get_y()[p_asteroid] - (int32_t)c_ship->get_y()[p_ship];
+  if ( l_dx > c_field.w / 2 )
+  {
+    l_dx -= c_field.w;
+  }
+  else if ( l_dx < -c_field.w / 2 )
+  {
+    l_dx += c_field.w;
+  }
+  if ( l_dy > c_field.h / 2 )
+  {
+    l_dy -= c_field.h;
+  }
+  else if ( l_dy < -c_field.h / 2 )
+  {
+    l_dy += c_field.h;
+  }
+
+  /* And so where the corner of its mask is, against the ship's. */
+  return blitmask_overlap( l_pose.mask, &c_rock_masks[c_asteroids->get_kind()[p_asteroid]],
+                           l_dx + l_pose.pivot.x - l_radius, l_dy + l_pose.pivot.y - l_radius );
+}
+
+
+/*
+ * update - called every tick (10ms) to update our internal state.
+ *
+ * uint32_t - the time in milliseconds since the epoch.
+ *
+ * Returns state_t, the game state we should move to, defaulting to ourselves.
+ */
+
+state_t GameState::update( uint32_t p_time )
+{
+  /* The ship's controls. */
+  steer();
+  fire();
+
+  /* Then everything moves, and bullets run out of steam. */
+  c_ship->move( c_field );
+  c_asteroids->move( c_field );
+  c_bullets->move( c_field );
+  c_bullets->age();
+
+  /* And whatever has run into anything else, breaks. */
+  collide();
+
+  /* The particles all move together, whoever sent them out. */
+  c_particles->update();
+
+  /* Cleared the field? On to the next level. */
+  if ( 0 == c_asteroids->get_count() )
+  {
+    c_level++;
+    start_level();
+  }
+
+  /* Count down the ship's grace period, and any wait to respawn. */
+  if ( c_safe > 0 )
+  {
+    c_safe--;
+  }
+  if ( ( c_respawn > 0 ) && ( --c_respawn == 0 ) )
+  {
+    if ( c_lives > 0 )
+    {
+      spawn_ship();
+    }
+  }
+
+  /* Out of ships, and done waiting? Then the game is over. */
+  if ( ( 0 == c_lives ) && ( 0 == c_respawn ) )
+  {
+    return STATE_SPLASH;
+  }
+
+  /* All done, keep with what we're doing. */
+  return c_state;
+}
+
+
+/*
+ * wrap_copies - works out everywhere something should be drawn; anything
+ *               hanging over an edge of the field shows on the far side as
+ *               well, and in a corner, on all four.
+ *
+ * blit::Point   - where the thing is.
+ * int32_t       - how far it reaches from there.
+ * blit::Point * - where to put the (up to four) places to draw it.
+ *
+ * Returns uint8_t, how many places it needs drawing.
+ */
+
+uint8_t GameState::wrap_copies( blit::Point p_point, int32_t p_reach, blit::Point *p_copies )
+{
+  int32_t   l_dx = 0, l_dy = 0;
+
+  /* Which way, if any, is it hanging over? */
+  if ( p_point.x - p_reach < c_field.x )
+  {
+    l_dx = c_field.w;
+  }
+  else if ( p_point.x + p_reach >= c_field.x + c_field.w )
+  {
+    l_dx = -c_field.w;
+  }
+  if ( p_point.y - p_reach < c_field.y )
+  {
+    l_dy = c_field.h;
+  }
+  else if ( p_point.y + p_reach >= c_field.y + c_field.h )
+  {
+    l_dy = -c_field.h;
+  }
+
+  /* And so, how many copies. */
+  p_copies[0] = p_point;
+  if ( 0 == l_dx && 0 == l_dy )
+  {
+    return 1;
+  }
+  if ( 0 == l_dy )
+  {
+    p_copies[1] = blit::Point( p_point.x + l_dx, p_point.y );
+    return 2;
+  }
+  if ( 0 == l_dx )
+  {
+    p_copies[1] = blit::Point( p_point.x, p_point.y + l_dy );
+    return 2;
+  }
+  p_copies[1] = blit::Point( p_point.x + l_dx, p_point.y );
+  p_copies[2] = blit::Point( p_point.x, p_point.y + l_dy );
+  p_copies[3] = blit::Point( p_point.x + l_dx, p_point.y + l_dy );
+  return 4;
+}
+
+
+/*
+ * draw_ship - adds the ship to the draw list, if there is one; it blinks
+ *             while it's safe.
+ *
+ * float - how far (0.0 - 1.0) we are between the last step and the next.
+ */
+
+void GameState::draw_ship( float p_alpha )
+{
+  uint16_t      l_index;
+  uint8_t       l_copy, l_count;
+  blit::Point   l_point, l_copies[4];
+  asset_pose_t  l_pose;
+
+  /* Nothing to draw? */
+  l_index = c_ship->index( c_ship_entity );
+  if ( ( ENTITY_NO_INDEX == l_index ) || ( ( c_safe / 8 ) % 2 ) )
+  {
+    return;
+  }
+
+  /* Work out where it is, between steps. */
+  l_point.x = c_ship->get_x()[l_index] - c_ship->get_dx()[l_index] * ( 1.0f - p_alpha );
+  l_point.y = c_ship->get_y()[l_index] - c_ship->get_dy()[l_index] * ( 1.0f - p_alpha );
+
+  /* The asset manager knows which rotation is nearest the heading; it can */
+  /* reach as far as the pose is big, so use that to decide on wrapping.   */
+  if ( !c_asset_manager->get_pose( SPRITE_SHIP, c_ship->get_angle()[l_index], &l_pose ) )
+  {
+    return;
+  }
+  l_count = wrap_copies( l_point, l_pose.rect.w > l_pose.rect.h ? l_pose.rect.w : l_pose.rect.h, l_copies );
+  for ( l_copy = 0; l_copy < l_count; l_copy++ )
+  {
+    c_draw_list.blit( l_pose.surface, l_pose.rect, l_copies[l_copy] - l_pose.pivot, l_pose.transform );
+  }
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * render - called every frame (20ms) to draw our internal state to the screen!
+ *
+ * uint32_t - the time in milliseconds since the epoch.
+ */
+
+void GameState::render( uint32_t p_time )
+{
+  /* Without any interpolation, this is just the latest state. */
+  render_interpolated( p_time, 1.0f );
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * render_interpolated - draws the state as it would be part way between the
+ *                       last simulation step and the next; everything moves
+ *                       in straight lines, so it's drawn back along its
+ *                       velocity by however much of the step is left. The
+ *                       frame is recorded into a draw list, and then drawn
+ *                       from that in bands, on desktop builds.
+ *
+ * uint32_t - the time in milliseconds since the epoch.
+ * float    - how far (0.0 - 1.0) we are between the last step and the next.
+ */
+
+void GameState::render_interpolated( uint32_t p_time, float p_alpha )
+{
+  uint16_t    l_index;
+  uint8_t     l_copy, l_count;
+  blit::Point l_copies[4];
+  float       l_back = 1.0f - p_alpha;
+  float      *l_x, *l_y, *l_dx, *l_dy;
+  uint8_t    *l_radius;
+
+  /* Clear the field. */
+  c_draw_list.reset();
+  c_draw_list.clear( GAME_BACKDROP );
+
+  /* The asteroids, just as rocky circles for now. */
+  l_x = c_asteroids->get_x();
+  l_y = c_asteroids->get_y();
+  l_dx = c_asteroids->get_dx();
+  l_dy = c_asteroids->get_dy();
+  l_radius = c_asteroids->get_radius();
+  for ( l_index = 0; l_index < c_asteroids->get_count(); l_index++ )
+  {
+    l_count = wrap_copies(
+      blit::Point( l_x[l_index] - l_dx[l_index] * l_back, l_y[l_index] - l_dy[l_index] * l_back ),
+      l_radius[l_index], l_copies
+    );
+    for ( l_copy = 0; l_copy < l_count; l_copy++ )
+    {
+      c_draw_list.circle( l_copies[l_copy], l_radius[l_index], blit::Pen( 140, 130, 120 ) );
+    }
+  }
+
+  /* The bullets are single pixels. */
+  l_x = c_bullets->get_x();
+  l_y = c_bullets->get_y();
+  l_dx = c_bullets->get_dx();
+  l_dy = c_bullets->get_dy();
+  for ( l_index = 0; l_index < c_bullets->get_count(); l_index++ )
+  {
+    c_draw_list.pixel( blit::Point( l_x[l_index] - l_dx[l_index] * l_back, l_y[l_index] - l_dy[l_index] * l_back ),
+                       blit::Pen( 255, 255, 200 ) );
+  }
+
+  /* The exhaust and debris, in one batch. */
+  c_particles->locate( p_alpha );
+  c_particles->draw( &c_draw_list );
+
+  /* The ship. */
+  draw_ship( p_alpha );
+
+  /* And the score and remaining ships over the top. */
+  c_asset_manager->render_number( &c_draw_list, c_score, c_asset_manager->font_null, blit::Point( 4, 4 ),
+                                  blit::Pen( 255, 255, 255 ) );
+  c_asset_manager->render_number( &c_draw_list, c_lives, c_asset_manager->font_null,
+                                  blit::Point( blit::screen.bounds.w - 4, 4 ),
+                                  blit::Pen( 255, 255, 255 ), blit::TextAlign::top_right );
+
+  /* Now it's all recorded, draw it. */
+  c_draw_list.render( blit::screen );
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * init - called any time the state is activated, or woken up; this starts
+ *        a new game.
+ *
+ * StateInterface *, the game state that we are coming from
+ * AssetManager *  , the asset manager object
+ * OutputManager * , the output manager
+ */
+
+void GameState::init( StateInterface *p_previous_state,
+                      AssetManager *p_asset_manager,
+                      OutputManager *p_output_manager )
+{
+  /* Keep hold of the pointers to our managers. */
+  c_asset_manager = p_asset_manager;
+  c_output_manager = p_output_manager;
+
+  /* The playing field is the whole screen, as it is now. */
+  c_field = blit::Rect( blit::Point( 0, 0 ), blit::screen.bounds );
+  c_grid.resize( c_field );
+
+  /* Give the particles their pool for the game, culled at its edges. */
+  c_particles->set_bounds( c_field );
+  c_particles->resize( GAME_MAX_PARTICLES );
+
+  /* Start a fresh game. */
+  c_score = 0;
+  c_level = 0;
+  c_lives = GAME_LIVES;
+  c_respawn = 0;
+  start_level();
+  spawn_ship();
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * fini - called any time the state is being de-activated; everything in
+ *        play is cleared away.
+ *
+ * StateInterface *, the game state we are moving to
+ */
+
+void GameState::fini( StateInterface *p_next_state )
+{
+  /* Empty the pools; their storage stays, ready for the next game. */
+  c_ship->clear();
+  c_asteroids->clear();
+  c_bullets->clear();
+  c_ship_entity = ENTITY_NONE;
+
+  /* The particle pool goes back to the arena, for the splash screen. */
+  c_particles->clear();
+  c_particles->resize( 0 );
+
+  /* As does the draw list. */
+  c_draw_list.release();
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * prepare - warms up for init(); the spritesheet is the only thing we need
+ *           that isn't already waiting, and it can't be decoded in pieces.
+ *
+ * AssetManager * - the asset manager object.
+ * uint32_t       - the deadline for this slice, in blit::now_us() terms.
+ *
+ * Returns bool, true once we're ready to be initialised.
+ */
+
+bool GameState::prepare( AssetManager *p_asset_manager, uint32_t p_deadline )
+{
+  p_asset_manager->preload( ASSET_IMG_SPRITESHEET );
+  return true;
+}
+
+
+/* End of file GameState.cpp */
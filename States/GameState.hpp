@@ -0,0 +1,122 @@
+/*
+ * GameState.hpp - part of Blitroids, a 32Blit game.
+ *
+ * The GameState is the game itself; the ship, the asteroids and the bullets
+ * flying between them. Each kind of thing lives in its own EntityPool, and
+ * the game is stepped by running a system at a time over each pool. The
+ * asteroids are filed in a CollisionGrid each step, so that bullets and the
+ * ship only need testing against the asteroids near them; the ship is then
+ * checked pixel by pixel, through its collision mask. Exhaust and debris
+ * are emitters sharing a single ParticleEngine.
+ *
+ * Copyright (C) 2021 Pete Favelle <pete@fsquared.co.uk>
+ *
+ * This file is released under the MIT License; see LICENSE for more details.
+ */
+
+#ifndef   _GAMESTATE_HPP_
+#define   _GAMESTATE_HPP_
+
+#include "32blit.hpp"
+#include "StateInterface.hpp"
+#include "EntityPool.hpp"
+#include "CollisionGrid.hpp"
+#include "ParticleEngine.hpp"
+#include "DrawList.hpp"
+#include "blitmask.hpp"
+
+
+/* Constants & Macros. */
+
+#define GAME_BACKDROP           blit::Pen( 10, 10, 40 )
+
+#define GAME_MAX_ASTEROIDS      512
+#define GAME_MAX_BULLETS        64
+#define GAME_MAX_PARTICLES      128
+#define GAME_LIVES              3
+
+/* Movement is all in pixels (or degrees) per simulation step. */
+#define GAME_SHIP_TURN          3
+#define GAME_SHIP_THRUST        0.04f
+#define GAME_SHIP_DRAG          0.99f
+#define GAME_SHIP_SAFE_STEPS    200
+#define GAME_BULLET_SPEED       3.0f
+#define GAME_BULLET_STEPS       80
+#define GAME_RESPAWN_STEPS      150
+#define GAME_EXHAUST_RATE       0.5f
+#define GAME_WRECK_PARTICLES    32
+
+/* Asteroids come in three sizes, each splitting into a few of the next. */
+#define GAME_ASTEROID_SIZES     3
+#define GAME_ASTEROID_SPLIT     3
+#define GAME_ASTEROID_START     4
+
+
+/* Enums. */
+
+typedef enum
+{
+  GAME_ASTEROID_LARGE,
+  GAME_ASTEROID_MEDIUM,
+  GAME_ASTEROID_SMALL
+} game_asteroid_t;
+
+
+/* Classes. */
+
+class GameState : public StateInterface
+{
+private:
+  AssetManager         *c_asset_manager;
+  OutputManager        *c_output_manager;
+  EntityPool           *c_ship;
+  EntityPool           *c_asteroids;
+  EntityPool           *c_bullets;
+  entity_t              c_ship_entity;
+  ParticleEngine       *c_particles;
+  uint8_t               c_exhaust;
+  uint8_t               c_debris;
+  uint8_t               c_wreckage;
+  CollisionGrid         c_grid;
+  uint16_t              c_candidates[GAME_MAX_ASTEROIDS];
+  uint8_t               c_hit[GAME_MAX_ASTEROIDS];
+  blit_mask_t           c_rock_masks[GAME_ASTEROID_SIZES];
+  blit::Rect            c_field;
+  DrawList              c_draw_list;
+  uint32_t              c_score;
+  uint16_t              c_level;
+  uint16_t              c_respawn;
+  uint16_t              c_safe;
+  uint8_t               c_lives;
+  bool                  c_usable;
+
+  void                  start_level( void );
+  void                  spawn_ship( void );
+  void                  spawn_asteroid( float, float, uint8_t );
+  void                  split_asteroid( uint16_t );
+  void                  explode( uint8_t, float, float, uint16_t );
+  void                  steer( void );
+  void                  fire( void );
+  void                  collide( void );
+  bool                  ship_touches( uint16_t, uint16_t );
+  void                  draw_ship( float );
+  uint8_t               wrap_copies( blit::Point, int32_t, blit::Point * );
+
+public:
+                        GameState( state_t );
+                       ~GameState();
+
+  state_t             update( uint32_t );
+  void                render( uint32_t );
+  void                render_interpolated( uint32_t, float );
+  void                init( StateInterface *, AssetManager *, OutputManager * );
+  void                fini( StateInterface * );
+  bool                prepare( AssetManager *, uint32_t );
+  bool                usable( void ) { return c_usable; };
+
+};
+
+
+#endif /* _GAMESTATE_HPP_ */
+
+/* End of file GameState.hpp */
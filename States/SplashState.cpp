@@ -4,6 +4,12 @@
  * The SplashState renders the splash screen, when the game is first loaded,
  * and possibly after the game is over.
  *
+ * Most of the splash screen doesn't change from frame to frame, so only the
+ * pixels touched by stars, and the prompt text, are redrawn; the backdrop
+ * and logo are cached as a static layer to restore from (where there's the
+ * memory for one), and the logo is only composited again where a star is
+ * underneath it.
+ *
  * Copyright (C) 2021 Pete Favelle <pete@fsquared.co.uk>
  *
  * This file is released under the MIT License; see LICENSE for more details.
@@ -11,11 +17,14 @@
 
 /* System headers. */
 
+#include <stdlib.h>
+#include <string.h>
 
 /* Local headers. */
 
 #include "32blit.hpp"
 #include "blitroids.hpp"
+#include "blitarena.hpp"
 #include "AssetManager.hpp"
 #include "OutputManager.hpp"
 #include "SplashState.hpp"
@@ -44,6 +53,15 @@ SplashState::SplashState( state_t p_state )
   /* Create the background we'll be using. */
   c_background = new StarburstBackground();
 
+  /* The logo mask is sized once we know the logo, in init(). */
+  c_logo_mask = nullptr;
+
+  /* And the static layer is only registered while we're active. */
+  c_layer = ASSET_NO_LAYER;
+
+  /* Nothing is warmed up until we're about to be used. */
+  c_prepare_stage = SPLASH_PREPARE_ASSETS;
+
   /* All done. */
   return;
 }
@@ -62,6 +80,10 @@ SplashState::~SplashState()
     c_background = nullptr;
   }
 
+  /* And the logo mask. */
+  blitarena_free( c_logo_mask );
+  c_logo_mask = nullptr;
+
   /* All done. */
   return;
 }
@@ -83,6 +105,12 @@ state_t SplashState::update( uint32_t p_time )
   /* Update the font pen from its tween. */
   c_font_pen.r = c_font_pen.g = c_font_tween.value;
 
+  /* The player starts the game when they're ready. */
+  if ( blitroids_pressed() & blit::Button::A )
+  {
+    return STATE_GAME;
+  }
+
   /* All done, keep with what we're doing. */
   return c_state;
 }
@@ -96,28 +124,247 @@ state_t SplashState::update( uint32_t p_time )
 
 void SplashState::render( uint32_t p_time )
 {
-  /* Draw the background. */
-  c_background->render( p_time );
+  /* Without any interpolation, this is just the latest state. */
+  render_interpolated( p_time, 1.0f );
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * layout - works out where the logo and prompt go on the current screen.
+ */
+
+void SplashState::layout( void )
+{
+  const blit_layout_t *l_text;
+  blit::Surface  *l_logo = c_asset_manager->get_image( ASSET_IMG_LOGO );
+
+  /* The logo sits somewhere central. */
+  c_logo_rect = blit::Rect(
+    ( blit::screen.bounds.w - l_logo->bounds.w ) / 2,
+    ( blit::screen.bounds.h - l_logo->bounds.h ) / 2 - 20,
+    l_logo->bounds.w,
+    l_logo->bounds.h
+  );
+
+  /* The prompt is centered near the bottom; allow a pixel of slack all */
+  /* round, in case the alignment rounds differently to us. Its size    */
+  /* comes from the string table, so there's no need to measure it.     */
+  l_text = c_asset_manager->get_layout( STR_BTN_A_TO_START, c_asset_manager->font_null );
+  c_text_rect = blit::Rect(
+    blit::screen.bounds.w / 2 - l_text->width / 2 - 2,
+    blit::screen.bounds.h - 25 - l_text->height / 2 - 2,
+    l_text->width + 4,
+    l_text->height + 4
+  );
+
+  /* Remember the screen mode this was for. */
+  c_screen_size = blit::screen.bounds;
+  c_screen_format = blit::screen.format;
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * build_layer - composes our static layer; the backdrop with the logo
+ *               over it, exactly as the stars would leave it.
+ *
+ * blit::Surface * - the layer surface to draw into.
+ * void *          - the SplashState that registered the layer.
+ */
+
+void SplashState::build_layer( blit::Surface *p_surface, void *p_context )
+{
+  SplashState    *l_state = (SplashState *)p_context;
+  blit::Surface  *l_logo = l_state->c_asset_manager->get_image( ASSET_IMG_LOGO );
+
+  /* Fill in the backdrop. */
+  p_surface->pen = STARBURST_BACKDROP;
+  p_surface->clear();
+
+  /* And plonk the logo on top. */
+  p_surface->blit( 
+    l_logo, 
+    l_logo->clip,
+    l_state->c_logo_rect.tl()
+  );
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * draw_foreground - adds the logo and prompt to the draw list, over whatever
+ *                   background is already in it.
+ */
+
+void SplashState::draw_foreground( void )
+{
+  blit::Surface  *l_logo = c_asset_manager->get_image( ASSET_IMG_LOGO );
 
   /* Plonk the logo somewhere central. */
-  blit::screen.blit( 
-    c_asset_manager->c_img_logo, 
-    c_asset_manager->c_img_logo->clip,
-    blit::Point( 
-      ( blit::screen.bounds.w - c_asset_manager->c_img_logo->bounds.w ) / 2,
-      ( blit::screen.bounds.h - c_asset_manager->c_img_logo->bounds.h ) / 2 - 20
-    )
+  c_draw_list.blit( 
+    l_logo, 
+    l_logo->clip,
+    c_logo_rect.tl()
   );
 
-  /* Prompt the user to press start. */
-  blit::screen.pen = c_font_pen;
-  blit::screen.text(
-    c_asset_manager->get_string( STR_BTN_A_TO_START ),
+  /* Prompt the user to press start; the text is only rasterised once. */
+  c_asset_manager->render_text(
+    &c_draw_list,
+    STR_BTN_A_TO_START,
     c_asset_manager->font_null,
     blit::Point( blit::screen.bounds.w / 2, blit::screen.bounds.h - 25 ),
-    true,
+    c_font_pen,
     blit::TextAlign::center_center
-  );  
+  );
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * restore_logo - puts the logo back over any dirty pixels that fall within
+ *                it; each pixel is only composited once, however many times
+ *                it was touched, using the logo mask to keep track.
+ */
+
+void SplashState::restore_logo( void )
+{
+  uint32_t        l_index, l_bit;
+  blit::Point     l_pixel;
+  blit::Surface  *l_logo = c_asset_manager->get_image( ASSET_IMG_LOGO );
+
+  /* Work through the dirty pixels, looking for those under the logo. */
+  for ( l_index = 0; l_index < c_dirty.get_pixel_count(); l_index++ )
+  {
+    l_pixel = c_dirty.get_pixel( l_index );
+    if ( !c_logo_rect.contains( l_pixel ) )
+    {
+      continue;
+    }
+
+    /* Skip it if we've already done this one. */
+    l_bit = ( l_pixel.y - c_logo_rect.y ) * c_logo_rect.w + ( l_pixel.x - c_logo_rect.x );
+    if ( c_logo_mask[l_bit >> 5] & ( 1u << ( l_bit & 31 ) ) )
+    {
+      continue;
+    }
+    c_logo_mask[l_bit >> 5] |= 1u << ( l_bit & 31 );
+
+    /* And blit that single pixel of the logo. */
+    blit::screen.blit(
+      l_logo,
+      blit::Rect( l_pixel.x - c_logo_rect.x, l_pixel.y - c_logo_rect.y, 1, 1 ),
+      l_pixel
+    );
+  }
+
+  /* Clearing just the words we touched is cheaper than the whole mask. */
+  for ( l_index = 0; l_index < c_dirty.get_pixel_count(); l_index++ )
+  {
+    l_pixel = c_dirty.get_pixel( l_index );
+    if ( c_logo_rect.contains( l_pixel ) )
+    {
+      l_bit = ( l_pixel.y - c_logo_rect.y ) * c_logo_rect.w + ( l_pixel.x - c_logo_rect.x );
+      c_logo_mask[l_bit >> 5] = 0;
+    }
+  }
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * render_interpolated - draws our state part way between simulation steps.
+ *
+ * uint32_t - the time in milliseconds since the epoch.
+ * float    - how far we are between the last step and the next (0.0 - 1.0)
+ */
+
+void SplashState::render_interpolated( uint32_t p_time, float p_alpha )
+{
+  blit::Rect  l_rect;
+  uint8_t     l_index;
+  uint32_t    l_limit;
+
+  /* We track up to two pixels per star; the old and the new locations. */
+  /* With enough stars, per-pixel restores cost more than a full redraw, */
+  /* so there's no point tracking more than a fraction of the screen.    */
+  l_limit = blit::screen.bounds.w * blit::screen.bounds.h / SPLASH_DIRTY_FRACTION;
+  if ( c_background->get_density() * 2u > l_limit )
+  {
+    c_dirty.set_capacity( 0 );
+    c_dirty.invalidate();
+  }
+  else
+  {
+    c_dirty.set_capacity( c_background->get_density() * 2 );
+  }
+
+  /* A change in screen mode means working everything out afresh. */
+  if ( ( blit::screen.bounds.w != c_screen_size.w ) || ( blit::screen.bounds.h != c_screen_size.h ) ||
+       ( blit::screen.format != c_screen_format ) )
+  {
+    layout();
+    c_dirty.invalidate();
+  }
+
+  /* The background restores from our static layer; the asset manager */
+  /* takes care of rebuilding it if the screen mode has changed.      */
+  c_background->set_backdrop( c_asset_manager->get_layer( c_layer ) );
+
+  /* If we can, just redraw the stars that have moved. */
+  if ( !c_dirty.is_invalid() && ( nullptr != c_logo_mask ) )
+  {
+    c_dirty.reset();
+    c_background->render_dirty( p_alpha, &c_dirty );
+  }
+
+  /* If we couldn't (or it proved too much to track), draw everything; */
+  /* the logo's alpha is all or nothing, so blitting it again over the  */
+  /* layer (which already holds it) leaves those pixels unchanged. The  */
+  /* whole frame is recorded, then drawn in bands on desktop builds.    */
+  if ( c_dirty.is_invalid() || ( nullptr == c_logo_mask ) )
+  {
+    c_draw_list.reset();
+    c_background->draw_interpolated( &c_draw_list, p_alpha );
+    draw_foreground();
+    c_draw_list.render( blit::screen );
+    c_dirty.reset();
+    return;
+  }
+
+  /* Put the logo back wherever the stars have disturbed it. */
+  restore_logo();
+
+  /* The prompt changes colour all the time, so always needs redrawing. */
+  c_dirty.add_rect( c_text_rect );
+
+  /* Rectangles are redrawn in full, layer by layer, within a clip; the */
+  /* layers are recorded once, and replayed for each rectangle.         */
+  c_draw_list.reset();
+  c_background->draw_region( &c_draw_list );
+  draw_foreground();
+  for ( l_index = 0; l_index < c_dirty.get_rect_count(); l_index++ )
+  {
+    l_rect = c_dirty.get_rect( l_index ).intersection( blit::Rect( blit::Point( 0, 0 ), blit::screen.bounds ) );
+    if ( l_rect.empty() )
+    {
+      continue;
+    }
+
+    blit::screen.clip = l_rect;
+    c_draw_list.replay( blit::screen );
+  }
+  blit::screen.clip = blit::Rect( blit::Point( 0, 0 ), blit::screen.bounds );
 
   /* All done. */
   return;
@@ -146,6 +393,24 @@ void SplashState::init( StateInterface *p_previous_state,
   /* And initialise the background. */
   c_background->init();
 
+  /* Size the logo mask to match the logo, one bit per pixel. */
+  blitarena_free( c_logo_mask );
+  c_logo_mask = (uint32_t *)blitarena_calloc( 
+    ( c_asset_manager->get_image( ASSET_IMG_LOGO )->bounds.w * 
+      c_asset_manager->get_image( ASSET_IMG_LOGO )->bounds.h + 31 ) / 32,
+    sizeof( uint32_t )
+  );
+
+  /* Work out where everything goes, and make sure we start with a full */
+  /* redraw; the screen holds whatever the last state left on it.       */
+  layout();
+  c_dirty.invalidate();
+
+  /* Register our static layer; it's only built when first used. */
+#if SPLASH_LAYER
+  c_layer = c_asset_manager->register_layer( build_layer, this );
+#endif /* SPLASH_LAYER */
+
   /* All done. */
   return;
 }
@@ -163,11 +428,64 @@ void SplashState::fini( StateInterface *p_next_state )
   c_font_tween.stop();
 
   /* And shut down the background. */
+  c_background->set_backdrop( nullptr );
   c_background->fini();
 
+  /* Release our static layer, we don't want the RAM sitting idle. */
+  c_asset_manager->release_layer( c_layer );
+  c_layer = ASSET_NO_LAYER;
+  c_draw_list.release();
+
+  /* We'll want warming up again, next time. */
+  c_prepare_stage = SPLASH_PREPARE_ASSETS;
+
   /* All done. */
   return;
 }
 
 
+/*
+ * prepare - warms up for init(), a slice at a time; the logo is decoded,
+ *           and then the starfield is filled a chunk at a time until it's
+ *           full or we run out of time.
+ *
+ * AssetManager * - the asset manager object.
+ * uint32_t       - the deadline for this slice, in blit::now_us() terms.
+ *
+ * Returns bool, true once we're ready to be initialised.
+ */
+
+bool SplashState::prepare( AssetManager *p_asset_manager, uint32_t p_deadline )
+{
+  /* The logo can't be decoded in pieces, so it gets a slice of its own. */
+  if ( SPLASH_PREPARE_ASSETS == c_prepare_stage )
+  {
+    p_asset_manager->preload( ASSET_IMG_LOGO );
+    c_background->restart();
+    c_prepare_stage = SPLASH_PREPARE_STARS;
+    return false;
+  }
+
+  /* The starfield carries on from wherever it got to. */
+  if ( ( SPLASH_PREPARE_STARS == c_prepare_stage ) && c_background->prepare( p_deadline ) )
+  {
+    c_prepare_stage = SPLASH_PREPARE_DONE;
+  }
+
+  return SPLASH_PREPARE_DONE == c_prepare_stage;
+}
+
+
+/*
+ * invalidate - something else has drawn on the screen, so our next render
+ *              must redraw everything rather than just what has changed.
+ */
+
+void SplashState::invalidate( void )
+{
+  c_dirty.invalidate();
+  return;
+}
+
+
 /* End of file SplashState.cpp */
@@ -4,6 +4,12 @@
  * The SplashState renders the splash screen, when the game is first loaded,
  * and possibly after the game is over.
  *
+ * Most of the splash screen doesn't change from frame to frame, so only the
+ * pixels touched by stars, and the prompt text, are redrawn; the backdrop
+ * and logo are cached as a static layer to restore from (where there's the
+ * memory for one), and the logo is only composited again where a star is
+ * underneath it.
+ *
  * Copyright (C) 2021 Pete Favelle <pete@fsquared.co.uk>
  *
  * This file is released under the MIT License; see LICENSE for more details.
@@ -15,12 +21,35 @@
 #include "32blit.hpp"
 #include "StateInterface.hpp"
 #include "StarburstBackground.hpp"
+#include "DirtyRegion.hpp"
+#include "DrawList.hpp"
 
 
 /* Constants & Macros. */
 
+/* Dirty rendering only pays while stars touch less than 1/Nth of the screen. */
+#define SPLASH_DIRTY_FRACTION   8
+
+/* The static layer is a whole screen's worth of pixels, 225KB in hires; */
+/* the handheld can't spare that, so there the backdrop is just cleared  */
+/* and the logo restored from the image, as it is for the dirty pixels.  */
+#ifndef   SPLASH_LAYER
+#ifdef    TARGET_32BLIT_HW
+#define SPLASH_LAYER            0
+#else  /* TARGET_32BLIT_HW */
+#define SPLASH_LAYER            1
+#endif /* TARGET_32BLIT_HW */
+#endif /* SPLASH_LAYER */
+
 /* Enums. */
 
+typedef enum
+{
+  SPLASH_PREPARE_ASSETS,
+  SPLASH_PREPARE_STARS,
+  SPLASH_PREPARE_DONE
+} splash_prepare_t;
+
 /* Structs. */
 
 /* Classes. */
@@ -33,6 +62,20 @@ private:
   OutputManager        *c_output_manager;
   blit::Pen             c_font_pen;
   blit::Tween           c_font_tween;
+  DirtyRegion           c_dirty;
+  DrawList              c_draw_list;
+  blit::Size            c_screen_size;
+  blit::PixelFormat     c_screen_format;
+  int8_t                c_layer;
+  blit::Rect            c_logo_rect;
+  blit::Rect            c_text_rect;
+  uint32_t             *c_logo_mask;
+  splash_prepare_t      c_prepare_stage;
+
+  void                  layout( void );
+  void                  draw_foreground( void );
+  void                  restore_logo( void );
+  static void           build_layer( blit::Surface *, void * );
   
 public:
                         SplashState( state_t );
@@ -40,8 +83,12 @@ public:
 
   state_t             update( uint32_t );
   void                render( uint32_t );
+  void                render_interpolated( uint32_t, float );
   void                init( StateInterface *, AssetManager *, OutputManager * );
   void                fini( StateInterface * );
+  void                invalidate( void );
+  bool                prepare( AssetManager *, uint32_t );
+  bool                usable( void ) { return ( nullptr != c_background ) && c_background->usable(); };
 
 };
 
@@ -4,6 +4,24 @@
  * This defines a standard Interface for all State classes; this way they can
  * all be treated the same by the game core.
  *
+ * States that want smooth motion between fixed simulation steps implement
+ * render_interpolated(), which is given how far (0.0 - 1.0) we are from the
+ * last step towards the next; by default it just calls render().
+ *
+ * States that only redraw what has changed need to know when something
+ * else has drawn over the screen; invalidate() tells them to redraw it all.
+ *
+ * prepare() does whatever heavy lifting a state needs before init(), such
+ * as decoding assets or filling a starfield. It's resumable; it is called
+ * repeatedly, in slices, while the outgoing state keeps running, and does
+ * as much as it can before the deadline it's given. The transition only
+ * happens once it returns true, and it should keep doing so until fini().
+ *
+ * usable() says whether a state got everything it needed when it was made;
+ * one that didn't is thrown away, and transitions to it are refused.
+ *
+ * States live in the arena (see blitarena.hpp), not the heap.
+ *
  * Copyright (C) 2021 Pete Favelle <pete@fsquared.co.uk>
  *
  * This file is released under the MIT License; see LICENSE for more details.
@@ -12,6 +30,7 @@
 #ifndef   _STATEINTERFACE_HPP_
 #define   _STATEINTERFACE_HPP_
 
+#include "blitarena.hpp"
 #include "AssetManager.hpp"
 #include "OutputManager.hpp"
 
@@ -38,10 +57,17 @@ protected:
   state_t         c_state;
 
 public:
+  BLITARENA_OBJECT
+
+  virtual        ~StateInterface() {};
   virtual state_t update( uint32_t ) = 0;
   virtual void    render( uint32_t ) = 0;
+  virtual void    render_interpolated( uint32_t p_time, float p_alpha ) { render( p_time ); };
   virtual void    init( StateInterface *, AssetManager *, OutputManager * ) = 0;
   virtual void    fini( StateInterface * ) = 0;
+  virtual void    invalidate( void ) {};
+  virtual bool    prepare( AssetManager *, uint32_t ) { return true; };
+  virtual bool    usable( void ) { return true; };
   state_t         get_state( void ) { return c_state; };
 };
 
@@ -0,0 +1,359 @@
+/*
+ * CollisionGrid.cpp - part of Blitroids, a 32Blit game.
+ *
+ * The CollisionGrid is a uniform grid broadphase over a wrapping playfield;
+ * see CollisionGrid.hpp for the details.
+ *
+ * Copyright (C) 2021 Pete Favelle <pete@fsquared.co.uk>
+ *
+ * This file is released under the MIT License; see LICENSE for more details.
+ */
+
+/* System headers. */
+
+#include <string.h>
+
+/* Local headers. */
+
+#include "32blit.hpp"
+#include "blitarena.hpp"
+#include "CollisionGrid.hpp"
+
+
+/* Functions. */
+
+/*
+ * ~CollisionGrid - destructor, which hands everything back to the arena.
+ */
+
+CollisionGrid::~CollisionGrid()
+{
+  blitarena_free( c_cell_start );
+  blitarena_free( c_entries );
+  blitarena_free( c_stamp );
+  c_cell_start = nullptr;
+  c_entries = nullptr;
+  c_stamp = nullptr;
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * resize - fits the grid to a playfield, typically the screen bounds; this
+ *          needs calling again if the screen mode changes.
+ *
+ * const blit::Rect & - the playfield.
+ */
+
+void CollisionGrid::resize( const blit::Rect &p_field )
+{
+  uint32_t *l_cells;
+
+  /* Work out how many whole cells fit, and stretch them to fill. */
+  c_field = p_field;
+  c_columns = ( p_field.w > GRID_CELL_SIZE ) ? p_field.w / GRID_CELL_SIZE : 1;
+  c_rows = ( p_field.h > GRID_CELL_SIZE ) ? p_field.h / GRID_CELL_SIZE : 1;
+  c_cell_w = (float)p_field.w / c_columns;
+  c_cell_h = (float)p_field.h / c_rows;
+
+  /* And make room for the cell index. */
+  l_cells = (uint32_t *)blitarena_realloc( c_cell_start, ( c_columns * c_rows + 1 ) * sizeof( uint32_t ) );
+  if ( nullptr == l_cells )
+  {
+    blitarena_free( c_cell_start );
+    c_cell_start = nullptr;
+    c_columns = c_rows = 0;
+    return;
+  }
+  c_cell_start = l_cells;
+  memset( c_cell_start, 0, ( c_columns * c_rows + 1 ) * sizeof( uint32_t ) );
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * span - works out which cells a circle's bounding box covers, without
+ *        wrapping; the range may run off either side of the grid, but is
+ *        never more than the whole grid wide or high.
+ *
+ * float     - the x position of the circle.
+ * float     - the y position of the circle.
+ * float     - the radius of the circle.
+ * int32_t * - the first column covered.
+ * int32_t * - the first row covered.
+ * int32_t * - the last column covered.
+ * int32_t * - the last row covered.
+ *
+ * Returns bool, false if there's no grid to cover.
+ */
+
+bool CollisionGrid::span( float p_x, float p_y, float p_radius,
+                          int32_t *p_col0, int32_t *p_row0, int32_t *p_col1, int32_t *p_row1 )
+{
+  /* No grid, no cells. */
+  if ( ( 0 == c_columns ) || ( nullptr == c_cell_start ) )
+  {
+    return false;
+  }
+
+  /* Casts truncate towards zero; shifting up by a whole grid first makes */
+  /* that a floor, for anything less than a grid off the top or left.     */
+  *p_col0 = (int32_t)( ( p_x - p_radius - c_field.x ) / c_cell_w + c_columns ) - c_columns;
+  *p_col1 = (int32_t)( ( p_x + p_radius - c_field.x ) / c_cell_w + c_columns ) - c_columns;
+  *p_row0 = (int32_t)( ( p_y - p_radius - c_field.y ) / c_cell_h + c_rows ) - c_rows;
+  *p_row1 = (int32_t)( ( p_y + p_radius - c_field.y ) / c_cell_h + c_rows ) - c_rows;
+
+  /* Anything as big as the field covers every cell, just once. */
+  if ( *p_col1 - *p_col0 >= c_columns )
+  {
+    *p_col0 = 0;
+    *p_col1 = c_columns - 1;
+  }
+  if ( *p_row1 - *p_row0 >= c_rows )
+  {
+    *p_row0 = 0;
+    *p_row1 = c_rows - 1;
+  }
+
+  return true;
+}
+
+
+/*
+ * wrap_column / wrap_row - brings a cell coordinate from span() back onto
+ *                          the grid, round the wrap.
+ */
+
+uint16_t CollisionGrid::wrap_column( int32_t p_column )
+{
+  return ( p_column < 0 ) ? p_column + c_columns : ( ( p_column >= c_columns ) ? p_column - c_columns : p_column );
+}
+
+uint16_t CollisionGrid::wrap_row( int32_t p_row )
+{
+  return ( p_row < 0 ) ? p_row + c_rows : ( ( p_row >= c_rows ) ? p_row - c_rows : p_row );
+}
+
+
+/*
+ * reserve - makes sure there's room for the objects and cell entries of a
+ *           build; storage only ever grows, so this settles quickly.
+ *
+ * uint16_t - the number of objects.
+ * uint32_t - the number of cell entries they need between them.
+ *
+ * Returns bool, true if there's enough room.
+ */
+
+bool CollisionGrid::reserve( uint16_t p_objects, uint32_t p_entries )
+{
+  uint16_t *l_block;
+
+  /* Cell entries. */
+  if ( p_entries > c_entry_capacity )
+  {
+    l_block = (uint16_t *)blitarena_realloc( c_entries, p_entries * sizeof( uint16_t ) );
+    if ( nullptr == l_block )
+    {
+      return false;
+    }
+    c_entries = l_block;
+    c_entry_capacity = p_entries;
+  }
+
+  /* Query stamps; these all start again from nothing when they grow. */
+  if ( p_objects > c_object_capacity )
+  {
+    l_block = (uint16_t *)blitarena_realloc( c_stamp, p_objects * sizeof( uint16_t ) );
+    if ( nullptr == l_block )
+    {
+      return false;
+    }
+    c_stamp = l_block;
+    c_object_capacity = p_objects;
+    memset( c_stamp, 0, p_objects * sizeof( uint16_t ) );
+    c_query = 0;
+  }
+
+  return true;
+}
+
+
+/*
+ * build - files a set of circles (typically the arrays of an EntityPool)
+ *         under the cells they touch. It's a counting sort; the first pass
+ *         counts what lands in each cell, and the second fills them in.
+ *
+ * const float *   - the x positions.
+ * const float *   - the y positions.
+ * const uint8_t * - the radii.
+ * uint16_t        - how many objects there are.
+ */
+
+void CollisionGrid::build( const float *p_x, const float *p_y, const uint8_t *p_radius, uint16_t p_count )
+{
+  uint16_t  l_index;
+  uint32_t  l_cells, l_cell, l_total;
+  int32_t   l_col0, l_row0, l_col1, l_row1, l_col, l_row;
+
+  /* Can't build anything without a grid. */
+  if ( ( 0 == c_columns ) || ( nullptr == c_cell_start ) )
+  {
+    return;
+  }
+  l_cells = c_columns * c_rows;
+  memset( c_cell_start, 0, ( l_cells + 1 ) * sizeof( uint32_t ) );
+
+  /* First pass; count what goes in each cell, one along. */
+  for ( l_index = 0; l_index < p_count; l_index++ )
+  {
+    span( p_x[l_index], p_y[l_index], p_radius[l_index], &l_col0, &l_row0, &l_col1, &l_row1 );
+    for ( l_row = l_row0; l_row <= l_row1; l_row++ )
+    {
+      for ( l_col = l_col0; l_col <= l_col1; l_col++ )
+      {
+        c_cell_start[wrap_row( l_row ) * c_columns + wrap_column( l_col ) + 1]++;
+      }
+    }
+  }
+
+  /* Turn the counts into where each cell starts. */
+  for ( l_cell = 1; l_cell <= l_cells; l_cell++ )
+  {
+    c_cell_start[l_cell] += c_cell_start[l_cell - 1];
+  }
+  l_total = c_cell_start[l_cells];
+
+  /* If we can't make room for that lot, leave the grid empty. */
+  if ( !reserve( p_count, l_total ) )
+  {
+    memset( c_cell_start, 0, ( l_cells + 1 ) * sizeof( uint32_t ) );
+    return;
+  }
+
+  /* Second pass; file each object, using the starts as cursors. */
+  for ( l_index = 0; l_index < p_count; l_index++ )
+  {
+    span( p_x[l_index], p_y[l_index], p_radius[l_index], &l_col0, &l_row0, &l_col1, &l_row1 );
+    for ( l_row = l_row0; l_row <= l_row1; l_row++ )
+    {
+      for ( l_col = l_col0; l_col <= l_col1; l_col++ )
+      {
+        c_entries[c_cell_start[wrap_row( l_row ) * c_columns + wrap_column( l_col )]++] = l_index;
+      }
+    }
+  }
+
+  /* The cursors have each run on to the start of the next cell; so */
+  /* shuffle them back along one to get the starts again.            */
+  for ( l_cell = l_cells; l_cell > 0; l_cell-- )
+  {
+    c_cell_start[l_cell] = c_cell_start[l_cell - 1];
+  }
+  c_cell_start[0] = 0;
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * query - finds everything filed in the cells a circle touches; these are
+ *         only candidates, and need an overlap() check to be sure. Each
+ *         object is only listed once, however many cells it's in.
+ *
+ * float      - the x position of the circle.
+ * float      - the y position of the circle.
+ * float      - the radius of the circle (zero, for a point).
+ * uint16_t * - where to list the indices of the candidates.
+ * uint16_t   - the most candidates the list can take.
+ *
+ * Returns uint16_t, the number of candidates found.
+ */
+
+uint16_t CollisionGrid::query( float p_x, float p_y, float p_radius, uint16_t *p_found, uint16_t p_max )
+{
+  uint16_t  l_count = 0, l_object;
+  uint32_t  l_cell, l_entry;
+  int32_t   l_col0, l_row0, l_col1, l_row1, l_col, l_row;
+
+  /* Nothing to look through? */
+  if ( !span( p_x, p_y, p_radius, &l_col0, &l_row0, &l_col1, &l_row1 ) || ( nullptr == c_stamp ) )
+  {
+    return 0;
+  }
+
+  /* A new query number; if they've gone all the way round, start afresh. */
+  if ( 0 == ++c_query )
+  {
+    memset( c_stamp, 0, c_object_capacity * sizeof( uint16_t ) );
+    c_query = 1;
+  }
+
+  /* Then just gather up the contents of the cells. */
+  for ( l_row = l_row0; l_row <= l_row1; l_row++ )
+  {
+    for ( l_col = l_col0; l_col <= l_col1; l_col++ )
+    {
+      l_cell = wrap_row( l_row ) * c_columns + wrap_column( l_col );
+      for ( l_entry = c_cell_start[l_cell]; l_entry < c_cell_start[l_cell + 1]; l_entry++ )
+      {
+        l_object = c_entries[l_entry];
+        if ( ( c_stamp[l_object] != c_query ) && ( l_count < p_max ) )
+        {
+          c_stamp[l_object] = c_query;
+          p_found[l_count++] = l_object;
+        }
+      }
+    }
+  }
+
+  return l_count;
+}
+
+
+/*
+ * overlap - the narrowphase; whether two circles overlap, measuring the
+ *           shortest way between them round the wrap.
+ *
+ * float - the x position of the first circle.
+ * float - the y position of the first circle.
+ * float - the radius of the first circle.
+ * float - the x position of the second circle.
+ * float - the y position of the second circle.
+ * float - the radius of the second circle.
+ *
+ * Returns bool, true if they overlap.
+ */
+
+bool CollisionGrid::overlap( float p_ax, float p_ay, float p_ar, float p_bx, float p_by, float p_br )
+{
+  float   l_dx = p_ax - p_bx, l_dy = p_ay - p_by, l_reach = p_ar + p_br;
+
+  /* If it's shorter to go round the back, go that way. */
+  if ( l_dx > c_field.w / 2.0f )
+  {
+    l_dx -= c_field.w;
+  }
+  else if ( l_dx < c_field.w / -2.0f )
+  {
+    l_dx += c_field.w;
+  }
+  if ( l_dy > c_field.h / 2.0f )
+  {
+    l_dy -= c_field.h;
+  }
+  else if ( l_dy < c_field.h / -2.0f )
+  {
+    l_dy += c_field.h;
+  }
+
+  return l_dx * l_dx + l_dy * l_dy < l_reach * l_reach;
+}
+
+
+/* End of file CollisionGrid.cpp */
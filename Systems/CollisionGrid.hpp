@@ -0,0 +1,79 @@
+/*
+ * CollisionGrid.hpp - part of Blitroids, a 32Blit game.
+ *
+ * The CollisionGrid is a uniform grid broadphase over a wrapping playfield.
+ * The field is cut into cells of roughly GRID_CELL_SIZE pixels, sized so
+ * that a whole number of them exactly covers it, and each object is filed
+ * under every cell its bounding box touches; an object straddling an edge
+ * is filed under the cells on the far side too, so nothing near the wrap is
+ * ever missed. A query then only has to look at the objects in the cells
+ * around it, rather than at everything.
+ *
+ * The grid is rebuilt from an EntityPool's arrays each step, with a single
+ * counting pass; it only allocates (from the arena) when it needs to grow
+ * beyond anything it's held before.
+ *
+ * Copyright (C) 2021 Pete Favelle <pete@fsquared.co.uk>
+ *
+ * This file is released under the MIT License; see LICENSE for more details.
+ */
+
+#ifndef   _COLLISIONGRID_HPP_
+#define   _COLLISIONGRID_HPP_
+
+#include "32blit.hpp"
+#include "blitarena.hpp"
+
+
+/* Constants & Macros. */
+
+/* Cells should be about as big as the smaller things being collided. */
+#ifndef   GRID_CELL_SIZE
+#define GRID_CELL_SIZE      16
+#endif /* GRID_CELL_SIZE */
+
+
+/* Classes. */
+
+class CollisionGrid
+{
+private:
+  blit::Rect      c_field;
+  uint16_t        c_columns = 0;
+  uint16_t        c_rows = 0;
+  float           c_cell_w = 0.0f;
+  float           c_cell_h = 0.0f;
+
+  /* Cell n holds c_entries[c_cell_start[n]] up to c_cell_start[n+1]. */
+  uint32_t       *c_cell_start = nullptr;
+  uint16_t       *c_entries = nullptr;
+  uint32_t        c_entry_capacity = 0;
+
+  /* Per object, the last query that saw it; so each is only seen once. */
+  uint16_t       *c_stamp = nullptr;
+  uint16_t        c_object_capacity = 0;
+  uint16_t        c_query = 0;
+
+  bool            span( float, float, float, int32_t *, int32_t *, int32_t *, int32_t * );
+  uint16_t        wrap_column( int32_t );
+  uint16_t        wrap_row( int32_t );
+  bool            reserve( uint16_t, uint32_t );
+
+public:
+  BLITARENA_OBJECT
+
+                  CollisionGrid( void ) {};
+                 ~CollisionGrid();
+
+  void            resize( const blit::Rect & );
+  void            build( const float *, const float *, const uint8_t *, uint16_t );
+  uint16_t        query( float, float, float, uint16_t *, uint16_t );
+  bool            overlap( float, float, float, float, float, float );
+  uint16_t        get_columns( void ) { return c_columns; };
+  uint16_t        get_rows( void ) { return c_rows; };
+};
+
+
+#endif /* _COLLISIONGRID_HPP_ */
+
+/* End of file CollisionGrid.hpp */
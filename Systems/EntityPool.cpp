@@ -0,0 +1,376 @@
+/*
+ * EntityPool.cpp - part of Blitroids, a 32Blit game.
+ *
+ * The EntityPool holds entities of one kind as parallel arrays, handing out
+ * generational handles to them; see EntityPool.hpp for the details.
+ *
+ * Copyright (C) 2021 Pete Favelle <pete@fsquared.co.uk>
+ *
+ * This file is released under the MIT License; see LICENSE for more details.
+ */
+
+/* System headers. */
+
+#include <string.h>
+
+/* Local headers. */
+
+#include "32blit.hpp"
+#include "blitarena.hpp"
+#include "EntityPool.hpp"
+
+
+/* Functions. */
+
+/*
+ * EntityPool - constructor, which carves all the arrays the pool will ever
+ *              need out of a single arena block.
+ *
+ * uint16_t - the most entities the pool can hold at once.
+ */
+
+EntityPool::EntityPool( uint16_t p_capacity )
+{
+  uint8_t  *l_ptr;
+  uint16_t  l_slot;
+
+  /* Handles only have room for 16 bits of slot, with one kept back. */
+  c_capacity = ( p_capacity < ENTITY_NO_INDEX ) ? p_capacity : ENTITY_NO_INDEX - 1;
+
+  /* The floats go first, then the 16 bit arrays, then the bytes, so */
+  /* everything stays naturally aligned within the one block.        */
+  c_block = blitarena_calloc( c_capacity, 4 * sizeof( float ) + 7 * sizeof( uint16_t ) + 2 * sizeof( uint8_t ) );
+
+  /* If the arena can't spare it, we're a pool with no room in it at all; */
+  /* create() will never find a slot, and no handle will ever be valid.   */
+  if ( nullptr == c_block )
+  {
+    c_capacity = 0;
+    return;
+  }
+  l_ptr = (uint8_t *)c_block;
+
+  c_x = (float *)l_ptr;             l_ptr += c_capacity * sizeof( float );
+  c_y = (float *)l_ptr;             l_ptr += c_capacity * sizeof( float );
+  c_dx = (float *)l_ptr;            l_ptr += c_capacity * sizeof( float );
+  c_dy = (float *)l_ptr;            l_ptr += c_capacity * sizeof( float );
+  c_angle = (uint16_t *)l_ptr;      l_ptr += c_capacity * sizeof( uint16_t );
+  c_spin = (int16_t *)l_ptr;        l_ptr += c_capacity * sizeof( int16_t );
+  c_life = (uint16_t *)l_ptr;       l_ptr += c_capacity * sizeof( uint16_t );
+  c_slot_of = (uint16_t *)l_ptr;    l_ptr += c_capacity * sizeof( uint16_t );
+  c_index_of = (uint16_t *)l_ptr;   l_ptr += c_capacity * sizeof( uint16_t );
+  c_generation = (uint16_t *)l_ptr; l_ptr += c_capacity * sizeof( uint16_t );
+  c_free = (uint16_t *)l_ptr;       l_ptr += c_capacity * sizeof( uint16_t );
+  c_radius = l_ptr;                 l_ptr += c_capacity * sizeof( uint8_t );
+  c_kind = l_ptr;
+
+  /* Every slot starts free, on its first generation. */
+  for ( l_slot = 0; l_slot < c_capacity; l_slot++ )
+  {
+    c_generation[l_slot] = 1;
+  }
+  clear();
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * ~EntityPool - destructor, which hands the arrays back to the arena.
+ */
+
+EntityPool::~EntityPool()
+{
+  blitarena_free( c_block );
+  c_block = nullptr;
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * clear - destroys every entity in the pool at once; outstanding handles
+ *         all become invalid.
+ */
+
+void EntityPool::clear( void )
+{
+  uint16_t  l_index;
+
+  /* Bump the generation of anything live, so its handle goes stale. */
+  for ( l_index = 0; l_index < c_count; l_index++ )
+  {
+    c_generation[c_slot_of[l_index]] = ( c_generation[c_slot_of[l_index]] == 0xffff ) ? 1 : c_generation[c_slot_of[l_index]] + 1;
+  }
+
+  /* And then rebuild the free list; low slots are handed out first. */
+  for ( l_index = 0; l_index < c_capacity; l_index++ )
+  {
+    c_free[l_index] = c_capacity - 1 - l_index;
+    c_index_of[l_index] = ENTITY_NO_INDEX;
+  }
+  c_free_count = c_capacity;
+  c_count = 0;
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * create - adds a new entity to the end of the pool; the rotation, spin and
+ *          lifetime all start at zero (a zero lifetime never expires).
+ *
+ * float    - the x position.
+ * float    - the y position.
+ * float    - the x velocity, in pixels per step.
+ * float    - the y velocity, in pixels per step.
+ * uint8_t  - the collision radius.
+ * uint8_t  - an optional kind, for the pool's owner to use as it sees fit.
+ *
+ * Returns entity_t, the new entity's handle, or ENTITY_NONE if it's full.
+ */
+
+entity_t EntityPool::create( float p_x, float p_y, float p_dx, float p_dy, uint8_t p_radius, uint8_t p_kind )
+{
+  uint16_t  l_slot, l_index;
+
+  /* No room, no entity. */
+  if ( 0 == c_free_count )
+  {
+    return ENTITY_NONE;
+  }
+
+  /* Take a slot, and point it at the end of the dense arrays. */
+  l_slot = c_free[--c_free_count];
+  l_index = c_count++;
+  c_slot_of[l_index] = l_slot;
+  c_index_of[l_slot] = l_index;
+
+  /* Fill in the components. */
+  c_x[l_index] = p_x;
+  c_y[l_index] = p_y;
+  c_dx[l_index] = p_dx;
+  c_dy[l_index] = p_dy;
+  c_angle[l_index] = 0;
+  c_spin[l_index] = 0;
+  c_life[l_index] = 0;
+  c_radius[l_index] = p_radius;
+  c_kind[l_index] = p_kind;
+
+  /* All done. */
+  return ENTITY_HANDLE( c_generation[l_slot], l_slot );
+}
+
+
+/*
+ * destroy_index - removes the entity at a dense index, by moving the last
+ *                 entity into its place; anything iterating the pool must
+ *                 do so backwards if it destroys as it goes.
+ *
+ * uint16_t - the index of the entity to destroy.
+ */
+
+void EntityPool::destroy_index( uint16_t p_index )
+{
+  uint16_t  l_slot, l_last;
+
+  /* Sanity check the index. */
+  if ( p_index >= c_count )
+  {
+    return;
+  }
+
+  /* Retire the slot; its generation moves on, so old handles fail. */
+  l_slot = c_slot_of[p_index];
+  c_generation[l_slot] = ( c_generation[l_slot] == 0xffff ) ? 1 : c_generation[l_slot] + 1;
+  c_index_of[l_slot] = ENTITY_NO_INDEX;
+  c_free[c_free_count++] = l_slot;
+
+  /* Swap the last entity down into the hole, unless it was the last. */
+  l_last = --c_count;
+  if ( p_index != l_last )
+  {
+    c_x[p_index] = c_x[l_last];
+    c_y[p_index] = c_y[l_last];
+    c_dx[p_index] = c_dx[l_last];
+    c_dy[p_index] = c_dy[l_last];
+    c_angle[p_index] = c_angle[l_last];
+    c_spin[p_index] = c_spin[l_last];
+    c_life[p_index] = c_life[l_last];
+    c_radius[p_index] = c_radius[l_last];
+    c_kind[p_index] = c_kind[l_last];
+
+    c_slot_of[p_index] = c_slot_of[l_last];
+    c_index_of[c_slot_of[p_index]] = p_index;
+  }
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * destroy - removes the entity with the given handle, if it's still live.
+ *
+ * entity_t - the handle of the entity to destroy.
+ *
+ * Returns bool, true if something was destroyed.
+ */
+
+bool EntityPool::destroy( entity_t p_entity )
+{
+  uint16_t  l_index = index( p_entity );
+
+  if ( ENTITY_NO_INDEX == l_index )
+  {
+    return false;
+  }
+
+  destroy_index( l_index );
+  return true;
+}
+
+
+/*
+ * valid - checks that a handle still refers to a live entity.
+ *
+ * entity_t - the handle to check.
+ *
+ * Returns bool, true if the entity is still live.
+ */
+
+bool EntityPool::valid( entity_t p_entity )
+{
+  return ENTITY_NO_INDEX != index( p_entity );
+}
+
+
+/*
+ * index - looks up where in the arrays an entity currently lives; this is
+ *         only good until the next destroy, so shouldn't be kept.
+ *
+ * entity_t - the handle to look up.
+ *
+ * Returns uint16_t, the dense index, or ENTITY_NO_INDEX if it's not live.
+ */
+
+uint16_t EntityPool::index( entity_t p_entity )
+{
+  uint16_t  l_slot = ENTITY_SLOT( p_entity );
+
+  /* The slot has to exist, and be on the same generation as the handle. */
+  if ( ( l_slot >= c_capacity ) || ( c_generation[l_slot] != ENTITY_GENERATION( p_entity ) ) )
+  {
+    return ENTITY_NO_INDEX;
+  }
+
+  return c_index_of[l_slot];
+}
+
+
+/*
+ * handle - works out the handle of the entity at a dense index, so that it
+ *          can be referred to after the pool has been shuffled.
+ *
+ * uint16_t - the dense index.
+ *
+ * Returns entity_t, the handle, or ENTITY_NONE if the index isn't live.
+ */
+
+entity_t EntityPool::handle( uint16_t p_index )
+{
+  if ( p_index >= c_count )
+  {
+    return ENTITY_NONE;
+  }
+
+  return ENTITY_HANDLE( c_generation[c_slot_of[p_index]], c_slot_of[p_index] );
+}
+
+
+/*
+ * move - the movement system; every entity is moved along by its velocity
+ *        and turned by its spin. The bounds wrap round, so anything that
+ *        leaves by one side comes straight back in on the other; things
+ *        near an edge are drawn (and collided) on both sides at once.
+ *
+ * const blit::Rect & - the bounds of the playing field.
+ */
+
+void EntityPool::move( const blit::Rect &p_bounds )
+{
+  uint16_t  l_index;
+  float     l_left, l_top, l_right, l_bottom;
+
+  l_left = (float)p_bounds.x;
+  l_top = (float)p_bounds.y;
+  l_right = (float)( p_bounds.x + p_bounds.w );
+  l_bottom = (float)( p_bounds.y + p_bounds.h );
+
+  /* Positions first; these are the arrays the compiler can stream. */
+  for ( l_index = 0; l_index < c_count; l_index++ )
+  {
+    c_x[l_index] += c_dx[l_index];
+    c_y[l_index] += c_dy[l_index];
+  }
+
+  /* Then the wrap; nothing moves more than a field in a step. */
+  for ( l_index = 0; l_index < c_count; l_index++ )
+  {
+    if ( c_x[l_index] < l_left )
+    {
+      c_x[l_index] += p_bounds.w;
+    }
+    else if ( c_x[l_index] >= l_right )
+    {
+      c_x[l_index] -= p_bounds.w;
+    }
+    if ( c_y[l_index] < l_top )
+    {
+      c_y[l_index] += p_bounds.h;
+    }
+    else if ( c_y[l_index] >= l_bottom )
+    {
+      c_y[l_index] -= p_bounds.h;
+    }
+  }
+
+  /* And lastly the rotation, kept within a whole circle of degrees. */
+  for ( l_index = 0; l_index < c_count; l_index++ )
+  {
+    c_angle[l_index] = ( c_angle[l_index] + 360 + c_spin[l_index] ) % 360;
+  }
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * age - the lifetime system; anything with a lifetime loses a step from it,
+ *       and is destroyed when it runs out. Entities with no lifetime (zero)
+ *       live until they're destroyed some other way.
+ */
+
+void EntityPool::age( void )
+{
+  uint16_t  l_index;
+
+  /* Backwards, so that swap-remove only ever moves things we've seen. */
+  for ( l_index = c_count; l_index-- > 0; )
+  {
+    if ( ( c_life[l_index] > 0 ) && ( --c_life[l_index] == 0 ) )
+    {
+      destroy_index( l_index );
+    }
+  }
+
+  /* All done. */
+  return;
+}
+
+
+/* End of file EntityPool.cpp */
@@ -0,0 +1,107 @@
+/*
+ * EntityPool.hpp - part of Blitroids, a 32Blit game.
+ *
+ * An EntityPool holds every entity of one kind (asteroids, say, or bullets)
+ * as a structure of arrays; position, velocity, rotation, radius and so on
+ * each live in their own contiguous array, and the live entities are always
+ * packed into the first get_count() entries of them. Systems, like move()
+ * and age(), are then just a linear pass over the arrays they care about.
+ *
+ * Entities are referred to from outside by handle, rather than by index,
+ * because destroying one swaps the last entity into its place. A handle
+ * carries the generation of its slot, so a handle to something that has
+ * since been destroyed (and its slot reused) is simply no longer valid.
+ *
+ * Pools are sized when they're created, and take all their storage from
+ * the arena in one go; nothing is allocated as entities come and go.
+ *
+ * Copyright (C) 2021 Pete Favelle <pete@fsquared.co.uk>
+ *
+ * This file is released under the MIT License; see LICENSE for more details.
+ */
+
+#ifndef   _ENTITYPOOL_HPP_
+#define   _ENTITYPOOL_HPP_
+
+#include "32blit.hpp"
+#include "blitarena.hpp"
+
+
+/* Constants & Macros. */
+
+/* Handles pack the slot generation above the slot number; generations */
+/* start at one, so no live entity ever has a handle of ENTITY_NONE.    */
+#define ENTITY_NONE             0
+#define ENTITY_SLOT(h)          ( (h) & 0xffff )
+#define ENTITY_GENERATION(h)    ( (h) >> 16 )
+#define ENTITY_HANDLE(g,s)      ( ( (uint32_t)(g) << 16 ) | (s) )
+#define ENTITY_NO_INDEX         0xffff
+
+
+/* Structs. */
+
+typedef uint32_t entity_t;
+
+
+/* Classes. */
+
+class EntityPool
+{
+private:
+  uint16_t        c_capacity = 0;
+  uint16_t        c_count = 0;
+  void           *c_block = nullptr;
+
+  /* Component arrays, indexed densely; the first c_count are live. */
+  float          *c_x = nullptr;
+  float          *c_y = nullptr;
+  float          *c_dx = nullptr;
+  float          *c_dy = nullptr;
+  uint16_t       *c_angle = nullptr;
+  int16_t        *c_spin = nullptr;
+  uint16_t       *c_life = nullptr;
+  uint8_t        *c_radius = nullptr;
+  uint8_t        *c_kind = nullptr;
+
+  /* Handle bookkeeping; which slot each dense entry belongs to, where */
+  /* each slot's entity currently is, and which slots are free.        */
+  uint16_t       *c_slot_of = nullptr;
+  uint16_t       *c_index_of = nullptr;
+  uint16_t       *c_generation = nullptr;
+  uint16_t       *c_free = nullptr;
+  uint16_t        c_free_count = 0;
+
+public:
+  BLITARENA_OBJECT
+
+                  EntityPool( uint16_t );
+                 ~EntityPool();
+
+  entity_t        create( float, float, float, float, uint8_t, uint8_t p_kind = 0 );
+  bool            destroy( entity_t );
+  void            destroy_index( uint16_t );
+  void            clear( void );
+  bool            valid( entity_t );
+  uint16_t        index( entity_t );
+  entity_t        handle( uint16_t );
+
+  void            move( const blit::Rect & );
+  void            age( void );
+
+  uint16_t        get_count( void ) { return c_count; };
+  uint16_t        get_capacity( void ) { return c_capacity; };
+  float          *get_x( void ) { return c_x; };
+  float          *get_y( void ) { return c_y; };
+  float          *get_dx( void ) { return c_dx; };
+  float          *get_dy( void ) { return c_dy; };
+  uint16_t       *get_angle( void ) { return c_angle; };
+  int16_t        *get_spin( void ) { return c_spin; };
+  uint16_t       *get_life( void ) { return c_life; };
+  uint8_t        *get_radius( void ) { return c_radius; };
+  uint8_t        *get_kind( void ) { return c_kind; };
+};
+
+
+#endif /* _ENTITYPOOL_HPP_ */
+
+/* End of file EntityPool.hpp */
@@ -0,0 +1,1058 @@
+/*
+ * ParticleEngine.cpp - part of Blitroids, a 32Blit game.
+ *
+ * The ParticleEngine runs every particle effect out of one pool, with a
+ * single pass to update them all; see ParticleEngine.hpp for the details.
+ *
+ * Copyright (C) 2021 Pete Favelle <pete@fsquared.co.uk>
+ *
+ * This file is released under the MIT License; see LICENSE for more details.
+ */
+
+/* System headers. */
+
+#include <math.h>
+#include <float.h>
+#include <string.h>
+
+/* Local headers. */
+
+#include "32blit.hpp"
+#include "blitarena.hpp"
+#include "blittrig.hpp"
+#include "blitrandom.hpp"
+#include "blitjobs.hpp"
+#include "BatchRenderer.hpp"
+#include "ParticleEngine.hpp"
+
+
+/* Functions. */
+
+/*
+ * particle_carve - points one of the particle arrays into a new block, and
+ *                  copies over the entries that are being kept.
+ *
+ * T *&      - the array to move.
+ * uint8_t *& - the next free byte of the block; moved on past the array.
+ * uint32_t  - the number of entries the array needs room for.
+ * uint32_t  - the number of entries to copy across.
+ */
+
+template <typename T>
+static void particle_carve( T *&p_array, uint8_t *&p_block, uint32_t p_capacity, uint32_t p_keep )
+{
+  T *l_array = (T *)p_block;
+
+  if ( p_keep > 0 )
+  {
+    memcpy( l_array, p_array, p_keep * sizeof( T ) );
+  }
+  p_array = l_array;
+  p_block += p_capacity * sizeof( T );
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * particle_fade - works out the colour at a position in the ramp table,
+ *                 blending between the two entries either side of it.
+ *
+ * const blit::Pen * - the ramp table.
+ * uint16_t          - the position, in 8.8 fixed point.
+ *
+ * Returns blit::Pen, the colour.
+ */
+
+static inline blit::Pen particle_fade( const blit::Pen *p_ramp, uint16_t p_at )
+{
+  const blit::Pen &l_from = p_ramp[p_at >> 8];
+  const blit::Pen &l_to = p_ramp[( p_at >> 8 ) + 1];
+  uint32_t         l_weight = p_at & 0xff;
+
+  return blit::Pen( ( l_from.r * ( 256 - l_weight ) + l_to.r * l_weight ) >> 8,
+                    ( l_from.g * ( 256 - l_weight ) + l_to.g * l_weight ) >> 8,
+                    ( l_from.b * ( 256 - l_weight ) + l_to.b * l_weight ) >> 8,
+                    ( l_from.a * ( 256 - l_weight ) + l_to.a * l_weight ) >> 8 );
+}
+
+
+/*
+ * particle_shade - works out how faded an edge particle is by how near the
+ *                  origin it still is, judged on each axis by the distance
+ *                  left to go to twice the edge, as a fraction of the edge
+ *                  distance; that's 2 at the origin and 1 at the edge. It's
+ *                  dim until it's clear of the origin on both axes, and the
+ *                  ramp overshoots 255 just inside the fade zone, so it's
+ *                  clamped. Other particles have all-zero coefficients, so
+ *                  they always come out at full strength.
+ *
+ * const float * - the emitter's fade coefficients, from edge_fade().
+ * float         - the x location.
+ * float         - the y location.
+ * float         - the x velocity.
+ * float         - the y velocity.
+ *
+ * Returns uint8_t, the alpha.
+ */
+
+static inline uint8_t particle_shade( const float *p_coeff, float p_x, float p_y, float p_vx, float p_vy )
+{
+  /* The coefficients are picked by index, rather than by branching on */
+  /* the direction, which is as good as random from star to star.      */
+  const float *l_cx = p_coeff + 2 * ( p_vx >= 0.0f );
+  const float *l_cy = p_coeff + 4 + 2 * ( p_vy >= 0.0f );
+  float l_fx = l_cx[0] + l_cx[1] * p_x;
+  float l_fy = l_cy[0] + l_cy[1] * p_y;
+  float l_near = ( l_fx < l_fy ) ? l_fx : l_fy;
+  float l_far = ( l_fx > l_fy ) ? l_fx : l_fy;
+  int32_t l_alpha = (int32_t)( 50.0f + ( 2.0f - l_far ) * 1000.0f );
+
+  /* Clamped, and then forced right up once we're clear of the origin. */
+  l_alpha = ( l_alpha < 255 ) ? l_alpha : 255;
+  l_alpha |= -(int32_t)( l_near <= 1.7f ) & 255;
+  return (uint8_t)l_alpha;
+}
+
+
+/*
+ * particle_velocity - picks a starting velocity for a new particle, within
+ *                     the emitter's spread of headings and range of speeds.
+ *
+ * const particle_emitter_t * - the emitter.
+ *
+ * Returns blit::Vec2, the velocity in pixels per step.
+ */
+
+static blit::Vec2 particle_velocity( const particle_emitter_t *p_emitter )
+{
+  uint16_t  l_degrees = p_emitter->heading + 360 - p_emitter->spread / 2;
+  float     l_speed = p_emitter->speed_min;
+
+  if ( p_emitter->spread > 0 )
+  {
+    l_degrees += blitrandom() % p_emitter->spread;
+  }
+  if ( p_emitter->speed_max > p_emitter->speed_min )
+  {
+    l_speed += ( p_emitter->speed_max - p_emitter->speed_min ) * ( blitrandom() & 0xffff ) / 65535.0f;
+  }
+
+  return g_trig_degrees.vector( l_degrees % 360, l_speed );
+}
+
+
+/*
+ * ParticleEngine - constructor, which takes the particle arrays from the
+ *                  arena; every emitter starts out free.
+ *
+ * uint32_t           - the most particles that can be live at once.
+ * const blit::Rect & - the bounds; particles leaving them are culled.
+ */
+
+ParticleEngine::ParticleEngine( uint32_t p_capacity, const blit::Rect &p_bounds )
+{
+  c_bounds = p_bounds;
+  memset( c_in_use, 0, sizeof( c_in_use ) );
+  memset( c_accum, 0, sizeof( c_accum ) );
+  resize( p_capacity );
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * ~ParticleEngine - destructor, which hands the arrays back to the arena.
+ */
+
+ParticleEngine::~ParticleEngine()
+{
+  blitarena_free( c_block );
+  c_block = nullptr;
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * resize - moves the particles into arrays of a new size, all carved from
+ *          one fresh arena block; live particles are kept, as many as will
+ *          fit. On failure, the existing arrays are left untouched.
+ *
+ * uint32_t - the most particles that can be live at once.
+ *
+ * Returns bool, true if the pool is now the requested size.
+ */
+
+bool ParticleEngine::resize( uint32_t p_capacity )
+{
+  void     *l_block = nullptr;
+  uint8_t  *l_ptr;
+  uint32_t  l_keep = ( c_count < p_capacity ) ? c_count : p_capacity;
+  uint32_t  l_chunks = ( p_capacity + PARTICLE_CHUNK - 1 ) / PARTICLE_CHUNK;
+
+  /* The floats go first, then the other 32 bit arrays, then the 16 bit */
+  /* ones, so everything stays naturally aligned within the one block.  */
+  if ( p_capacity > 0 )
+  {
+    l_block = blitarena_alloc( p_capacity * ( 8 * sizeof( float ) + sizeof( blit::Pen ) +
+                                              sizeof( uint32_t ) + 3 * sizeof( uint16_t ) ) +
+                               l_chunks * sizeof( uint32_t ) );
+    if ( nullptr == l_block )
+    {
+      return false;
+    }
+  }
+  l_ptr = (uint8_t *)l_block;
+
+  particle_carve( c_x, l_ptr, p_capacity, l_keep );
+  particle_carve( c_y, l_ptr, p_capacity, l_keep );
+  particle_carve( c_px, l_ptr, p_capacity, l_keep );
+  particle_carve( c_py, l_ptr, p_capacity, l_keep );
+  particle_carve( c_dx, l_ptr, p_capacity, l_keep );
+  particle_carve( c_dy, l_ptr, p_capacity, l_keep );
+  particle_carve( c_drag_x, l_ptr, p_capacity, l_keep );
+  particle_carve( c_drag_y, l_ptr, p_capacity, l_keep );
+  particle_carve( c_colour, l_ptr, p_capacity, l_keep );
+  particle_carve( c_drawn, l_ptr, p_capacity, 0 );
+  particle_carve( c_chunk_live, l_ptr, l_chunks, 0 );
+  particle_carve( c_life, l_ptr, p_capacity, l_keep );
+  particle_carve( c_ramp_at, l_ptr, p_capacity, l_keep );
+  particle_carve( c_ramp_step, l_ptr, p_capacity, l_keep );
+
+  /* Swap the blocks over; whatever we last drew is forgotten. */
+  blitarena_free( c_block );
+  c_block = l_block;
+  c_capacity = p_capacity;
+  c_count = l_keep;
+  c_drawn_count = 0;
+
+  /* All done. */
+  return true;
+}
+
+
+/*
+ * clear - removes every particle at once, and resets the emitters' timing;
+ *         the emitters themselves stay where they are.
+ */
+
+void ParticleEngine::clear( void )
+{
+  c_count = 0;
+  c_drawn_count = 0;
+  memset( c_accum, 0, sizeof( c_accum ) );
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * add_emitter - takes a copy of an emitter descriptor, and its colour ramp;
+ *               the ramp pointer in the copy is pointed at the engine's own
+ *               table, so the caller's doesn't need to stay around. A ramp
+ *               longer than PARTICLE_MAX_RAMP is cut short.
+ *
+ * const particle_emitter_t * - the descriptor.
+ *
+ * Returns uint8_t, the emitter, or PARTICLE_NO_EMITTER if they're all taken.
+ */
+
+uint8_t ParticleEngine::add_emitter( const particle_emitter_t *p_emitter )
+{
+  uint8_t     l_emitter, l_index;
+  blit::Pen  *l_ramp;
+
+  /* Find a free emitter. */
+  for ( l_emitter = 0; l_emitter < PARTICLE_MAX_EMITTERS; l_emitter++ )
+  {
+    if ( !c_in_use[l_emitter] )
+    {
+      break;
+    }
+  }
+  if ( l_emitter >= PARTICLE_MAX_EMITTERS )
+  {
+    return PARTICLE_NO_EMITTER;
+  }
+
+  /* Copy the descriptor, and the ramp into this emitter's run of the table; */
+  /* without a ramp, the particles are plain white throughout.              */
+  c_emitters[l_emitter] = *p_emitter;
+  l_ramp = &c_ramp[l_emitter * ( PARTICLE_MAX_RAMP + 1 )];
+  if ( ( nullptr == p_emitter->ramp ) || ( 0 == p_emitter->ramp_size ) )
+  {
+    l_ramp[0] = blit::Pen( 255, 255, 255 );
+    c_emitters[l_emitter].ramp_size = 1;
+  }
+  else
+  {
+    if ( c_emitters[l_emitter].ramp_size > PARTICLE_MAX_RAMP )
+    {
+      c_emitters[l_emitter].ramp_size = PARTICLE_MAX_RAMP;
+    }
+    for ( l_index = 0; l_index < c_emitters[l_emitter].ramp_size; l_index++ )
+    {
+      l_ramp[l_index] = p_emitter->ramp[l_index];
+    }
+  }
+  l_ramp[c_emitters[l_emitter].ramp_size] = l_ramp[c_emitters[l_emitter].ramp_size - 1];
+  c_emitters[l_emitter].ramp = l_ramp;
+
+  /* A life range the wrong way round is taken as just the minimum. */
+  if ( c_emitters[l_emitter].life_max < c_emitters[l_emitter].life_min )
+  {
+    c_emitters[l_emitter].life_max = c_emitters[l_emitter].life_min;
+  }
+
+  c_accum[l_emitter] = 0.0f;
+  c_in_use[l_emitter] = true;
+
+  /* All done. */
+  return l_emitter;
+}
+
+
+/*
+ * remove_emitter - frees up an emitter; any particles it has already sent
+ *                  out carry on until they die.
+ *
+ * uint8_t - the emitter.
+ */
+
+void ParticleEngine::remove_emitter( uint8_t p_emitter )
+{
+  if ( p_emitter < PARTICLE_MAX_EMITTERS )
+  {
+    c_in_use[p_emitter] = false;
+  }
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * get_emitter - fetches an emitter's descriptor, so that it can be moved,
+ *               turned or have its rate changed; changes take effect from
+ *               the next particle it sends out. The ramp is fixed when the
+ *               emitter is added, and shouldn't be changed here.
+ *
+ * uint8_t - the emitter.
+ *
+ * Returns particle_emitter_t *, the descriptor, or nullptr if it's not in use.
+ */
+
+particle_emitter_t *ParticleEngine::get_emitter( uint8_t p_emitter )
+{
+  if ( ( p_emitter >= PARTICLE_MAX_EMITTERS ) || !c_in_use[p_emitter] )
+  {
+    return nullptr;
+  }
+
+  return &c_emitters[p_emitter];
+}
+
+
+/*
+ * edge_life - works out the drag on each axis for an edge particle, and
+ *             how many steps it will live for. Along each axis the distance
+ *             still to go, to twice the edge distance, shrinks by the drag
+ *             every step, so the particle crosses the edge after a fixed
+ *             number of steps that we can solve for directly.
+ *
+ * blit::Vec2 - where the particle starts.
+ * blit::Vec2 - the starting velocity of the particle.
+ * float *    - the two drags, x then y, to fill in.
+ *
+ * Returns float, the number of steps; FLT_MAX if it never leaves.
+ */
+
+float ParticleEngine::edge_life( blit::Vec2 p_origin, blit::Vec2 p_velocity, float *p_drag )
+{
+  float     l_steps = FLT_MAX;
+  float     l_speed[2] = { fabsf( p_velocity.x ), fabsf( p_velocity.y ) };
+  float     l_edge[2];
+  float     l_ratio;
+  uint8_t   l_axis;
+
+  /* Which edge we're heading for depends on the direction. */
+  l_edge[0] = ( p_velocity.x < 0.0f ) ? p_origin.x - c_bounds.x : c_bounds.x + c_bounds.w - p_origin.x;
+  l_edge[1] = ( p_velocity.y < 0.0f ) ? p_origin.y - c_bounds.y : c_bounds.y + c_bounds.h - p_origin.y;
+
+  /* We die on whichever axis gets us out first. */
+  for ( l_axis = 0; l_axis < 2; l_axis++ )
+  {
+    /* Stationary on this axis, we'll never leave this way. */
+    p_drag[l_axis] = 1.0f;
+    if ( ( l_speed[l_axis] <= 0.0f ) || ( l_edge[l_axis] <= 0.0f ) )
+    {
+      continue;
+    }
+
+    /* We reach the edge when drag^steps drops to a half; too slow to */
+    /* register at all, we count as stationary.                       */
+    l_ratio = 1.0f - l_speed[l_axis] / ( 2.0f * l_edge[l_axis] );
+    if ( l_ratio >= 1.0f )
+    {
+      continue;
+    }
+    if ( l_ratio <= 0.0f )
+    {
+      p_drag[l_axis] = 0.0f;
+      l_steps = 1.0f;
+      continue;
+    }
+    p_drag[l_axis] = l_ratio;
+    l_ratio = ceilf( logf( 0.5f ) / logf( l_ratio ) );
+    if ( l_ratio < l_steps )
+    {
+      l_steps = l_ratio;
+    }
+  }
+
+  return l_steps;
+}
+
+
+/*
+ * edge_fade - works out every emitter's coefficients for particle_shade();
+ *             the distance factor on each axis is linear in the location,
+ *             depending only on which way the particle is heading, so this
+ *             saves dividing for every particle. Emitters that aren't edge
+ *             emitters get all zeroes, and so never fade.
+ *
+ *             Each emitter has eight coefficients; base and scale, heading
+ *             left, right, up and down.
+ *
+ * Returns bool, true if any emitter in use is an edge emitter.
+ */
+
+bool ParticleEngine::edge_fade( void )
+{
+  const particle_emitter_t *l_emitter;
+  float    *l_coeff;
+  float     l_low[2] = { (float)c_bounds.x, (float)c_bounds.y };
+  float     l_high[2] = { (float)( c_bounds.x + c_bounds.w ), (float)( c_bounds.y + c_bounds.h ) };
+  float     l_origin[2], l_edge;
+  uint8_t   l_index, l_axis;
+  bool      l_edges = false;
+
+  memset( c_fade, 0, sizeof( c_fade ) );
+  for ( l_index = 0; l_index < PARTICLE_MAX_EMITTERS; l_index++ )
+  {
+    l_emitter = &c_emitters[l_index];
+    if ( !c_in_use[l_index] || !( l_emitter->flags & PARTICLE_EDGE ) )
+    {
+      continue;
+    }
+    l_edges = true;
+    l_coeff = &c_fade[l_index * 8];
+    l_origin[0] = l_emitter->origin.x;
+    l_origin[1] = l_emitter->origin.y;
+
+    /* Right on an edge, a particle never gets any further from it. */
+    for ( l_axis = 0; l_axis < 2; l_axis++ )
+    {
+      l_edge = l_origin[l_axis] - l_low[l_axis];
+      l_coeff[l_axis * 4 + 0] = ( l_edge > 0.0f ) ? 2.0f - l_origin[l_axis] / l_edge : 2.0f;
+      l_coeff[l_axis * 4 + 1] = ( l_edge > 0.0f ) ? 1.0f / l_edge : 0.0f;
+      l_edge = l_high[l_axis] - l_origin[l_axis];
+      l_coeff[l_axis * 4 + 2] = ( l_edge > 0.0f ) ? 2.0f + l_origin[l_axis] / l_edge : 2.0f;
+      l_coeff[l_axis * 4 + 3] = ( l_edge > 0.0f ) ? -1.0f / l_edge : 0.0f;
+    }
+  }
+
+  return l_edges;
+}
+
+
+/*
+ * launch - adds a particle from an emitter, as though it had been sent out
+ *          and then run through the given number of steps; movement under
+ *          drag has a closed form, so this costs the same whatever the age.
+ *
+ * uint8_t    - the emitter.
+ * blit::Vec2 - the starting velocity.
+ * uint32_t   - the number of steps it has already moved for.
+ *
+ * Returns bool, true if the particle is still alive, and was added.
+ */
+
+bool ParticleEngine::launch( uint8_t p_emitter, blit::Vec2 p_velocity, uint32_t p_age )
+{
+  const particle_emitter_t *l_emitter = &c_emitters[p_emitter];
+  float     l_origin[2] = { l_emitter->origin.x, l_emitter->origin.y };
+  float     l_velocity[2] = { p_velocity.x, p_velocity.y };
+  float     l_drag[2], l_location[2], l_previous[2], l_now[2];
+  float     l_life, l_gone, l_before;
+  uint32_t  l_index;
+  uint16_t  l_base, l_step;
+  uint8_t   l_axis;
+
+  /* No room, no particle. */
+  if ( c_count >= c_capacity )
+  {
+    return false;
+  }
+
+  /* Edge particles live until they leave; the rest pick a lifetime. */
+  if ( l_emitter->flags & PARTICLE_EDGE )
+  {
+    l_life = edge_life( l_emitter->origin, p_velocity, l_drag );
+    l_life = ( l_life < l_emitter->life_max ) ? l_life : l_emitter->life_max;
+  }
+  else
+  {
+    l_drag[0] = l_drag[1] = l_emitter->drag;
+    l_life = l_emitter->life_min + blitrandom() % ( l_emitter->life_max - l_emitter->life_min + 1 );
+  }
+  l_life = ( l_life > 1.0f ) ? l_life : 1.0f;
+  if ( p_age >= l_life )
+  {
+    return false;
+  }
+
+  /* After n steps, we've covered v * ( 1 + d + ... + d^(n-1) ), and are */
+  /* moving at v * d^n; the previous location is the same, one short.   */
+  for ( l_axis = 0; l_axis < 2; l_axis++ )
+  {
+    if ( l_drag[l_axis] >= 1.0f )
+    {
+      l_gone = (float)p_age;
+      l_before = (float)p_age - 1.0f;
+    }
+    else
+    {
+      l_gone = ( 1.0f - powf( l_drag[l_axis], (float)p_age ) ) / ( 1.0f - l_drag[l_axis] );
+      l_before = ( 1.0f - powf( l_drag[l_axis], (float)p_age - 1.0f ) ) / ( 1.0f - l_drag[l_axis] );
+    }
+    l_before = ( p_age > 0 ) ? l_before : 0.0f;
+    l_location[l_axis] = l_origin[l_axis] + l_velocity[l_axis] * l_gone;
+    l_previous[l_axis] = l_origin[l_axis] + l_velocity[l_axis] * l_before;
+    l_now[l_axis] = l_velocity[l_axis] * powf( l_drag[l_axis], (float)p_age );
+  }
+
+  /* Anything that has already left the bounds isn't worth keeping. */
+  if ( ( p_age > 0 ) &&
+       ( ( l_location[0] < c_bounds.x ) || ( l_location[0] >= c_bounds.x + c_bounds.w ) ||
+         ( l_location[1] < c_bounds.y ) || ( l_location[1] >= c_bounds.y + c_bounds.h ) ) )
+  {
+    return false;
+  }
+
+  /* The ramp is spread evenly over the whole lifetime. */
+  l_base = p_emitter * ( PARTICLE_MAX_RAMP + 1 );
+  l_step = ( ( l_emitter->ramp_size - 1 ) << 8 ) / (uint32_t)l_life;
+
+  /* Save all that away in a new slot. */
+  l_index = c_count++;
+  c_x[l_index] = l_location[0];
+  c_y[l_index] = l_location[1];
+  c_px[l_index] = l_previous[0];
+  c_py[l_index] = l_previous[1];
+  c_dx[l_index] = l_now[0];
+  c_dy[l_index] = l_now[1];
+  c_drag_x[l_index] = l_drag[0];
+  c_drag_y[l_index] = l_drag[1];
+  c_life[l_index] = (uint16_t)l_life - p_age;
+  c_ramp_at[l_index] = ( l_base << 8 ) + l_step * p_age;
+  c_ramp_step[l_index] = l_step;
+  c_colour[l_index] = particle_fade( c_ramp, c_ramp_at[l_index] );
+
+  /* All done. */
+  return true;
+}
+
+
+/*
+ * burst - sends out a number of particles from an emitter all at once; this
+ *         is how explosions are made, from emitters with no rate of their
+ *         own.
+ *
+ * uint8_t  - the emitter.
+ * uint32_t - the number of particles.
+ *
+ * Returns uint32_t, the number of particles actually sent out.
+ */
+
+uint32_t ParticleEngine::burst( uint8_t p_emitter, uint32_t p_count )
+{
+  uint32_t  l_sent = 0;
+
+  if ( nullptr == get_emitter( p_emitter ) )
+  {
+    return 0;
+  }
+
+  /* Send them out until we've made enough, or run out of space. */
+  for ( ; ( p_count > 0 ) && ( c_count < c_capacity ); p_count-- )
+  {
+    l_sent += launch( p_emitter, particle_velocity( &c_emitters[p_emitter] ), 0 );
+  }
+
+  return l_sent;
+}
+
+
+/*
+ * lifetimes - works out the mean and longest lifetime of an emitter's
+ *             particles, so that its rate can be set to hold a steady
+ *             population. Edge particles are averaged over every degree
+ *             of their spread, at the middle of their speed range.
+ *
+ * uint8_t - the emitter.
+ * float * - the mean lifetime, in steps.
+ * float * - the longest lifetime, in steps.
+ *
+ * Returns bool, true if the particles don't live forever.
+ */
+
+bool ParticleEngine::lifetimes( uint8_t p_emitter, float *p_mean, float *p_longest )
+{
+  const particle_emitter_t *l_emitter = get_emitter( p_emitter );
+  float     l_drag[2], l_life, l_total = 0.0f;
+  uint16_t  l_degrees, l_count;
+
+  if ( nullptr == l_emitter )
+  {
+    return false;
+  }
+
+  /* Fixed lifetimes are easy; the mean is in the middle of the range. */
+  if ( !( l_emitter->flags & PARTICLE_EDGE ) )
+  {
+    *p_mean = ( l_emitter->life_min + l_emitter->life_max ) / 2.0f;
+    *p_longest = l_emitter->life_max;
+    return true;
+  }
+
+  /* Sum up the lifetimes over all the headings, noting the longest. */
+  l_count = ( l_emitter->spread > 0 ) ? l_emitter->spread : 1;
+  *p_longest = 0.0f;
+  for ( l_degrees = 0; l_degrees < l_count; l_degrees++ )
+  {
+    l_life = edge_life( l_emitter->origin,
+                        g_trig_degrees.vector( ( l_emitter->heading + 360 - l_emitter->spread / 2 + l_degrees ) % 360,
+                                               ( l_emitter->speed_min + l_emitter->speed_max ) / 2.0f ),
+                        l_drag );
+    if ( l_life >= FLT_MAX )
+    {
+      return false;
+    }
+    l_life = ( l_life < l_emitter->life_max ) ? l_life : l_emitter->life_max;
+    l_total += l_life;
+    if ( l_life > *p_longest )
+    {
+      *p_longest = l_life;
+    }
+  }
+
+  *p_mean = l_total / l_count;
+  return true;
+}
+
+
+/*
+ * prewarm - fills the pool from an emitter, as if it had been running for
+ *           long enough to reach its steady state. The n'th most recent
+ *           particle was sent out n / rate steps ago; each one is placed
+ *           where it would have got to, and any that would already have
+ *           died are skipped. It can be done a slice at a time, with the
+ *           caller keeping count of how far back it has got.
+ *
+ * uint8_t    - the emitter.
+ * uint32_t * - how many particles back we've got; start from zero.
+ * uint32_t   - the most particles to look at in this slice.
+ *
+ * Returns bool, true if the emitter is now warmed up.
+ */
+
+bool ParticleEngine::prewarm( uint8_t p_emitter, uint32_t *p_spawned, uint32_t p_steps )
+{
+  const particle_emitter_t *l_emitter = get_emitter( p_emitter );
+  uint32_t  l_age;
+
+  /* Nothing will ever be sent out, so there's nothing to fill. */
+  if ( ( nullptr == l_emitter ) || ( l_emitter->rate <= 0.0f ) )
+  {
+    return true;
+  }
+
+  /* Work back through the history until nothing could survive. */
+  for ( ; p_steps > 0; p_steps--, ( *p_spawned )++ )
+  {
+    l_age = *p_spawned / l_emitter->rate;
+    if ( ( c_count >= c_capacity ) || ( l_age > l_emitter->life_max ) )
+    {
+      return true;
+    }
+
+    /* It has moved once on the step it was born. */
+    launch( p_emitter, particle_velocity( l_emitter ), l_age + 1 );
+  }
+
+  return false;
+}
+
+
+/*
+ * particle_kernel - the per-step kernel; moves, drags, fades and culls every
+ *                   particle in one straight pass, packing the survivors down
+ *                   as it goes. Every particle is written to the next packed
+ *                   slot whether it lives or not, and the slot only moves on
+ *                   if it does, so there are no branches in the loop body.
+ *                   That packing store keeps it from vectorising, but it is
+ *                   still a single streaming pass over each array. It's a
+ *                   plain function so that the restrict qualifiers stick.
+ *
+ * uint32_t          - the number of particles.
+ * ...               - each of the particle arrays.
+ * const blit::Pen * - the ramp table.
+ * const float *     - the bounds; left, top, right and bottom.
+ *
+ * Returns uint32_t, the number of particles still alive.
+ */
+
+static uint32_t particle_kernel( uint32_t p_count,
+                                 float *__restrict p_x, float *__restrict p_y,
+                                 float *__restrict p_px, float *__restrict p_py,
+                                 float *__restrict p_dx, float *__restrict p_dy,
+                                 float *__restrict p_drag_x, float *__restrict p_drag_y,
+                                 blit::Pen *__restrict p_colour,
+                                 uint16_t *__restrict p_life,
+                                 uint16_t *__restrict p_ramp_at,
+                                 uint16_t *__restrict p_ramp_step,
+                                 const blit::Pen *p_ramp, const float *p_bounds )
+{
+  uint32_t  l_index, l_live = 0;
+
+  /* Pull the bounds into locals, so they sit in registers. */
+  const float l_left = p_bounds[0], l_top = p_bounds[1];
+  const float l_right = p_bounds[2], l_bottom = p_bounds[3];
+
+  for ( l_index = 0; l_index < p_count; l_index++ )
+  {
+    float     l_x = p_x[l_index], l_y = p_y[l_index];
+    float     l_vx = p_dx[l_index], l_vy = p_dy[l_index];
+    float     l_gx = p_drag_x[l_index], l_gy = p_drag_y[l_index];
+    uint16_t  l_life = p_life[l_index] - 1;
+    uint16_t  l_step = p_ramp_step[l_index];
+    uint16_t  l_at = p_ramp_at[l_index] + l_step;
+
+    /* Remember where we were, to interpolate from when rendering. */
+    p_px[l_live] = l_x;
+    p_py[l_live] = l_y;
+
+    /* Move it, and let the drag slow it down. */
+    l_x += l_vx;
+    l_y += l_vy;
+    p_x[l_live] = l_x;
+    p_y[l_live] = l_y;
+    p_dx[l_live] = l_vx * l_gx;
+    p_dy[l_live] = l_vy * l_gy;
+    p_drag_x[l_live] = l_gx;
+    p_drag_y[l_live] = l_gy;
+
+    /* Age it, and fade it along its ramp. */
+    p_life[l_live] = l_life;
+    p_ramp_at[l_live] = l_at;
+    p_ramp_step[l_live] = l_step;
+    p_colour[l_live] = particle_fade( p_ramp, l_at );
+
+    /* And only keep the slot if it's still alive, and in bounds. */
+    l_live += ( l_life > 0 ) & ( l_x >= l_left ) & ( l_x < l_right ) &
+              ( l_y >= l_top ) & ( l_y < l_bottom );
+  }
+
+  return l_live;
+}
+
+
+/*
+ * update_chunk - the job that runs the kernel over one chunk of the pool,
+ *                packing its survivors down to the start of the chunk.
+ *
+ * void *   - the ParticleEngine.
+ * uint32_t - the chunk.
+ * uint32_t - the first particle in the chunk.
+ * uint32_t - the particle after the last one in the chunk.
+ */
+
+void ParticleEngine::update_chunk( void *p_engine, uint32_t p_chunk, uint32_t p_first, uint32_t p_last )
+{
+  ParticleEngine *l_engine = (ParticleEngine *)p_engine;
+
+  l_engine->c_chunk_live[p_chunk] =
+    particle_kernel( p_last - p_first,
+                     l_engine->c_x + p_first, l_engine->c_y + p_first,
+                     l_engine->c_px + p_first, l_engine->c_py + p_first,
+                     l_engine->c_dx + p_first, l_engine->c_dy + p_first,
+                     l_engine->c_drag_x + p_first, l_engine->c_drag_y + p_first,
+                     l_engine->c_colour + p_first, l_engine->c_life + p_first,
+                     l_engine->c_ramp_at + p_first, l_engine->c_ramp_step + p_first,
+                     l_engine->c_ramp, l_engine->c_limits );
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * shade_chunk - the job that fades one chunk of the pool by how far each
+ *               particle has got from its origin; it works from where the
+ *               particle moved from last, so shading twice between updates
+ *               changes nothing. Each emitter's run of the ramp table says
+ *               whose particle it is.
+ *
+ * void *   - the ParticleEngine.
+ * uint32_t - the chunk.
+ * uint32_t - the first particle in the chunk.
+ * uint32_t - the particle after the last one in the chunk.
+ */
+
+void ParticleEngine::shade_chunk( void *p_engine, uint32_t p_chunk, uint32_t p_first, uint32_t p_last )
+{
+  ParticleEngine *l_engine = (ParticleEngine *)p_engine;
+  const float    *l_coeff;
+  uint32_t        l_index;
+  uint8_t         l_alpha;
+
+  for ( l_index = p_first; l_index < p_last; l_index++ )
+  {
+    l_coeff = l_engine->c_fade + ( ( l_engine->c_ramp_at[l_index] >> 8 ) / ( PARTICLE_MAX_RAMP + 1 ) ) * 8;
+    l_alpha = particle_shade( l_coeff, l_engine->c_px[l_index], l_engine->c_py[l_index],
+                              l_engine->c_dx[l_index], l_engine->c_dy[l_index] );
+    l_engine->c_colour[l_index].a = ( l_engine->c_colour[l_index].a < l_alpha ) ? l_engine->c_colour[l_index].a : l_alpha;
+  }
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * particle_move - copies a run of entries in one of the particle arrays to
+ *                 somewhere else in it; the two never overlap.
+ *
+ * T *      - the array.
+ * uint32_t - where the run is going.
+ * uint32_t - where the run is now.
+ * uint32_t - the length of the run.
+ */
+
+template <typename T>
+static inline void particle_move( T *p_array, uint32_t p_to, uint32_t p_from, uint32_t p_count )
+{
+  memcpy( p_array + p_to, p_array + p_from, p_count * sizeof( T ) );
+}
+
+
+/*
+ * pack - closes up the holes the chunks leave after their survivors. The
+ *        gap after the first chunk that isn't full is filled from the end
+ *        of the last chunk that isn't empty, and so on until they meet;
+ *        only as many particles move as died, wherever the holes are.
+ *
+ * uint32_t - the number of chunks.
+ */
+
+void ParticleEngine::pack( uint32_t p_chunks )
+{
+  uint32_t  l_hole = 0, l_tail = p_chunks - 1, l_to, l_from, l_move, l_room;
+
+  while ( l_hole < l_tail )
+  {
+    /* Skip over chunks that are already full, or already empty. */
+    l_room = PARTICLE_CHUNK - c_chunk_live[l_hole];
+    if ( 0 == l_room )
+    {
+      l_hole++;
+      continue;
+    }
+    if ( 0 == c_chunk_live[l_tail] )
+    {
+      l_tail--;
+      continue;
+    }
+
+    /* Move as many as will fit, or as many as there are. */
+    l_move = ( l_room < c_chunk_live[l_tail] ) ? l_room : c_chunk_live[l_tail];
+    l_to = l_hole * PARTICLE_CHUNK + c_chunk_live[l_hole];
+    l_from = l_tail * PARTICLE_CHUNK + c_chunk_live[l_tail] - l_move;
+    particle_move( c_x, l_to, l_from, l_move );
+    particle_move( c_y, l_to, l_from, l_move );
+    particle_move( c_px, l_to, l_from, l_move );
+    particle_move( c_py, l_to, l_from, l_move );
+    particle_move( c_dx, l_to, l_from, l_move );
+    particle_move( c_dy, l_to, l_from, l_move );
+    particle_move( c_drag_x, l_to, l_from, l_move );
+    particle_move( c_drag_y, l_to, l_from, l_move );
+    particle_move( c_colour, l_to, l_from, l_move );
+    particle_move( c_life, l_to, l_from, l_move );
+    particle_move( c_ramp_at, l_to, l_from, l_move );
+    particle_move( c_ramp_step, l_to, l_from, l_move );
+    c_chunk_live[l_hole] += l_move;
+    c_chunk_live[l_tail] -= l_move;
+  }
+
+  /* Everything up to where they met is now full. */
+  c_count = l_hole * PARTICLE_CHUNK + c_chunk_live[l_hole];
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * update - called every step; each emitter sends out new particles at its
+ *          own rate, and then everything is run through the kernel, a
+ *          chunk at a time, and packed back together.
+ */
+
+void ParticleEngine::update( void )
+{
+  uint8_t   l_emitter;
+  uint32_t  l_new, l_chunks;
+
+  /* New particles at each emitter's rate; the fractional part carries */
+  /* over, so low rates still average out correctly.                   */
+  for ( l_emitter = 0; l_emitter < PARTICLE_MAX_EMITTERS; l_emitter++ )
+  {
+    if ( c_in_use[l_emitter] && ( c_emitters[l_emitter].rate > 0.0f ) )
+    {
+      c_accum[l_emitter] += c_emitters[l_emitter].rate;
+      l_new = c_accum[l_emitter];
+      c_accum[l_emitter] -= l_new;
+      burst( l_emitter, l_new );
+    }
+  }
+
+  /* Then move everyone along, dropping any that die or leave. */
+  c_limits[0] = c_bounds.x;
+  c_limits[1] = c_bounds.y;
+  c_limits[2] = c_bounds.x + c_bounds.w;
+  c_limits[3] = c_bounds.y + c_bounds.h;
+  l_chunks = blitjobs_run( c_count, PARTICLE_CHUNK, update_chunk, this );
+  if ( l_chunks > 0 )
+  {
+    pack( l_chunks );
+  }
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * locate - works out where each live particle falls part way between its
+ *          previous and current location, and records it for drawing.
+ *
+ * float - how far from the previous location to the current (0.0 - 1.0)
+ */
+
+void ParticleEngine::locate( float p_alpha )
+{
+  /* The batch renderer does this in a single clipping pass. */
+  batch_project( blit::screen.clip, c_px, c_py, c_x, c_y, p_alpha, c_count, c_drawn );
+
+  /* The record now matches the live list. */
+  c_drawn_count = c_count;
+
+  /* Edge particles fade in by how far they have got; this is only ever */
+  /* done for what is drawn, and only if there are any edge emitters.   */
+  if ( edge_fade() )
+  {
+    blitjobs_run( c_count, PARTICLE_CHUNK, shade_chunk, this );
+  }
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * draw - plots every particle at its recorded location.
+ *
+ * blit::Surface & - the surface to draw onto.
+ */
+
+void ParticleEngine::draw( blit::Surface &p_surface )
+{
+  /* Hand the lot over to the batch renderer. */
+  batch_points( p_surface, c_drawn, c_colour, c_drawn_count );
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * draw - adds every particle, at its recorded location, to a draw list; the
+ *        list draws straight from our arrays, so mustn't outlive the next
+ *        locate() or update().
+ *
+ * DrawList * - the list to draw into.
+ */
+
+void ParticleEngine::draw( DrawList *p_list )
+{
+  p_list->points( c_drawn, c_colour, c_drawn_count );
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * erase - paints over every recorded particle location on the screen. If
+ *         given a backdrop layer, the pixel is restored exactly from there;
+ *         otherwise it's painted with the pen and added to the dirty region,
+ *         so that whatever belongs on top can be put back by the caller.
+ *
+ * const blit::Surface * - the layer to restore from, or nullptr.
+ * blit::Pen             - the pen to paint with, without a layer.
+ * DirtyRegion *         - the region to record the painted pixels in.
+ */
+
+void ParticleEngine::erase( const blit::Surface *p_backdrop, blit::Pen p_pen, DirtyRegion *p_dirty )
+{
+  uint32_t  l_index;
+  uint32_t  l_offset;
+  uint8_t   l_stride = blit::screen.pixel_stride;
+
+  /* Restoring from the layer is a straight copy. */
+  if ( nullptr != p_backdrop )
+  {
+    for ( l_index = 0; l_index < c_drawn_count; l_index++ )
+    {
+      if ( BATCH_OFFSCREEN != c_drawn[l_index] )
+      {
+        l_offset = BATCH_Y( c_drawn[l_index] ) * blit::screen.row_stride + BATCH_X( c_drawn[l_index] ) * l_stride;
+        memcpy( blit::screen.data + l_offset, p_backdrop->data + l_offset, l_stride );
+      }
+    }
+    return;
+  }
+
+  /* Otherwise, paint and report. */
+  blit::screen.pen = p_pen;
+  for ( l_index = 0; l_index < c_drawn_count; l_index++ )
+  {
+    if ( BATCH_OFFSCREEN != c_drawn[l_index] )
+    {
+      blit::screen.pixel( blit::Point( BATCH_X( c_drawn[l_index] ), BATCH_Y( c_drawn[l_index] ) ) );
+      p_dirty->add_pixel( BATCH_X( c_drawn[l_index] ), BATCH_Y( c_drawn[l_index] ) );
+    }
+  }
+
+  /* All done. */
+  return;
+}
+
+
+/* End of file ParticleEngine.cpp */
@@ -0,0 +1,154 @@
+/*
+ * ParticleEngine.hpp - part of Blitroids, a 32Blit game.
+ *
+ * The ParticleEngine runs every single pixel particle effect (star fields,
+ * exhaust, explosions and the like) out of one pool. The particles live as
+ * a structure of arrays, sized once and taken from the arena in a single
+ * block; the live ones are always packed into the front of the arrays, so
+ * that update() is one straight pass which moves, fades and culls them all
+ * together, whichever emitter they came from.
+ *
+ * Emitters are just small descriptors; where particles start, how many a
+ * step, which way and how fast they go, how long they last and the ramp of
+ * colours they fade through over that time. Each one's ramp is copied into
+ * a table the engine keeps, so the particles only need to carry a position
+ * in that table; adding an emitter never allocates anything.
+ *
+ * Big pools are updated a chunk at a time through the job system, so that
+ * desktop builds can spread them over every core; each chunk packs its own
+ * survivors down, and the holes left at the end of each are then filled
+ * from the back of the pool. Small pools are just the one chunk.
+ *
+ * An emitter flagged PARTICLE_EDGE gives each particle a drag of its own,
+ * per axis, so that it glides out towards twice the distance to the edge
+ * it is heading for; it crosses that edge half way there, after a number
+ * of steps that depends on the heading. Its particles also fade in by how
+ * far they have got from the origin towards that edge, on top of the ramp;
+ * that's worked out when they're located for drawing, rather than in the
+ * update, so other emitters never pay for it. This is the starburst.
+ *
+ * Copyright (C) 2021 Pete Favelle <pete@fsquared.co.uk>
+ *
+ * This file is released under the MIT License; see LICENSE for more details.
+ */
+
+#ifndef   _PARTICLEENGINE_HPP_
+#define   _PARTICLEENGINE_HPP_
+
+#include "32blit.hpp"
+#include "blitarena.hpp"
+#include "DirtyRegion.hpp"
+#include "DrawList.hpp"
+
+
+/* Constants & Macros. */
+
+#define PARTICLE_MAX_EMITTERS   8
+#define PARTICLE_MAX_RAMP       8
+#define PARTICLE_NO_EMITTER     0xff
+#define PARTICLE_CHUNK          2048
+
+/* Emitter flags. */
+#define PARTICLE_EDGE           0x01
+
+
+/* Structs. */
+
+typedef struct
+{
+  blit::Vec2        origin;
+  float             rate;         /* Particles per step; zero for bursts only. */
+  uint16_t          heading;      /* Degrees, as g_trig_degrees has them.      */
+  uint16_t          spread;       /* Degrees of arc, centred on the heading.   */
+  float             speed_min;    /* Pixels per step.                          */
+  float             speed_max;
+  uint16_t          life_min;     /* Steps; edge particles use life_max as a   */
+  uint16_t          life_max;     /* cap on how long they can take to leave.   */
+  float             drag;         /* Fraction of the velocity kept each step.  */
+  const blit::Pen  *ramp;         /* Colours over the lifetime, first to last. */
+  uint8_t           ramp_size;
+  uint8_t           flags;
+} particle_emitter_t;
+
+
+/* Classes. */
+
+class ParticleEngine
+{
+private:
+  uint32_t            c_capacity = 0;
+  uint32_t            c_count = 0;
+  blit::Rect          c_bounds;
+  float               c_limits[4];
+  float               c_fade[PARTICLE_MAX_EMITTERS * 8];
+  void               *c_block = nullptr;
+
+  /* Particle arrays, indexed densely; the first c_count are live. The */
+  /* ramp position is 8.8 fixed point, straight into c_ramp.            */
+  float              *c_x = nullptr;
+  float              *c_y = nullptr;
+  float              *c_px = nullptr;
+  float              *c_py = nullptr;
+  float              *c_dx = nullptr;
+  float              *c_dy = nullptr;
+  float              *c_drag_x = nullptr;
+  float              *c_drag_y = nullptr;
+  blit::Pen          *c_colour = nullptr;
+  uint16_t           *c_life = nullptr;
+  uint16_t           *c_ramp_at = nullptr;
+  uint16_t           *c_ramp_step = nullptr;
+
+  /* Where each particle was last drawn, packed as BATCH_PACK does, so */
+  /* that a dirty render knows exactly which pixels to put back.       */
+  uint32_t           *c_drawn = nullptr;
+  uint32_t            c_drawn_count = 0;
+
+  /* How many survived in each chunk, the last time it was updated. */
+  uint32_t           *c_chunk_live = nullptr;
+
+  /* The emitters, with a run of the ramp table each; every run has its */
+  /* last colour repeated after it, so the fade never reads past it.    */
+  particle_emitter_t  c_emitters[PARTICLE_MAX_EMITTERS];
+  float               c_accum[PARTICLE_MAX_EMITTERS];
+  bool                c_in_use[PARTICLE_MAX_EMITTERS];
+  blit::Pen           c_ramp[PARTICLE_MAX_EMITTERS * ( PARTICLE_MAX_RAMP + 1 )];
+
+  float               edge_life( blit::Vec2, blit::Vec2, float * );
+  bool                edge_fade( void );
+  bool                launch( uint8_t, blit::Vec2, uint32_t );
+  void                pack( uint32_t );
+  static void         update_chunk( void *, uint32_t, uint32_t, uint32_t );
+  static void         shade_chunk( void *, uint32_t, uint32_t, uint32_t );
+
+public:
+  BLITARENA_OBJECT
+
+                      ParticleEngine( uint32_t, const blit::Rect & );
+                     ~ParticleEngine();
+
+  bool                resize( uint32_t );
+  void                clear( void );
+
+  uint8_t             add_emitter( const particle_emitter_t * );
+  void                remove_emitter( uint8_t );
+  particle_emitter_t *get_emitter( uint8_t );
+  uint32_t            burst( uint8_t, uint32_t );
+  bool                lifetimes( uint8_t, float *, float * );
+  bool                prewarm( uint8_t, uint32_t *, uint32_t );
+
+  void                update( void );
+  void                locate( float );
+  void                draw( blit::Surface & );
+  void                draw( DrawList * );
+  void                erase( const blit::Surface *, blit::Pen, DirtyRegion * );
+
+  uint32_t            get_count( void ) { return c_count; };
+  uint32_t            get_capacity( void ) { return c_capacity; };
+  void                set_bounds( const blit::Rect &p_bounds ) { c_bounds = p_bounds; };
+
+};
+
+
+#endif /* _PARTICLEENGINE_HPP_ */
+
+/* End of file ParticleEngine.hpp */
@@ -0,0 +1,418 @@
+/*
+ * blitarena.cpp - part of Blitroids, a 32Blit game.
+ *
+ * This is a fixed-size arena that the game allocates from instead of the
+ * general heap; see blitarena.hpp for the details.
+ *
+ * Copyright (C) 2021 Pete Favelle <pete@fsquared.co.uk>
+ *
+ * This file is released under the MIT License; see LICENSE for more details.
+ */
+
+/* System headers. */
+
+#include <stdio.h>
+#include <string.h>
+
+
+/* Local headers. */
+
+#include "blitroids.hpp"
+#include "blitarena.hpp"
+
+
+/* Constants & Macros. */
+
+#define ARENA_ROUND(n)    ( ( (n) + ARENA_ALIGN - 1 ) & ~( ARENA_ALIGN - 1 ) )
+
+/* Blocks at least this big are taken from the top of the arena. */
+#define ARENA_LARGE       ( 16 * 1024 )
+
+
+/* Structs. */
+
+/* Each block starts with this header; the size includes the header. */
+typedef struct
+{
+  uint32_t  size;
+  uint32_t  used;
+  uint8_t   padding[ARENA_ALIGN - 2 * sizeof( uint32_t )];
+} arena_block_t;
+
+static_assert( sizeof( arena_block_t ) == ARENA_ALIGN, "Arena block headers must keep blocks aligned" );
+static_assert( ARENA_SIZE % ARENA_ALIGN == 0, "The arena must be a whole number of aligned blocks" );
+
+
+/* Module variables. */
+
+alignas( ARENA_ALIGN ) static uint8_t m_arena[ARENA_SIZE];
+static bool                           m_arena_ready;
+static uint32_t                       m_arena_used;
+static uint32_t                       m_arena_high_water;
+
+
+/* Functions. */
+
+/*
+ * arena_block - finds the block at an offset into the arena.
+ *
+ * uint32_t - the offset of the block.
+ *
+ * Returns arena_block_t *, the block header.
+ */
+
+static inline arena_block_t *arena_block( uint32_t p_offset )
+{
+  return (arena_block_t *)( m_arena + p_offset );
+}
+
+
+/*
+ * arena_merge - merges any free blocks that follow a block into it.
+ *
+ * arena_block_t * - the block to grow.
+ *
+ * Returns uint32_t, the number of bytes the block grew by.
+ */
+
+static uint32_t arena_merge( arena_block_t *p_block )
+{
+  uint32_t        l_offset = (uint8_t *)p_block - m_arena;
+  uint32_t        l_grown = 0;
+  arena_block_t  *l_next;
+
+  while ( l_offset + p_block->size < ARENA_SIZE )
+  {
+    l_next = arena_block( l_offset + p_block->size );
+    if ( l_next->used )
+    {
+      break;
+    }
+    p_block->size += l_next->size;
+    l_grown += l_next->size;
+  }
+
+  return l_grown;
+}
+
+
+/*
+ * arena_split - trims a used block down to size, if what's left over is
+ *               worth having as a block of its own.
+ *
+ * arena_block_t * - the block to trim.
+ * uint32_t        - the size it needs to be, including its header.
+ */
+
+static void arena_split( arena_block_t *p_block, uint32_t p_size )
+{
+  arena_block_t  *l_rest;
+
+  if ( p_block->size - p_size < 2 * ARENA_ALIGN )
+  {
+    return;
+  }
+
+  l_rest = (arena_block_t *)( (uint8_t *)p_block + p_size );
+  l_rest->size = p_block->size - p_size;
+  l_rest->used = 0;
+  p_block->size = p_size;
+  m_arena_used -= l_rest->size;
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * arena_take_first - finds the first free block something will fit in, and
+ *                    takes what it needs from the bottom of it.
+ *
+ * uint32_t - the size needed, including the header.
+ *
+ * Returns arena_block_t *, the block, or nullptr if nothing fits.
+ */
+
+static arena_block_t *arena_take_first( uint32_t p_size )
+{
+  uint32_t        l_offset;
+  arena_block_t  *l_block;
+
+  /* First fit; tidy up free blocks as we go past them. */
+  for ( l_offset = 0; l_offset < ARENA_SIZE; l_offset += l_block->size )
+  {
+    l_block = arena_block( l_offset );
+    if ( l_block->used )
+    {
+      continue;
+    }
+    arena_merge( l_block );
+    if ( l_block->size < p_size )
+    {
+      continue;
+    }
+
+    /* Found one; take what we need of it. */
+    l_block->used = 1;
+    m_arena_used += l_block->size;
+    arena_split( l_block, p_size );
+    return l_block;
+  }
+
+  return nullptr;
+}
+
+
+/*
+ * arena_take_top - finds the highest free block that something large will
+ *                  fit in, and takes the top end of it.
+ *
+ * uint32_t - the size needed, including the header.
+ *
+ * Returns arena_block_t *, the block, or nullptr if nothing fits.
+ */
+
+static arena_block_t *arena_take_top( uint32_t p_size )
+{
+  uint32_t        l_offset;
+  arena_block_t  *l_block, *l_best = nullptr;
+
+  /* Last fit; tidy up free blocks as we go past them, as first fit does. */
+  for ( l_offset = 0; l_offset < ARENA_SIZE; l_offset += l_block->size )
+  {
+    l_block = arena_block( l_offset );
+    if ( l_block->used )
+    {
+      continue;
+    }
+    arena_merge( l_block );
+    if ( l_block->size >= p_size )
+    {
+      l_best = l_block;
+    }
+  }
+  if ( nullptr == l_best )
+  {
+    return nullptr;
+  }
+
+  /* Leave the bottom of the block free, if it's worth having. */
+  if ( l_best->size - p_size >= 2 * ARENA_ALIGN )
+  {
+    l_block = (arena_block_t *)( (uint8_t *)l_best + l_best->size - p_size );
+    l_block->size = p_size;
+    l_best->size -= p_size;
+    l_best = l_block;
+  }
+  l_best->used = 1;
+  m_arena_used += l_best->size;
+
+  return l_best;
+}
+
+
+/*
+ * blitarena_alloc - allocates a block from the arena.
+ *
+ * size_t - the number of bytes needed.
+ *
+ * Returns void *, the block, or nullptr if the arena can't fit it.
+ */
+
+void *blitarena_alloc( size_t p_bytes )
+{
+  uint32_t        l_size;
+  arena_block_t  *l_block;
+
+  /* The whole arena starts off as a single free block. */
+  if ( !m_arena_ready )
+  {
+    arena_block( 0 )->size = ARENA_SIZE;
+    arena_block( 0 )->used = 0;
+    m_arena_ready = true;
+  }
+
+  if ( p_bytes > ARENA_SIZE - ARENA_ALIGN )
+  {
+    debug_printf( "Arena can't fit %lu bytes\n", (unsigned long)p_bytes );
+    return nullptr;
+  }
+  l_size = ARENA_ROUND( p_bytes ) + ARENA_ALIGN;
+
+  /* Large blocks come from the top, out of the way of everything else. */
+  if ( l_size >= ARENA_LARGE )
+  {
+    l_block = arena_take_top( l_size );
+  }
+  else
+  {
+    l_block = arena_take_first( l_size );
+  }
+
+  if ( nullptr != l_block )
+  {
+    if ( m_arena_used > m_arena_high_water )
+    {
+      m_arena_high_water = m_arena_used;
+    }
+    return l_block + 1;
+  }
+
+  debug_printf( "Arena can't fit %lu bytes; %lu of %lu in use\n", (unsigned long)p_bytes,
+                (unsigned long)m_arena_used, (unsigned long)ARENA_SIZE );
+  return nullptr;
+}
+
+
+/*
+ * blitarena_calloc - allocates a zeroed array from the arena.
+ *
+ * size_t - the number of entries.
+ * size_t - the size of each entry.
+ *
+ * Returns void *, the array, or nullptr if the arena can't fit it.
+ */
+
+void *blitarena_calloc( size_t p_count, size_t p_size )
+{
+  void   *l_space;
+
+  if ( ( 0 != p_size ) && ( p_count > ARENA_SIZE / p_size ) )
+  {
+    return nullptr;
+  }
+
+  l_space = blitarena_alloc( p_count * p_size );
+  if ( nullptr != l_space )
+  {
+    memset( l_space, 0, p_count * p_size );
+  }
+  return l_space;
+}
+
+
+/*
+ * blitarena_realloc - resizes a block, in place if the space after it is
+ *                     free; otherwise it's moved. Like realloc(), a failure
+ *                     leaves the original block untouched.
+ *
+ * void * - the block to resize, or nullptr to allocate a new one.
+ * size_t - the number of bytes needed; zero frees the block.
+ *
+ * Returns void *, the resized block, or nullptr on failure.
+ */
+
+void *blitarena_realloc( void *p_pointer, size_t p_bytes )
+{
+  arena_block_t  *l_block;
+  uint32_t        l_size;
+  void           *l_space;
+
+  if ( nullptr == p_pointer )
+  {
+    return blitarena_alloc( p_bytes );
+  }
+  if ( 0 == p_bytes )
+  {
+    blitarena_free( p_pointer );
+    return nullptr;
+  }
+  if ( p_bytes > ARENA_SIZE - ARENA_ALIGN )
+  {
+    return nullptr;
+  }
+  l_block = (arena_block_t *)p_pointer - 1;
+  l_size = ARENA_ROUND( p_bytes ) + ARENA_ALIGN;
+
+  /* If there's room where it is (or just after), it can stay put. */
+  if ( l_block->size < l_size )
+  {
+    m_arena_used += arena_merge( l_block );
+  }
+  if ( l_block->size >= l_size )
+  {
+    arena_split( l_block, l_size );
+    if ( m_arena_used > m_arena_high_water )
+    {
+      m_arena_high_water = m_arena_used;
+    }
+    return p_pointer;
+  }
+
+  /* Otherwise, it has to move. */
+  l_space = blitarena_alloc( p_bytes );
+  if ( nullptr != l_space )
+  {
+    memcpy( l_space, p_pointer, l_block->size - ARENA_ALIGN );
+    blitarena_free( p_pointer );
+  }
+  return l_space;
+}
+
+
+/*
+ * blitarena_free - returns a block to the arena.
+ *
+ * void * - the block, which may be nullptr.
+ */
+
+void blitarena_free( void *p_pointer )
+{
+  arena_block_t  *l_block;
+
+  if ( nullptr == p_pointer )
+  {
+    return;
+  }
+
+  /* Anything that didn't come from us is a bug; complain, don't crash. */
+  if ( ( (uint8_t *)p_pointer < m_arena + ARENA_ALIGN ) || ( (uint8_t *)p_pointer >= m_arena + ARENA_SIZE ) )
+  {
+    debug_printf( "Freeing %p, which isn't in the arena\n", p_pointer );
+    return;
+  }
+
+  l_block = (arena_block_t *)p_pointer - 1;
+  l_block->used = 0;
+  m_arena_used -= l_block->size;
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * blitarena_used - the number of bytes currently allocated, headers and all.
+ */
+
+uint32_t blitarena_used( void )
+{
+  return m_arena_used;
+}
+
+
+/*
+ * blitarena_high_water - the most bytes that have ever been allocated.
+ */
+
+uint32_t blitarena_high_water( void )
+{
+  return m_arena_high_water;
+}
+
+
+/*
+ * blitarena_report - reports how much of the arena is in use, and the most
+ *                    that ever has been.
+ */
+
+void blitarena_report( void )
+{
+  debug_printf( "Arena: %lu of %lu bytes in use, high water %lu\n",
+                (unsigned long)m_arena_used, (unsigned long)ARENA_SIZE,
+                (unsigned long)m_arena_high_water );
+  return;
+}
+
+
+/* End of file blitarena.cpp */
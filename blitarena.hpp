@@ -0,0 +1,107 @@
+/*
+ * blitarena.hpp - part of Blitroids, a 32Blit game.
+ *
+ * This is a fixed-size arena that the game allocates from instead of the
+ * general heap; the managers, states and backgrounds, and the arrays they
+ * size at runtime (stars, dirty pixels, layers, decoded images). It's just
+ * a static buffer, sized at build time, so everything the game needs is
+ * accounted for up front and nothing can fragment the system heap however
+ * often densities or states change.
+ *
+ * Blocks are handed out first fit, and freed blocks are merged with their
+ * free neighbours as the arena is next searched. Large blocks (full screen
+ * layers, the image arena) are taken from the top of the arena instead, so
+ * the small ones that pile up at the bottom can't leave them stranded when
+ * they're freed and wanted again. The high-water mark is tracked, so we can
+ * see how much of the arena a build really needs.
+ *
+ * Classes that should live in the arena just add BLITARENA_OBJECT to their
+ * declaration, and can then be new'd and deleted as normal.
+ *
+ * Copyright (C) 2021 Pete Favelle <pete@fsquared.co.uk>
+ *
+ * This file is released under the MIT License; see LICENSE for more details.
+ */
+
+#ifndef   _BLITARENA_HPP_
+#define   _BLITARENA_HPP_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <new>
+
+
+/* Constants & Macros. */
+
+/* The size of the arena; the handheld only has so much to go round, but */
+/* desktop builds (and the benchmark) run much denser starfields. The    */
+/* arena is static, so it shares the game's RAM region with the rest of  */
+/* its .bss, and the link fails outright if they don't fit. Without the  */
+/* splash's static layer (see SplashState.hpp) the handheld peaks around */
+/* 227KB, so 256KB leaves some room for the unexpected.                  */
+#ifndef   ARENA_SIZE
+#ifdef    TARGET_32BLIT_HW
+#define ARENA_SIZE        ( 256 * 1024 )
+#else  /* TARGET_32BLIT_HW */
+#define ARENA_SIZE        ( 4 * 1024 * 1024 )
+#endif /* TARGET_32BLIT_HW */
+#endif /* ARENA_SIZE */
+
+/* Every block is aligned to this, which is enough for anything we hold. */
+#define ARENA_ALIGN       16
+
+#define BLITARENA_OBJECT \
+  static void *operator new( size_t p_size ) noexcept { return blitarena_alloc( p_size ); } \
+  static void  operator delete( void *p_pointer ) noexcept { blitarena_free( p_pointer ); }
+
+
+/* Functions. */
+
+void     *blitarena_alloc( size_t );
+void     *blitarena_calloc( size_t, size_t );
+void     *blitarena_realloc( void *, size_t );
+void      blitarena_free( void * );
+uint32_t  blitarena_used( void );
+uint32_t  blitarena_high_water( void );
+void      blitarena_report( void );
+
+
+/*
+ * blitarena_new - constructs an object in the arena, for classes that can't
+ *                 be given BLITARENA_OBJECT (such as the engine's own).
+ *
+ * A... - the arguments passed to the constructor.
+ *
+ * Returns T *, the new object, or nullptr if the arena is full.
+ */
+
+template <typename T, typename... A>
+T *blitarena_new( A... p_args )
+{
+  void   *l_space = blitarena_alloc( sizeof( T ) );
+
+  return ( nullptr == l_space ) ? nullptr : new ( l_space ) T( p_args... );
+}
+
+
+/*
+ * blitarena_delete - destroys an object made with blitarena_new().
+ *
+ * T * - the object to destroy.
+ */
+
+template <typename T>
+void blitarena_delete( T *p_object )
+{
+  if ( nullptr != p_object )
+  {
+    p_object->~T();
+    blitarena_free( p_object );
+  }
+  return;
+}
+
+
+#endif /* _BLITARENA_HPP_ */
+
+/* End of file blitarena.hpp */
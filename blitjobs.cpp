@@ -0,0 +1,375 @@
+/*
+ * blitjobs.cpp - part of Blitroids, a 32Blit game.
+ *
+ * The job system's workers, and their deques; see blitjobs.hpp. None of
+ * this is built where the job system runs serially, as it's all inline.
+ *
+ * Copyright (C) 2021 Pete Favelle <pete@fsquared.co.uk>
+ *
+ * This file is released under the MIT License; see LICENSE for more details.
+ */
+
+/* Local headers. */
+
+#include "blitjobs.hpp"
+
+#ifndef   BLITJOBS_SERIAL
+
+/* System headers. */
+
+#include <stdlib.h>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+
+/* Constants & Macros. */
+
+/* How many times the caller looks for the last chunks to finish before */
+/* it goes to sleep until they do.                                      */
+#define BLITJOBS_SPIN         1024
+
+
+/* Structs. */
+
+typedef struct
+{
+  uint32_t          chunk;
+  uint32_t          first;
+  uint32_t          last;
+} blitjobs_job_t;
+
+/*
+ * A worker's deque; the owner pushes and pops at the back, and thieves take
+ * from the front. The indices only ever count up, and wrap into the ring.
+ */
+
+typedef struct
+{
+  std::mutex        lock;
+  blitjobs_job_t    jobs[BLITJOBS_DEQUE_SIZE];
+  uint32_t          front;
+  uint32_t          back;
+} blitjobs_deque_t;
+
+
+/* Module variables. */
+
+static blitjobs_deque_t         m_deques[BLITJOBS_MAX_WORKERS];
+static std::thread              m_threads[BLITJOBS_MAX_WORKERS];
+static uint8_t                  m_workers = 1;
+static bool                     m_registered = false;
+
+/* Sleeping workers wait for the generation to move on, or to be told to quit. */
+static std::mutex               m_wake_lock;
+static std::condition_variable  m_wake;
+static uint32_t                 m_generation = 0;
+static bool                     m_quit = false;
+
+/* The job being run, and how many of its chunks are still to finish; */
+/* whoever finishes the last one wakes the caller, if it's asleep.     */
+static blitjobs_fn_t            m_job = nullptr;
+static void                    *m_context = nullptr;
+static std::atomic<uint32_t>    m_pending( 0 );
+static std::mutex               m_done_lock;
+static std::condition_variable  m_done;
+
+
+/* Functions. */
+
+/*
+ * blitjobs_push - adds a chunk to the back of a worker's deque.
+ *
+ * uint8_t                - the worker.
+ * const blitjobs_job_t & - the chunk.
+ *
+ * Returns bool, false if the deque is full.
+ */
+
+static bool blitjobs_push( uint8_t p_worker, const blitjobs_job_t &p_job )
+{
+  blitjobs_deque_t           *l_deque = &m_deques[p_worker];
+  std::lock_guard<std::mutex> l_guard( l_deque->lock );
+
+  if ( l_deque->back - l_deque->front >= BLITJOBS_DEQUE_SIZE )
+  {
+    return false;
+  }
+  l_deque->jobs[l_deque->back++ % BLITJOBS_DEQUE_SIZE] = p_job;
+
+  return true;
+}
+
+
+/*
+ * blitjobs_take - finds a worker another chunk; the most recent from the
+ *                 back of its own deque if there is one, otherwise the
+ *                 oldest from the front of the next deque with any in.
+ *
+ * uint8_t          - the worker.
+ * blitjobs_job_t * - filled in with the chunk.
+ *
+ * Returns bool, false if there's nothing left anywhere.
+ */
+
+static bool blitjobs_take( uint8_t p_worker, blitjobs_job_t *p_job )
+{
+  blitjobs_deque_t *l_deque;
+  uint8_t           l_offset;
+
+  /* Our own work first... */
+  l_deque = &m_deques[p_worker];
+  {
+    std::lock_guard<std::mutex> l_guard( l_deque->lock );
+    if ( l_deque->back > l_deque->front )
+    {
+      *p_job = l_deque->jobs[--l_deque->back % BLITJOBS_DEQUE_SIZE];
+      return true;
+    }
+  }
+
+  /* ...and then anybody else's. */
+  for ( l_offset = 1; l_offset < m_workers; l_offset++ )
+  {
+    l_deque = &m_deques[( p_worker + l_offset ) % m_workers];
+    std::lock_guard<std::mutex> l_guard( l_deque->lock );
+    if ( l_deque->back > l_deque->front )
+    {
+      *p_job = l_deque->jobs[l_deque->front++ % BLITJOBS_DEQUE_SIZE];
+      return true;
+    }
+  }
+
+  return false;
+}
+
+
+/*
+ * blitjobs_finished - counts off a finished chunk; if it was the last, the
+ *                     caller is woken, in case it's waiting. The lock is
+ *                     taken first so that the wake can't slip in between
+ *                     the caller checking and going to sleep.
+ */
+
+static void blitjobs_finished( void )
+{
+  if ( 1 == m_pending.fetch_sub( 1, std::memory_order_acq_rel ) )
+  {
+    std::lock_guard<std::mutex> l_guard( m_done_lock );
+    m_done.notify_one();
+  }
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * blitjobs_work - runs chunks until there are none left to take; some may
+ *                 still be running on other workers when it returns.
+ *
+ * uint8_t - the worker.
+ */
+
+static void blitjobs_work( uint8_t p_worker )
+{
+  blitjobs_job_t  l_job;
+
+  while ( blitjobs_take( p_worker, &l_job ) )
+  {
+    m_job( m_context, l_job.chunk, l_job.first, l_job.last );
+    blitjobs_finished();
+  }
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * blitjobs_thread - the body of each worker thread; it sleeps until there's
+ *                   a new job, helps with it, and goes back to sleep.
+ *
+ * uint8_t - the worker.
+ */
+
+static void blitjobs_thread( uint8_t p_worker )
+{
+  uint32_t  l_seen;
+
+  {
+    std::lock_guard<std::mutex> l_guard( m_wake_lock );
+    l_seen = m_generation;
+  }
+
+  for ( ;; )
+  {
+    {
+      std::unique_lock<std::mutex> l_lock( m_wake_lock );
+      m_wake.wait( l_lock, [l_seen] { return m_quit || ( m_generation != l_seen ); } );
+      if ( m_quit )
+      {
+        return;
+      }
+      l_seen = m_generation;
+    }
+
+    blitjobs_work( p_worker );
+  }
+}
+
+
+/*
+ * blitjobs_init - starts the workers; any already running are stopped first.
+ *                 They're stopped again when the program exits.
+ *
+ * uint8_t - the number of workers, counting the caller; zero for as many as
+ *           the machine has cores, up to BLITJOBS_MAX_WORKERS.
+ */
+
+void blitjobs_init( uint8_t p_workers )
+{
+  uint8_t   l_worker;
+
+  blitjobs_fini();
+
+  /* Work out how many we're having. */
+  if ( 0 == p_workers )
+  {
+    p_workers = ( std::thread::hardware_concurrency() < BLITJOBS_MAX_WORKERS ) ?
+                std::thread::hardware_concurrency() : BLITJOBS_MAX_WORKERS;
+  }
+  m_workers = ( p_workers < 1 ) ? 1 : ( ( p_workers > BLITJOBS_MAX_WORKERS ) ? BLITJOBS_MAX_WORKERS : p_workers );
+
+  /* The caller is worker zero, so only the rest need threads. */
+  for ( l_worker = 1; l_worker < m_workers; l_worker++ )
+  {
+    m_threads[l_worker] = std::thread( blitjobs_thread, l_worker );
+  }
+
+  /* Threads still running at exit would bring the whole thing down. */
+  if ( !m_registered )
+  {
+    atexit( blitjobs_fini );
+    m_registered = true;
+  }
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * blitjobs_fini - stops all the worker threads, leaving just the caller.
+ */
+
+void blitjobs_fini( void )
+{
+  uint8_t   l_worker;
+
+  if ( m_workers <= 1 )
+  {
+    return;
+  }
+
+  {
+    std::lock_guard<std::mutex> l_guard( m_wake_lock );
+    m_quit = true;
+  }
+  m_wake.notify_all();
+
+  for ( l_worker = 1; l_worker < m_workers; l_worker++ )
+  {
+    m_threads[l_worker].join();
+  }
+  m_quit = false;
+  m_workers = 1;
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * blitjobs_workers - the number of workers running, counting the caller.
+ *
+ * Returns uint8_t, the number of workers.
+ */
+
+uint8_t blitjobs_workers( void )
+{
+  return m_workers;
+}
+
+
+/*
+ * blitjobs_run - runs a job over a range of items, a chunk at a time, and
+ *                returns once every chunk is done. Chunks are dealt out to
+ *                the workers in turn; any that don't fit in a deque are run
+ *                there and then. A job mustn't call blitjobs_run() itself.
+ *
+ * uint32_t      - the number of items.
+ * uint32_t      - the number of items in each chunk.
+ * blitjobs_fn_t - the job, called for each chunk.
+ * void *        - the context passed to the job.
+ *
+ * Returns uint32_t, the number of chunks run.
+ */
+
+uint32_t blitjobs_run( uint32_t p_count, uint32_t p_chunk, blitjobs_fn_t p_job, void *p_context )
+{
+  blitjobs_job_t  l_job;
+  uint32_t        l_chunks = ( p_count + p_chunk - 1 ) / p_chunk;
+  uint32_t        l_spin;
+
+  /* With nothing to share, or nobody to share it with, just do it here. */
+  if ( ( l_chunks <= 1 ) || ( m_workers <= 1 ) )
+  {
+    for ( l_job.chunk = 0, l_job.first = 0; l_job.first < p_count; l_job.chunk++, l_job.first += p_chunk )
+    {
+      p_job( p_context, l_job.chunk, l_job.first, ( p_count - l_job.first > p_chunk ) ? l_job.first + p_chunk : p_count );
+    }
+    return l_chunks;
+  }
+
+  /* Fork; deal the chunks out, and wake everyone up. */
+  m_job = p_job;
+  m_context = p_context;
+  m_pending.store( l_chunks, std::memory_order_relaxed );
+  for ( l_job.chunk = 0, l_job.first = 0; l_job.first < p_count; l_job.chunk++, l_job.first += p_chunk )
+  {
+    l_job.last = ( p_count - l_job.first > p_chunk ) ? l_job.first + p_chunk : p_count;
+    if ( !blitjobs_push( l_job.chunk % m_workers, l_job ) )
+    {
+      p_job( p_context, l_job.chunk, l_job.first, l_job.last );
+      blitjobs_finished();
+    }
+  }
+  {
+    std::lock_guard<std::mutex> l_guard( m_wake_lock );
+    m_generation++;
+  }
+  m_wake.notify_all();
+
+  /* Join; help out until there's nothing left to take, then wait for */
+  /* the last chunks still running elsewhere. They're usually nearly   */
+  /* done, so look a few times before sleeping until they are.         */
+  blitjobs_work( 0 );
+  for ( l_spin = 0; ( l_spin < BLITJOBS_SPIN ) && ( m_pending.load( std::memory_order_acquire ) > 0 ); l_spin++ )
+  {
+    continue;
+  }
+  if ( m_pending.load( std::memory_order_acquire ) > 0 )
+  {
+    std::unique_lock<std::mutex> l_lock( m_done_lock );
+    m_done.wait( l_lock, [] { return 0 == m_pending.load( std::memory_order_acquire ); } );
+  }
+
+  return l_chunks;
+}
+
+
+#endif /* BLITJOBS_SERIAL */
+
+/* End of file blitjobs.cpp */
@@ -0,0 +1,84 @@
+/*
+ * blitjobs.hpp - part of Blitroids, a 32Blit game.
+ *
+ * A small job system, for spreading the heavier per-step work over however
+ * many cores a desktop has. Work is handed over as a range of items and a
+ * chunk size; blitjobs_run() splits the range into fixed chunks, deals them
+ * out to a fixed set of workers and waits until they're all done, so each
+ * call is a fork and a join inside a single update.
+ *
+ * Every worker keeps its chunks in a deque of its own, taking from the back
+ * of it; once that's empty, it steals from the front of someone else's, so
+ * uneven chunks even themselves out. The calling thread is worker zero, and
+ * works alongside the rest rather than just waiting.
+ *
+ * The handheld (and the browser) has only the one core, so there the whole
+ * thing compiles down to an inline loop over the chunks. The chunks are the
+ * same whichever way they're run, so the results are too.
+ *
+ * Copyright (C) 2021 Pete Favelle <pete@fsquared.co.uk>
+ *
+ * This file is released under the MIT License; see LICENSE for more details.
+ */
+
+#ifndef   _BLITJOBS_HPP_
+#define   _BLITJOBS_HPP_
+
+#include <stdint.h>
+
+
+/* Constants & Macros. */
+
+#if defined( TARGET_32BLIT_HW ) || defined( __EMSCRIPTEN__ )
+#define BLITJOBS_SERIAL
+#endif
+
+/* The most workers we'll run, counting the caller, and the most chunks */
+/* each one's deque can hold at once.                                   */
+#define BLITJOBS_MAX_WORKERS  8
+#define BLITJOBS_DEQUE_SIZE   256
+
+
+/* Types. */
+
+/*
+ * A job is called for each chunk with its context, the chunk's number and
+ * the range of items in it; first inclusive, last exclusive.
+ */
+
+typedef void (*blitjobs_fn_t)( void *, uint32_t, uint32_t, uint32_t );
+
+
+/* Functions. */
+
+#ifdef    BLITJOBS_SERIAL
+
+static inline void      blitjobs_init( uint8_t ) {}
+static inline void      blitjobs_fini( void ) {}
+static inline uint8_t   blitjobs_workers( void ) { return 1; }
+
+static inline uint32_t  blitjobs_run( uint32_t p_count, uint32_t p_chunk, blitjobs_fn_t p_job, void *p_context )
+{
+  uint32_t  l_chunk, l_first;
+
+  for ( l_chunk = 0, l_first = 0; l_first < p_count; l_chunk++, l_first += p_chunk )
+  {
+    p_job( p_context, l_chunk, l_first, ( p_count - l_first > p_chunk ) ? l_first + p_chunk : p_count );
+  }
+
+  return l_chunk;
+}
+
+#else  /* BLITJOBS_SERIAL */
+
+void      blitjobs_init( uint8_t );
+void      blitjobs_fini( void );
+uint8_t   blitjobs_workers( void );
+uint32_t  blitjobs_run( uint32_t, uint32_t, blitjobs_fn_t, void * );
+
+#endif /* BLITJOBS_SERIAL */
+
+
+#endif /* _BLITJOBS_HPP_ */
+
+/* End of file blitjobs.hpp */
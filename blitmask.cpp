@@ -0,0 +1,287 @@
+/*
+ * blitmask.cpp - part of Blitroids, a 32Blit game.
+ *
+ * Collision masks, one bit per pixel, packed into 32 bit words per row and
+ * tested against each other a word at a time; see blitmask.hpp.
+ *
+ * Copyright (C) 2021 Pete Favelle <pete@fsquared.co.uk>
+ *
+ * This file is released under the MIT License; see LICENSE for more details.
+ */
+
+/* System headers. */
+
+#include <string.h>
+
+/* Local headers. */
+
+#include "32blit.hpp"
+#include "blitarena.hpp"
+#include "blitmask.hpp"
+
+
+/* Functions. */
+
+/*
+ * blitmask_solid - whether a pixel of a surface is solid enough to collide
+ *                  with; paletted surfaces take the alpha of the palette
+ *                  entry, and surfaces without alpha are solid throughout.
+ *
+ * const blit::Surface * - the surface.
+ * int32_t               - the x position in the surface.
+ * int32_t               - the y position in the surface.
+ *
+ * Returns bool, true if the pixel is solid.
+ */
+
+static bool blitmask_solid( const blit::Surface *p_surface, int32_t p_x, int32_t p_y )
+{
+  uint32_t  l_offset = p_y * p_surface->bounds.w + p_x;
+
+  switch( p_surface->format )
+  {
+    case blit::PixelFormat::P:
+      return p_surface->palette[p_surface->data[l_offset]].a >= BLITMASK_ALPHA;
+    case blit::PixelFormat::RGBA:
+      return p_surface->data[l_offset * 4 + 3] >= BLITMASK_ALPHA;
+    default:
+      return true;
+  }
+}
+
+
+/*
+ * blitmask_allocate - sizes a mask, and allocates it some cleared bits.
+ *
+ * blit_mask_t * - the mask.
+ * uint8_t       - the width, in pixels.
+ * uint8_t       - the height, in pixels.
+ *
+ * Returns bool, true if the bits could be allocated.
+ */
+
+static bool blitmask_allocate( blit_mask_t *p_mask, uint8_t p_width, uint8_t p_height )
+{
+  p_mask->w = p_width;
+  p_mask->h = p_height;
+  p_mask->stride = ( p_width + 31 ) / 32;
+  p_mask->bits = (uint32_t *)blitarena_calloc( p_mask->stride * p_height, sizeof( uint32_t ) );
+
+  return nullptr != p_mask->bits;
+}
+
+
+/*
+ * blitmask_build - builds the mask of part of a surface, as it would look
+ *                  blitted with the given transform; the rect is turned the
+ *                  same way blit() turns it, so a mask can be made for each
+ *                  of a sprite's quarter turns.
+ *
+ * blit_mask_t *         - the mask to build.
+ * const blit::Surface * - the surface holding the sprite.
+ * blit::Rect            - the rect of the sprite within the surface.
+ * uint8_t               - the blit::SpriteTransform to apply.
+ *
+ * Returns bool, true if the mask was built.
+ */
+
+bool blitmask_build( blit_mask_t *p_mask, const blit::Surface *p_surface, blit::Rect p_rect, uint8_t p_transform )
+{
+  int32_t   l_x, l_y, l_u, l_v, l_swap;
+  bool      l_swapped = p_transform & blit::SpriteTransform::XYSWAP;
+
+  /* A sprite turned on its side swaps its width and height. */
+  if ( ( nullptr == p_surface ) ||
+       !blitmask_allocate( p_mask, l_swapped ? p_rect.h : p_rect.w, l_swapped ? p_rect.w : p_rect.h ) )
+  {
+    return false;
+  }
+
+  /* Work back from each pixel of the mask to where it comes from. */
+  for ( l_y = 0; l_y < p_mask->h; l_y++ )
+  {
+    for ( l_x = 0; l_x < p_mask->w; l_x++ )
+    {
+      l_u = l_x;
+      l_v = l_y;
+      if ( l_swapped )
+      {
+        l_swap = l_u;
+        l_u = l_v;
+        l_v = l_swap;
+      }
+      if ( p_transform & blit::SpriteTransform::HORIZONTAL )
+      {
+        l_u = p_rect.w - 1 - l_u;
+      }
+      if ( p_transform & blit::SpriteTransform::VERTICAL )
+      {
+        l_v = p_rect.h - 1 - l_v;
+      }
+
+      if ( blitmask_solid( p_surface, p_rect.x + l_u, p_rect.y + l_v ) )
+      {
+        p_mask->bits[l_y * p_mask->stride + l_x / 32] |= 0x80000000u >> ( l_x % 32 );
+      }
+    }
+  }
+
+  /* All done. */
+  return true;
+}
+
+
+/*
+ * blitmask_circle - builds the mask of a filled circle, covering the same
+ *                   pixels as blit::Surface::circle(); the mask is 2r+1
+ *                   square, with the center in the middle.
+ *
+ * blit_mask_t * - the mask to build.
+ * uint8_t       - the radius.
+ *
+ * Returns bool, true if the mask was built.
+ */
+
+bool blitmask_circle( blit_mask_t *p_mask, uint8_t p_radius )
+{
+  int32_t   l_x, l_y, l_r = p_radius;
+
+  if ( ( p_radius > 127 ) || !blitmask_allocate( p_mask, 2 * p_radius + 1, 2 * p_radius + 1 ) )
+  {
+    return false;
+  }
+
+  for ( l_y = -l_r; l_y <= l_r; l_y++ )
+  {
+    for ( l_x = -l_r; l_x <= l_r; l_x++ )
+    {
+      if ( l_x * l_x + l_y * l_y <= l_r * l_r )
+      {
+        p_mask->bits[( l_y + l_r ) * p_mask->stride + ( l_x + l_r ) / 32] |= 0x80000000u >> ( ( l_x + l_r ) % 32 );
+      }
+    }
+  }
+
+  /* All done. */
+  return true;
+}
+
+
+/*
+ * blitmask_free - hands a mask's bits back to the arena.
+ *
+ * blit_mask_t * - the mask.
+ */
+
+void blitmask_free( blit_mask_t *p_mask )
+{
+  blitarena_free( p_mask->bits );
+  memset( p_mask, 0, sizeof( blit_mask_t ) );
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * blitmask_point - whether a single pixel of a mask is set.
+ *
+ * const blit_mask_t * - the mask.
+ * int32_t             - the x position within the mask.
+ * int32_t             - the y position within the mask.
+ *
+ * Returns bool, true if the pixel is within the mask, and set.
+ */
+
+bool blitmask_point( const blit_mask_t *p_mask, int32_t p_x, int32_t p_y )
+{
+  if ( ( p_x < 0 ) || ( p_y < 0 ) || ( p_x >= p_mask->w ) || ( p_y >= p_mask->h ) )
+  {
+    return false;
+  }
+
+  return p_mask->bits[p_y * p_mask->stride + p_x / 32] & ( 0x80000000u >> ( p_x % 32 ) );
+}
+
+
+/*
+ * blitmask_fetch - reads 32 pixels of a mask row, starting anywhere; bits
+ *                  off either end of the row read as clear.
+ *
+ * const uint32_t * - the row.
+ * uint8_t          - the words in the row.
+ * int32_t          - the first pixel to read (which may be negative).
+ *
+ * Returns uint32_t, the pixels, first one in the top bit.
+ */
+
+static uint32_t blitmask_fetch( const uint32_t *p_row, uint8_t p_stride, int32_t p_start )
+{
+  int32_t   l_word, l_shift;
+  uint32_t  l_high, l_low;
+
+  /* Which word the first pixel is in (rounding down), and how far in. */
+  l_word = ( p_start >= 0 ) ? p_start / 32 : -( ( 31 - p_start ) / 32 );
+  l_shift = p_start - l_word * 32;
+
+  l_high = ( ( l_word >= 0 ) && ( l_word < p_stride ) ) ? p_row[l_word] : 0;
+  if ( 0 == l_shift )
+  {
+    return l_high;
+  }
+  l_low = ( ( l_word + 1 >= 0 ) && ( l_word + 1 < p_stride ) ) ? p_row[l_word + 1] : 0;
+
+  return ( l_high << l_shift ) | ( l_low >> ( 32 - l_shift ) );
+}
+
+
+/*
+ * blitmask_overlap - whether two masks have any set pixel in common. The
+ *                    second is lined up against each word of the first,
+ *                    and they're ANDed, over the rows they share.
+ *
+ * const blit_mask_t * - the first mask.
+ * const blit_mask_t * - the second mask.
+ * int32_t             - where the second mask's left edge is, relative
+ *                       to the first's.
+ * int32_t             - where the second mask's top edge is, relative to
+ *                       the first's.
+ *
+ * Returns bool, true if they overlap.
+ */
+
+bool blitmask_overlap( const blit_mask_t *p_first, const blit_mask_t *p_second, int32_t p_dx, int32_t p_dy )
+{
+  int32_t         l_x0, l_x1, l_y0, l_y1, l_y, l_word;
+  const uint32_t *l_first_row, *l_second_row;
+
+  /* Work out the area the two have in common. */
+  l_x0 = ( p_dx > 0 ) ? p_dx : 0;
+  l_y0 = ( p_dy > 0 ) ? p_dy : 0;
+  l_x1 = ( p_dx + p_second->w < p_first->w ) ? p_dx + p_second->w : p_first->w;
+  l_y1 = ( p_dy + p_second->h < p_first->h ) ? p_dy + p_second->h : p_first->h;
+  if ( ( l_x0 >= l_x1 ) || ( l_y0 >= l_y1 ) )
+  {
+    return false;
+  }
+
+  /* Then compare the words of the first that cover it, row by row. */
+  for ( l_y = l_y0; l_y < l_y1; l_y++ )
+  {
+    l_first_row = p_first->bits + l_y * p_first->stride;
+    l_second_row = p_second->bits + ( l_y - p_dy ) * p_second->stride;
+    for ( l_word = l_x0 / 32; l_word <= ( l_x1 - 1 ) / 32; l_word++ )
+    {
+      if ( l_first_row[l_word] & blitmask_fetch( l_second_row, p_second->stride, l_word * 32 - p_dx ) )
+      {
+        return true;
+      }
+    }
+  }
+
+  /* Nothing in common. */
+  return false;
+}
+
+
+/* End of file blitmask.cpp */
@@ -0,0 +1,53 @@
+/*
+ * blitmask.hpp - part of Blitroids, a 32Blit game.
+ *
+ * Collision masks; one bit per pixel, set where a sprite is solid, packed
+ * most significant bit first into 32 bit words, with each row starting on
+ * a fresh word. Two masks are tested against each other by shifting one
+ * row's words into line with the other's and ANDing them, so a 16 pixel
+ * wide sprite costs one AND per row, rather than a pixel read per pixel.
+ *
+ * Masks are built from a surface (honouring a blit() transform, so that
+ * each quarter turn of a sprite can have its own), or drawn as circles to
+ * match blit::Surface::circle(). Their bits live in the arena.
+ *
+ * Copyright (C) 2021 Pete Favelle <pete@fsquared.co.uk>
+ *
+ * This file is released under the MIT License; see LICENSE for more details.
+ */
+
+#ifndef   _BLITMASK_HPP_
+#define   _BLITMASK_HPP_
+
+#include "32blit.hpp"
+
+
+/* Constants & Macros. */
+
+/* Pixels at least this opaque count as solid. */
+#define BLITMASK_ALPHA      128
+
+
+/* Structs. */
+
+typedef struct
+{
+  uint8_t     w;
+  uint8_t     h;
+  uint8_t     stride;     /* 32 bit words per row. */
+  uint32_t   *bits;
+} blit_mask_t;
+
+
+/* Functions. */
+
+bool  blitmask_build( blit_mask_t *, const blit::Surface *, blit::Rect, uint8_t p_transform = 0 );
+bool  blitmask_circle( blit_mask_t *, uint8_t );
+void  blitmask_free( blit_mask_t * );
+bool  blitmask_point( const blit_mask_t *, int32_t, int32_t );
+bool  blitmask_overlap( const blit_mask_t *, const blit_mask_t *, int32_t, int32_t );
+
+
+#endif /* _BLITMASK_HPP_ */
+
+/* End of file blitmask.hpp */
@@ -0,0 +1,67 @@
+/*
+ * blitrandom.cpp - part of Blitroids, a 32Blit game.
+ *
+ * The game's own seedable random number source; see blitrandom.hpp.
+ *
+ * Copyright (C) 2021 Pete Favelle <pete@fsquared.co.uk>
+ *
+ * This file is released under the MIT License; see LICENSE for more details.
+ */
+
+/* Local headers. */
+
+#include "32blit.hpp"
+#include "blitrandom.hpp"
+
+
+/* Module variables. */
+
+static uint32_t   m_random_state = BLITRANDOM_DEFAULT;
+
+
+/* Functions. */
+
+/*
+ * blitrandom_seed - sets the generator's state, restarting its sequence.
+ *
+ * uint32_t - the new state; zero is replaced with BLITRANDOM_DEFAULT.
+ */
+
+void blitrandom_seed( uint32_t p_seed )
+{
+  m_random_state = ( 0 == p_seed ) ? BLITRANDOM_DEFAULT : p_seed;
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * blitrandom_state - fetches the generator's state, so that the sequence
+ *                    can be picked up again from here with blitrandom_seed.
+ *
+ * Returns uint32_t, the current state.
+ */
+
+uint32_t blitrandom_state( void )
+{
+  return m_random_state;
+}
+
+
+/*
+ * blitrandom - the next number in the sequence; a 13/17/5 xorshift.
+ *
+ * Returns uint32_t, the random number.
+ */
+
+uint32_t blitrandom( void )
+{
+  m_random_state ^= m_random_state << 13;
+  m_random_state ^= m_random_state >> 17;
+  m_random_state ^= m_random_state << 5;
+  return m_random_state;
+}
+
+
+/* End of file blitrandom.cpp */
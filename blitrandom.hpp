@@ -0,0 +1,36 @@
+/*
+ * blitrandom.hpp - part of Blitroids, a 32Blit game.
+ *
+ * The game's own random number source. blit::random() can't be seeded (on
+ * the handheld it's the hardware generator), so anything the simulation
+ * decides by chance comes from here instead; a small xorshift generator
+ * whose whole state is one 32 bit word. Setting that word back puts the
+ * sequence back exactly, which is what lets a recorded session be replayed.
+ *
+ * Copyright (C) 2021 Pete Favelle <pete@fsquared.co.uk>
+ *
+ * This file is released under the MIT License; see LICENSE for more details.
+ */
+
+#ifndef   _BLITRANDOM_HPP_
+#define   _BLITRANDOM_HPP_
+
+#include "32blit.hpp"
+
+
+/* Constants & Macros. */
+
+/* Xorshift never leaves zero, so a zero seed is swapped for this. */
+#define BLITRANDOM_DEFAULT  0x2545f491
+
+
+/* Functions. */
+
+void      blitrandom_seed( uint32_t );
+uint32_t  blitrandom_state( void );
+uint32_t  blitrandom( void );
+
+
+#endif /* _BLITRANDOM_HPP_ */
+
+/* End of file blitrandom.hpp */
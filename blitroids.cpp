@@ -17,26 +17,77 @@
 
 #include "32blit.hpp"
 #include "blitroids.hpp"
+#include "blitarena.hpp"
+#include "blitrandom.hpp"
+#include "blitjobs.hpp"
 
 #include "AssetManager.hpp"
 #include "OutputManager.hpp"
+#include "PerfManager.hpp"
 
 #include "StateInterface.hpp"
 #include "SplashState.hpp"
+#include "GameState.hpp"
 
 
 /* Module variables. */
 
 static state_t              m_state;
+static state_t              m_next_state;
 static StateInterface      *m_states[STATE_MAX];
 static AssetManager        *m_asset_manager;
 static OutputManager       *m_output_manager;
+static PerfManager         *m_perf_manager;
+static uint32_t             m_sim_time;
+static bool                 m_sim_started;
+
+/* Buttons pressed since the last step ran; only one step gets to see them. */
+static uint32_t             m_sim_pressed;
+
+/* Session recording and replay; records go through a small buffer, so */
+/* the log is only touched every REPLAY_BUFFER_TICKS ticks.            */
+static replay_mode_t        m_replay_mode;
+static blit::File           m_replay_file;
+static uint32_t             m_replay_offset;
+static replay_tick_t        m_replay_buffer[REPLAY_BUFFER_TICKS];
+static uint16_t             m_replay_count;
+static uint16_t             m_replay_next;
+static replay_tick_t        m_replay_tick;
+static uint32_t             m_replay_time;
+static uint32_t             m_replay_ticks;
+static uint32_t             m_replay_drift;
+
+static_assert( SIM_MAX_CATCHUP <= 4, "Replay records only have room to flag four steps a tick" );
 
 
 /* Functions. */
 
+/*
+ * blitroids_state_prepare - gives a state a slice of time to prepare itself,
+ *                           timed as part of its transition.
+ *
+ * state_t  - the state to prepare.
+ * uint32_t - how long it may take, in microseconds.
+ *
+ * Returns true if the state is ready to be initialised.
+ */
+
+bool blitroids_state_prepare( state_t p_state, uint32_t p_budget_us )
+{
+  /* A state that doesn't exist can't get any readier. */
+  if ( nullptr == m_states[p_state] )
+  {
+    return true;
+  }
+
+  PerfTimer l_timer( m_perf_manager, p_state, PERF_TRANSITION );
+  return m_states[p_state]->prepare( m_asset_manager, blit::now_us() + p_budget_us );
+}
+
+
 /*
  * state_init - calls the init function of the current state, if we can.
+ *              Any preparation it hasn't done yet is finished off first.
  *
  * state_t - the previous state we were in.
  *
@@ -54,9 +105,17 @@ bool blitroids_state_init( state_t p_last_state )
     return false;
   }
 
-  /* Then we can just call the init function! */
+  /* Finish any warming up it still needs; there's no time left to spread */
+  /* it over, so this is the only place a transition can still hitch.    */
+  while ( !blitroids_state_prepare( m_state, STATE_PREPARE_BUDGET_US ) );
+
+  /* Then we can just call the init function, timing it as a transition. */
+  PerfTimer l_timer( m_perf_manager, m_state, PERF_TRANSITION );
   m_states[m_state]->init( m_states[p_last_state], m_asset_manager, m_output_manager );
 
+  /* Keep an eye on how much of the arena each state needs. */
+  blitarena_report();
+
   /* Return true to say we were able to do it. */
   return true;
 }
@@ -78,7 +137,8 @@ bool blitroids_state_fini( state_t p_next_state )
     return false;
   }
 
-  /* Then we can just call the init function! */
+  /* Then we can just call the fini function, timing it as a transition. */
+  PerfTimer l_timer( m_perf_manager, m_state, PERF_TRANSITION );
   m_states[m_state]->fini( m_states[p_next_state] );
 
   /* Return true to say we were able to do it. */
@@ -86,6 +146,312 @@ bool blitroids_state_fini( state_t p_next_state )
 }
 
 
+/*
+ * blitroids_record - starts recording the session to a log, which can later
+ *                    be fed back through blitroids_replay(). The random
+ *                    source is seeded here, and the seed logged, so this has
+ *                    to be called before init() creates anything.
+ *
+ * const char * - the path of the log to write.
+ *
+ * Returns bool, true if recording has started.
+ */
+
+bool blitroids_record( const char *p_path )
+{
+  replay_header_t l_header;
+
+  /* Only one session at a time. */
+  if ( ( REPLAY_OFF != m_replay_mode ) || !m_replay_file.open( p_path, blit::OpenMode::write ) )
+  {
+    return false;
+  }
+
+  /* Pick a seed, and start the log with it. */
+  l_header.magic = REPLAY_MAGIC;
+  l_header.version = REPLAY_VERSION;
+  l_header.step_ms = SIM_STEP_MS;
+  l_header.seed = blit::random();
+  if ( m_replay_file.write( 0, sizeof( l_header ), (const char *)&l_header ) != sizeof( l_header ) )
+  {
+    m_replay_file.close();
+    return false;
+  }
+  blitrandom_seed( l_header.seed );
+
+  /* Records follow, a buffer at a time. */
+  m_replay_mode = REPLAY_RECORDING;
+  m_replay_offset = sizeof( l_header );
+  m_replay_count = 0;
+  m_replay_time = 0;
+  m_replay_ticks = 0;
+
+  /* All done. */
+  return true;
+}
+
+
+/*
+ * blitroids_replay - starts replaying a recorded log; from the next tick on,
+ *                    the log's clock, buttons and random state are used in
+ *                    place of the engine's, until it runs out. Like recording
+ *                    this has to start before init(), so that everything is
+ *                    created from the same seed.
+ *
+ * const char * - the path of the log to read.
+ *
+ * Returns bool, true if the replay has started.
+ */
+
+bool blitroids_replay( const char *p_path )
+{
+  replay_header_t l_header;
+
+  /* Only one session at a time. */
+  if ( ( REPLAY_OFF != m_replay_mode ) || !m_replay_file.open( p_path, blit::OpenMode::read ) )
+  {
+    return false;
+  }
+
+  /* The log has to be one of ours, recorded at our step size. */
+  if ( ( m_replay_file.read( 0, sizeof( l_header ), (char *)&l_header ) != sizeof( l_header ) ) ||
+       ( REPLAY_MAGIC != l_header.magic ) || ( REPLAY_VERSION != l_header.version ) ||
+       ( SIM_STEP_MS != l_header.step_ms ) )
+  {
+    debug_printf( "%s is not a replay we can play\n", p_path );
+    m_replay_file.close();
+    return false;
+  }
+  blitrandom_seed( l_header.seed );
+
+  /* Start from nothing held down, as the recording did. */
+  blit::buttons = 0;
+  memset( &m_replay_tick, 0, sizeof( replay_tick_t ) );
+
+  m_replay_mode = REPLAY_PLAYING;
+  m_replay_offset = sizeof( l_header );
+  m_replay_count = 0;
+  m_replay_next = 0;
+  m_replay_time = 0;
+  m_replay_ticks = 0;
+  m_replay_drift = 0;
+
+  /* All done. */
+  return true;
+}
+
+
+/*
+ * blitroids_replay_stop - ends any recording (writing out whatever is still
+ *                         buffered) or replay, and closes the log.
+ */
+
+void blitroids_replay_stop( void )
+{
+  if ( REPLAY_RECORDING == m_replay_mode )
+  {
+    m_replay_file.write( m_replay_offset, m_replay_count * sizeof( replay_tick_t ), (const char *)m_replay_buffer );
+    debug_printf( "Recorded %lu ticks\n", (unsigned long)m_replay_ticks );
+  }
+  if ( REPLAY_PLAYING == m_replay_mode )
+  {
+    /* Any drift means something random happened outside the log's reach. */
+    debug_printf( "Replayed %lu ticks, %lu of which had drifted\n",
+                  (unsigned long)m_replay_ticks, (unsigned long)m_replay_drift );
+  }
+
+  m_replay_file.close();
+  m_replay_mode = REPLAY_OFF;
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * blitroids_replaying - whether a replay is still running.
+ *
+ * Returns bool, true while ticks are being fed from a log.
+ */
+
+bool blitroids_replaying( void )
+{
+  return REPLAY_PLAYING == m_replay_mode;
+}
+
+
+/*
+ * blitroids_perf_manager - the PerfManager timing the states, so that the
+ *                          headless runner can report what it gathered.
+ *
+ * Returns PerfManager *, the manager, or nullptr before init() (or if the
+ *         arena had no room for it).
+ */
+
+PerfManager *blitroids_perf_manager( void )
+{
+  return m_perf_manager;
+}
+
+
+/*
+ * blitroids_pressed - the buttons pressed since the last simulation step;
+ *                     states should use this rather than buttons.pressed,
+ *                     which changes once a tick rather than once a step.
+ *                     A press is only seen by the first step to run after
+ *                     it, however many steps a tick runs (or doesn't).
+ *
+ * Returns uint32_t, the pressed buttons.
+ */
+
+uint32_t blitroids_pressed( void )
+{
+  return m_sim_pressed;
+}
+
+
+/*
+ * blitroids_invalidate - tells the current state that something else has
+ *                        drawn over the screen, so its next render must be
+ *                        a full one.
+ */
+
+void blitroids_invalidate( void )
+{
+  if ( nullptr != m_states[m_state] )
+  {
+    m_states[m_state]->invalidate();
+  }
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * blitroids_replay_begin - opens a tick. When recording, the tick's inputs
+ *                          are noted; when replaying, they're replaced by
+ *                          the next ones in the log. The random state is
+ *                          put back to the logged one every tick, and any
+ *                          difference is counted as drift.
+ *
+ * uint32_t * - the engine's time, replaced by the log's when replaying.
+ *
+ * Returns bool, false if the replay has just run out.
+ */
+
+static bool blitroids_replay_begin( uint32_t *p_time )
+{
+  uint32_t  l_elapsed;
+  int32_t   l_read;
+
+  if ( REPLAY_RECORDING == m_replay_mode )
+  {
+    l_elapsed = *p_time - m_replay_time;
+    m_replay_tick.seed = blitrandom_state();
+    m_replay_tick.elapsed = ( l_elapsed < UINT16_MAX ) ? l_elapsed : UINT16_MAX;
+    m_replay_tick.buttons = blit::buttons & REPLAY_BUTTONS;
+    m_replay_time = *p_time;
+  }
+
+  if ( REPLAY_PLAYING == m_replay_mode )
+  {
+    /* Refill the buffer from the log, when it's empty. */
+    if ( m_replay_next >= m_replay_count )
+    {
+      l_read = m_replay_file.read( m_replay_offset, sizeof( m_replay_buffer ), (char *)m_replay_buffer );
+      m_replay_count = ( l_read > 0 ) ? l_read / sizeof( replay_tick_t ) : 0;
+      m_replay_offset += m_replay_count * sizeof( replay_tick_t );
+      m_replay_next = 0;
+      if ( 0 == m_replay_count )
+      {
+        return false;
+      }
+    }
+
+    /* And take the next tick from it; the last tick's buttons go back in */
+    /* first, so that what counts as pressed matches the recording.       */
+    blit::buttons = m_replay_tick.buttons & REPLAY_BUTTONS;
+    m_replay_tick = m_replay_buffer[m_replay_next++];
+    m_replay_time += m_replay_tick.elapsed;
+    *p_time = m_replay_time;
+    blit::buttons = m_replay_tick.buttons & REPLAY_BUTTONS;
+    if ( blitrandom_state() != m_replay_tick.seed )
+    {
+      m_replay_drift++;
+      blitrandom_seed( m_replay_tick.seed );
+    }
+    m_replay_ticks++;
+  }
+
+  return true;
+}
+
+
+/*
+ * blitroids_replay_end - closes a tick; when recording, its record joins
+ *                        the buffer, which is written out when it fills.
+ */
+
+static void blitroids_replay_end( void )
+{
+  if ( REPLAY_RECORDING == m_replay_mode )
+  {
+    m_replay_buffer[m_replay_count++] = m_replay_tick;
+    m_replay_ticks++;
+    if ( REPLAY_BUFFER_TICKS == m_replay_count )
+    {
+      m_replay_file.write( m_replay_offset, sizeof( m_replay_buffer ), (const char *)m_replay_buffer );
+      m_replay_offset += sizeof( m_replay_buffer );
+      m_replay_count = 0;
+    }
+  }
+
+  /* All done. */
+  return;
+}
+
+
+/*
+ * blitroids_state_ready - gives the next state a slice to prepare in, and
+ *                         decides whether to switch to it on this step.
+ *                         Preparing is sliced by the clock, so a replay
+ *                         can't trust it to finish on the same step; the
+ *                         log says which steps switched, and a replay
+ *                         switches on exactly those, finishing off any
+ *                         preparation first.
+ *
+ * state_t - the state to prepare.
+ * uint8_t - which step of the current tick this is.
+ *
+ * Returns bool, true if we should switch to the state now.
+ */
+
+static bool blitroids_state_ready( state_t p_state, uint8_t p_step )
+{
+  bool  l_ready = blitroids_state_prepare( p_state, STATE_PREPARE_BUDGET_US );
+
+  if ( REPLAY_PLAYING == m_replay_mode )
+  {
+    if ( !( m_replay_tick.buttons & REPLAY_SWITCHED( p_step ) ) )
+    {
+      return false;
+    }
+    while ( !l_ready )
+    {
+      l_ready = blitroids_state_prepare( p_state, STATE_PREPARE_BUDGET_US );
+    }
+  }
+
+  if ( ( REPLAY_RECORDING == m_replay_mode ) && l_ready )
+  {
+    m_replay_tick.buttons |= REPLAY_SWITCHED( p_step );
+  }
+
+  return l_ready;
+}
+
+
 /* Blit API Entry Functions. */
 
 /*
@@ -94,8 +460,12 @@ bool blitroids_state_fini( state_t p_next_state )
 
 void init( void )
 {
-  /* We want to run in hi res mode. */
+  uint8_t   l_state;
+
+  /* We want to run in hi res mode; headless, the host has given us that. */
+#ifndef   BLITROIDS_HEADLESS
   blit::set_screen_mode( blit::ScreenMode::hires );
+#endif /* BLITROIDS_HEADLESS */
 
   /* Blank the screen to our traditional dark blue. */
   blit::screen.pen = blit::Pen( 0, 0, 50 );
@@ -107,15 +477,71 @@ void init( void )
     m_states[l_state_idx] = nullptr;
   }
 
-  /* Create our Managers, which will interface with assets and outputs. */
+  /* Sessions are recorded or replayed from the very start, if asked for; */
+  /* otherwise the game's random source is seeded afresh.                */
+#ifdef BLITROIDS_REPLAY
+  blitroids_replay( BLITROIDS_REPLAY );
+#endif /* BLITROIDS_REPLAY */
+#ifdef BLITROIDS_RECORD
+  blitroids_record( BLITROIDS_RECORD );
+#endif /* BLITROIDS_RECORD */
+  if ( REPLAY_OFF == m_replay_mode )
+  {
+    blitrandom_seed( blit::random() );
+  }
+
+  /* Start up the job system's workers; on the handheld, there are none. */
+  blitjobs_init( 0 );
+
+  /* Create our Managers, which will interface with assets and outputs; */
+  /* these, and the states, all live in the arena rather than the heap.  */
   m_asset_manager = new AssetManager();
   m_output_manager = new OutputManager();
+  m_perf_manager = new PerfManager();
+
+  /* Without the asset and output managers no state can do anything, so */
+  /* we go no further and the screen stays blank; the perf manager only  */
+  /* gathers timings, so the game can carry on without that one.         */
+  if ( ( nullptr == m_asset_manager ) || ( nullptr == m_output_manager ) )
+  {
+    debug_printf( "No room for the managers with %u bytes of the arena in use, so nothing can run\n", blitarena_used() );
+    m_state = STATE_SPLASH;
+    m_next_state = STATE_NONE;
+    return;
+  }
+  if ( nullptr == m_perf_manager )
+  {
+    debug_printf( "No room for the perf manager with %u bytes of the arena in use, so nothing is timed\n", blitarena_used() );
+  }
+
+  /* Report how much flash the image packing is saving us, for debugging. */
+  m_asset_manager->report_images();
+
+  /* And check the string table was laid out the same way the engine would; */
+  /* only desktop builds, as it means measuring every string at every boot.  */
+#ifndef   TARGET_32BLIT_HW
+  m_asset_manager->check_layouts();
+#endif /* TARGET_32BLIT_HW */
 
   /* And create all the individual state handlers. */
   m_states[STATE_SPLASH] = new SplashState( STATE_SPLASH );
+  m_states[STATE_GAME] = new GameState( STATE_GAME );
+
+  /* Any that couldn't get all they need from the arena are no use to us; */
+  /* without them, any transition into them is simply refused.           */
+  for ( l_state = STATE_NONE; l_state < STATE_MAX; l_state++ )
+  {
+    if ( ( nullptr != m_states[l_state] ) && !m_states[l_state]->usable() )
+    {
+      debug_printf( "State %d has no room in the arena, so is unavailable\n", l_state );
+      delete m_states[l_state];
+      m_states[l_state] = nullptr;
+    }
+  }
 
   /* Lastly, set our opening state to the splash. */
   m_state = STATE_SPLASH;
+  m_next_state = STATE_NONE;
   blitroids_state_init( STATE_NONE );
 
   /* All done. */
@@ -123,16 +549,93 @@ void init( void )
 }
 
 
+/*
+ * blitroids_step - advances the simulation by one fixed step; the current
+ *                  state is updated. Any transition it asks for waits until
+ *                  the new state has prepared itself, which it does a slice
+ *                  per step while the current state carries on running.
+ *
+ * uint32_t - the simulation time (in ms) at the end of this step.
+ * uint8_t  - which step of the current tick this is.
+ */
+
+void blitroids_step( uint32_t p_time, uint8_t p_step )
+{
+  state_t l_previous_state, l_next_state;
+
+  /*
+   * We just pass the update handling through to our current state,
+   * to keep the processing out of here as much as possible.
+   */
+  if ( nullptr != m_states[m_state] )
+  {
+    /* The handler tells us what state we should end up in. */
+    {
+      PerfTimer l_timer( m_perf_manager, m_state, PERF_UPDATE );
+      l_next_state = m_states[m_state]->update( p_time );
+    }
+
+    /* If it's changed (and it's valid), the new state starts preparing; */
+    /* the first request stands until the transition is made.            */
+    if ( ( STATE_NONE == m_next_state ) && ( l_next_state != m_state ) && 
+         ( nullptr != m_states[l_next_state] ) )
+    {
+      m_next_state = l_next_state;
+    }
+
+    /* Once it's ready, switch. */
+    if ( ( STATE_NONE != m_next_state ) && blitroids_state_ready( m_next_state, p_step ) )
+    {
+      /* Finish the current state, telling it what will be the new one. */
+      blitroids_state_fini( m_next_state );
+
+      /* Switch to the new one. */
+      l_previous_state = m_state;
+      m_state = m_next_state;
+      m_next_state = STATE_NONE;
+
+      /* And then initialise it. */
+      blitroids_state_init( l_previous_state );
+    }
+  }
+
+  /* All done. */
+  return;
+}
+
+
 /*
  * update - called every tick to update the internal state of the game. This
- *          is driven by the engine, and is called approximately every 10ms.
+ *          is driven by the engine, and is called approximately every 10ms;
+ *          we run the simulation in fixed steps of SIM_STEP_MS, however far
+ *          apart the engine calls us, up to SIM_MAX_CATCHUP steps at a time.
+ *          When replaying, the time and buttons come from the log instead.
  *
  * uint32_t - the elapsed time (in ms) since the game launched.
  */
 
 void update( uint32_t p_time )
 {
-  state_t l_previous_state, l_next_state;
+  state_t   l_previous_state;
+  uint8_t   l_steps;
+
+  /* Note down, or play back, this tick's inputs; once a replay runs out */
+  /* we go back to the engine's, restarting the clock from its time.    */
+  if ( !blitroids_replay_begin( &p_time ) )
+  {
+    blitroids_replay_stop();
+    m_sim_started = false;
+  }
+
+  /* Hold on to any presses until a step has run to see them. */
+  m_sim_pressed |= blit::buttons.pressed;
+
+  /* The first call just starts the simulation clock. */
+  if ( !m_sim_started )
+  {
+    m_sim_time = p_time - SIM_STEP_MS;
+    m_sim_started = true;
+  }
 
   /*
    * We'll check the main menu key outside of the normal state engine; if we're
@@ -143,38 +646,47 @@ void update( uint32_t p_time )
     /* So, tell the current state we're going into the menu. */
     blitroids_state_fini( STATE_MENU );
 
-    /* Switch into the menu state. */
+    /* Switch into the menu state, dropping any other transition. */
     l_previous_state = m_state;
     m_state = STATE_MENU;
+    m_next_state = STATE_NONE;
 
     /* And initialise the menu. */
     blitroids_state_init( l_previous_state );
   }
 
-  /*
-   * Now we just pass the update handling through to our current state,
-   * to keep the processing out of here as much as possible.
-   */
-  if ( nullptr != m_states[m_state] )
+  /* The joystick button toggles the performance overlay. */
+  if ( ( nullptr != m_perf_manager ) && ( blit::buttons.pressed & blit::Button::JOYSTICK ) )
   {
-    /* The handler tells us what state we should end up in. */
-    l_next_state = m_states[m_state]->update( p_time );
+    m_perf_manager->toggle_overlay();
 
-    /* If it's changed (and it's valid), then switch. */
-    if ( ( l_next_state != m_state ) && ( nullptr != m_states[l_next_state] ) )
+    /* Whichever way it went, the screen needs a full redraw. */
+    if ( nullptr != m_states[m_state] )
     {
-      /* Finish the current state, telling it what will be the new one. */
-      blitroids_state_fini( l_next_state );
+      m_states[m_state]->invalidate();
+    }
+  }
 
-      /* Switch to the new one. */
-      l_previous_state = m_state;
-      m_state = l_next_state;
+  /* Run as many whole steps as we're owed, within our catch-up budget. */
+  for ( l_steps = 0; ( p_time - m_sim_time >= SIM_STEP_MS ) && ( l_steps < SIM_MAX_CATCHUP ); l_steps++ )
+  {
+    m_sim_time += SIM_STEP_MS;
+    blitroids_step( m_sim_time, l_steps );
 
-      /* And then initialise it. */
-      blitroids_state_init( l_previous_state );
-    }
+    /* The presses have been seen; later steps mustn't act on them again. */
+    m_sim_pressed = 0;
+  }
+
+  /* If we're still behind, a slow tick would only cascade; let the */
+  /* simulation drop the lost time rather than chase it.           */
+  if ( p_time - m_sim_time >= SIM_STEP_MS )
+  {
+    m_sim_time = p_time - ( ( p_time - m_sim_time ) % SIM_STEP_MS );
   }
 
+  /* And the tick is complete. */
+  blitroids_replay_end();
+
   /* All done. */
   return;
 }
@@ -183,17 +695,50 @@ void update( uint32_t p_time )
 /*
  * render - called every frame to render the screen. This is driven by the 
  *          engine, and is called approximately every 20ms, although frames
- *          can be skipped if there isn't enough time.
+ *          can be skipped if there isn't enough time. The states are told
+ *          how far we are into the next simulation step, so that they can
+ *          interpolate motion between steps.
  *
  * uint32_t - the elapsed time (in ms) since the game launched.
  */
 
 void render( uint32_t p_time )
 {
+  float   l_alpha;
+
+  /* A replay runs to the log's clock, not the engine's. */
+  if ( REPLAY_PLAYING == m_replay_mode )
+  {
+    p_time = m_replay_time;
+  }
+
+  /* Work out how far between simulation steps we are. */
+  l_alpha = (float)( p_time - m_sim_time ) / SIM_STEP_MS;
+  l_alpha = ( l_alpha > 1.0f ) ? 1.0f : ( ( l_alpha < 0.0f ) ? 0.0f : l_alpha );
+
+  /* Keep track of any frames the engine had to skip. */
+  if ( nullptr != m_perf_manager )
+  {
+    m_perf_manager->frame( p_time );
+  }
+
   /* As with update(), we basically just hand this off to the states. */
   if ( nullptr != m_states[m_state] )
   {
-    m_states[m_state]->render( p_time );
+    /* The overlay is drawn over the state, so it can't trust the screen. */
+    if ( ( nullptr != m_perf_manager ) && m_perf_manager->overlay_enabled() )
+    {
+      m_states[m_state]->invalidate();
+    }
+
+    PerfTimer l_timer( m_perf_manager, m_state, PERF_RENDER );
+    m_states[m_state]->render_interpolated( p_time, l_alpha );
+  }
+
+  /* And then lay the performance overlay over the top, if wanted. */
+  if ( ( nullptr != m_perf_manager ) && m_perf_manager->overlay_enabled() )
+  {
+    m_perf_manager->render_overlay( m_state );
   }
 
   /* All done. */
@@ -12,12 +12,39 @@
 #ifndef   _BLITROIDS_HPP_
 #define   _BLITROIDS_HPP_
 
+#include "32blit.hpp"
+
+class PerfManager;
+
 
 /* Constants & Macros. */
 
 #define SAVE_SLOT_HISCORE 0
 #define SAVE_SLOT_OUTPUTS 1
 
+/* The fixed simulation step, and how many we'll run to catch up in a tick. */
+#ifndef   SIM_STEP_MS
+#define SIM_STEP_MS       10
+#endif /* SIM_STEP_MS */
+#ifndef   SIM_MAX_CATCHUP
+#define SIM_MAX_CATCHUP   4
+#endif /* SIM_MAX_CATCHUP */
+
+/* How long (in us) a step may spend preparing the next state, if pending. */
+#ifndef   STATE_PREPARE_BUDGET_US
+#define STATE_PREPARE_BUDGET_US 4000
+#endif /* STATE_PREPARE_BUDGET_US */
+
+/* Recorded sessions; a log is a header, and then a record for every tick. */
+#define REPLAY_MAGIC            0x4c505242    /* "BRPL", little endian. */
+#define REPLAY_VERSION          1
+#define REPLAY_BUFFER_TICKS     64
+
+/* A record's button word holds the buttons in its low bits, and a flag */
+/* above them for each step of the tick that switched state.            */
+#define REPLAY_BUTTONS          0x0fff
+#define REPLAY_SWITCHED(s)      ( 0x1000 << (s) )
+
 #define DEBUG 1
 #define debug_printf(fmt, ...) \
         do { if (DEBUG) fprintf(stderr, "%s(%d): " fmt, \
@@ -26,8 +53,57 @@
 
 /* Enums. */
 
+typedef enum
+{
+  REPLAY_OFF,
+  REPLAY_RECORDING,
+  REPLAY_PLAYING
+} replay_mode_t;
+
+
 /* Structs. */
 
+typedef struct
+{
+  uint32_t  magic;
+  uint16_t  version;
+  uint16_t  step_ms;
+  uint32_t  seed;       /* The random state before anything was created. */
+} replay_header_t;
+
+typedef struct
+{
+  uint32_t  seed;       /* The random state as the tick began.           */
+  uint16_t  elapsed;    /* Milliseconds since the previous tick.         */
+  uint16_t  buttons;    /* blit::buttons, and the steps that switched.   */
+} replay_tick_t;
+
+
+/* Functions. */
+
+bool      blitroids_record( const char * );
+bool      blitroids_replay( const char * );
+void      blitroids_replay_stop( void );
+bool      blitroids_replaying( void );
+PerfManager *blitroids_perf_manager( void );
+uint32_t  blitroids_pressed( void );
+void      blitroids_invalidate( void );
+
+
+/*
+ * deadline_passed - whether a deadline has been reached; the clock wraps,
+ *                   so it's the signed difference that counts.
+ *
+ * uint32_t - the deadline, in blit::now_us() terms.
+ *
+ * Returns bool, true once the deadline has passed.
+ */
+
+static inline bool deadline_passed( uint32_t p_deadline )
+{
+  return (int32_t)( blit::now_us() - p_deadline ) >= 0;
+}
+
 
 #endif /* _BLITROIDS_HPP_ */
 
@@ -0,0 +1,112 @@
+/*
+ * blitsprites.hpp - part of Blitroids, a 32Blit game.
+ *
+ * This defines how sprites are indexed within the spritesheet; the index
+ * itself (SpriteIndex.hpp) is generated from sprites.yml at build time, as
+ * a constexpr table, so looking up a sprite or picking an animation frame
+ * is just arithmetic on constants, and the whole table lives in flash.
+ *
+ * Copyright (C) 2021 Pete Favelle <pete@fsquared.co.uk>
+ *
+ * This file is released under the MIT License; see LICENSE for more details.
+ */
+
+#ifndef   _BLITSPRITES_HPP_
+#define   _BLITSPRITES_HPP_
+
+#include "32blit.hpp"
+
+
+/* Structs. */
+
+typedef struct
+{
+  uint16_t    x;
+  uint16_t    y;
+  uint8_t     w;
+  uint8_t     h;
+  int8_t      pivot_x;
+  int8_t      pivot_y;
+  uint8_t     radius;
+  uint8_t     frames;
+  uint8_t     columns;
+  uint8_t     rotations;
+} sprite_info_t;
+
+
+/* Tables. */
+
+/* The blit() transforms that turn a sprite through each quarter turn. */
+inline constexpr uint8_t g_sprite_quarter[4] =
+{
+  blit::SpriteTransform::NONE, blit::SpriteTransform::R90,
+  blit::SpriteTransform::R180, blit::SpriteTransform::R270
+};
+
+
+/* Functions. */
+
+/*
+ * sprite_frame_x / sprite_frame_y - where a frame of a sprite sits in the
+ *                                   sheet; frames run left to right, and
+ *                                   wrap every 'columns' frames.
+ */
+
+constexpr uint16_t sprite_frame_x( const sprite_info_t &p_sprite, uint8_t p_frame )
+{
+  return p_sprite.x + ( p_frame % p_sprite.frames % p_sprite.columns ) * p_sprite.w;
+}
+
+constexpr uint16_t sprite_frame_y( const sprite_info_t &p_sprite, uint8_t p_frame )
+{
+  return p_sprite.y + ( p_frame % p_sprite.frames / p_sprite.columns ) * p_sprite.h;
+}
+
+
+/*
+ * sprite_animate - picks the frame of an animation to show at a given time.
+ *
+ * const sprite_info_t & - the sprite.
+ * uint32_t              - the time, in milliseconds.
+ * uint16_t              - how long each frame is shown for, in milliseconds.
+ *
+ * Returns uint8_t, the frame.
+ */
+
+constexpr uint8_t sprite_animate( const sprite_info_t &p_sprite, uint32_t p_time, uint16_t p_frame_ms )
+{
+  return ( p_time / p_frame_ms ) % p_sprite.frames;
+}
+
+
+/*
+ * sprite_rotation - picks the nearest of a sprite's baked rotations to a
+ *                   heading; rotation 0 is the sprite as drawn, and they
+ *                   run clockwise from there.
+ *
+ * const sprite_info_t & - the sprite.
+ * uint16_t              - the heading, in degrees.
+ *
+ * Returns uint8_t, the rotation.
+ */
+
+constexpr uint8_t sprite_rotation( const sprite_info_t &p_sprite, uint16_t p_degrees )
+{
+  return p_sprite.rotations ? ( ( p_degrees % 360 ) * p_sprite.rotations + 180 ) / 360 % p_sprite.rotations : 0;
+}
+
+
+/*
+ * sprite_rect - the rect of a frame of a sprite, ready for blit().
+ */
+
+inline blit::Rect sprite_rect( const sprite_info_t &p_sprite, uint8_t p_frame )
+{
+  return blit::Rect( sprite_frame_x( p_sprite, p_frame ), sprite_frame_y( p_sprite, p_frame ),
+                     p_sprite.w, p_sprite.h );
+}
+
+
+#endif /* _BLITSPRITES_HPP_ */
+
+/* End of file blitsprites.hpp */
@@ -0,0 +1,122 @@
+/*
+ * blittrig.hpp - part of Blitroids, a 32Blit game.
+ *
+ * This provides sine and cosine lookup tables, generated at compile time,
+ * for anything that turns through a fixed number of steps; star headings,
+ * the ship, bullets and asteroids. The number of steps in a full circle is
+ * a template parameter, so each user can pick the resolution it needs and
+ * the table lives in flash, with no libm calls at runtime.
+ *
+ * Copyright (C) 2021 Pete Favelle <pete@fsquared.co.uk>
+ *
+ * This file is released under the MIT License; see LICENSE for more details.
+ */
+
+#ifndef   _BLITTRIG_HPP_
+#define   _BLITTRIG_HPP_
+
+#include "32blit.hpp"
+
+
+/* Constants & Macros. */
+
+#define TRIG_PI       3.14159265358979323846
+
+
+/* Functions. */
+
+/*
+ * trig_sine - a constexpr sine, good enough to build tables from; the angle
+ *             is folded into -pi/2 .. pi/2, where the series converges fast.
+ *
+ * double - the angle, in radians.
+ *
+ * Returns double, the sine of the angle.
+ */
+
+constexpr double trig_sine( double p_radians )
+{
+  double  l_term = 0.0, l_sum = 0.0;
+  int     l_index = 0;
+
+  /* Fold into -pi .. pi. */
+  while ( p_radians > TRIG_PI )
+  {
+    p_radians -= 2.0 * TRIG_PI;
+  }
+  while ( p_radians < -TRIG_PI )
+  {
+    p_radians += 2.0 * TRIG_PI;
+  }
+
+  /* And then into -pi/2 .. pi/2, since sin(pi - x) = sin(x). */
+  if ( p_radians > TRIG_PI / 2.0 )
+  {
+    p_radians = TRIG_PI - p_radians;
+  }
+  else if ( p_radians < -TRIG_PI / 2.0 )
+  {
+    p_radians = -TRIG_PI - p_radians;
+  }
+
+  /* Taylor series; a dozen terms is well past float precision here. */
+  l_term = l_sum = p_radians;
+  for ( l_index = 1; l_index < 12; l_index++ )
+  {
+    l_term *= -p_radians * p_radians / ( ( 2 * l_index ) * ( 2 * l_index + 1 ) );
+    l_sum += l_term;
+  }
+
+  return l_sum;
+}
+
+
+/* Classes. */
+
+/*
+ * TrigTable - sine and cosine for STEPS equal steps round a circle. The
+ *             cosine is just the sine a quarter turn on, so one table with
+ *             an extra quarter on the end serves both.
+ */
+
+template <uint16_t STEPS>
+class TrigTable
+{
+  static_assert( ( STEPS >= 4 ) && ( STEPS % 4 == 0 ), "TrigTable needs a whole number of quarter turns" );
+
+private:
+  float           c_sine[STEPS + STEPS / 4];
+
+public:
+  constexpr       TrigTable( void ) : c_sine()
+                  {
+                    for ( uint16_t l_index = 0; l_index < STEPS + STEPS / 4; l_index++ )
+                    {
+                      c_sine[l_index] = (float)trig_sine( 2.0 * TRIG_PI * l_index / STEPS );
+                    }
+                  };
+
+  constexpr float sin( uint16_t p_step ) const { return c_sine[p_step % STEPS]; };
+  constexpr float cos( uint16_t p_step ) const { return c_sine[p_step % STEPS + STEPS / 4]; };
+
+  /*
+   * vector - the vector of the given length, pointing straight down the
+   *          screen (0, length) and turned through the given steps; the
+   *          same as blit::Vec2::rotate(), without the sinf/cosf.
+   */
+  blit::Vec2      vector( uint16_t p_step, float p_length ) const
+                  {
+                    return blit::Vec2( -sin( p_step ) * p_length, cos( p_step ) * p_length );
+                  };
+};
+
+
+/* Tables. */
+
+/* A table in whole degrees, for general use. */
+inline constexpr TrigTable<360> g_trig_degrees;
+
+
+#endif /* _BLITTRIG_HPP_ */
+
+/* End of file blittrig.hpp */
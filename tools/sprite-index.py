@@ -0,0 +1,130 @@
+#!/usr/bin/env python3
+#
+# sprite-index.py - part of Blitroids, a 32Blit game.
+#
+# Reads sprites.yml and writes SpriteIndex.hpp; an enum naming every sprite,
+# and a constexpr table of where each one sits in the spritesheet, along
+# with its pivot, collision radius, frames and baked rotations. Everything
+# is checked against the size of the sheet, so a bad rect fails the build
+# rather than the game.
+#
+# Usage: sprite-index.py <sprites.yml> <SpriteIndex.hpp>
+#
+# Copyright (C) 2021 Pete Favelle <pete@fsquared.co.uk>
+#
+# This file is released under the MIT License; see LICENSE for more details.
+
+import os
+import struct
+import sys
+
+import yaml
+
+
+def sheet_size(path):
+    """Fetches the width and height of a PNG, straight from its header."""
+    with open(path, 'rb') as png:
+        header = png.read(24)
+    if header[:8] != b'\x89PNG\r\n\x1a\n' or header[12:16] != b'IHDR':
+        sys.exit('{}: not a PNG'.format(path))
+    return struct.unpack('>II', header[16:24])
+
+
+def sprite_entry(name, sprite, sheet_w, sheet_h):
+    """Works out, and checks, the index entry for a single sprite."""
+    try:
+        x, y, w, h = (int(v) for v in sprite['rect'])
+    except (KeyError, TypeError, ValueError):
+        sys.exit('{}: needs a rect of [x, y, w, h]'.format(name))
+
+    frames = int(sprite.get('frames', 1))
+    columns = int(sprite.get('columns', frames))
+    pivot_x, pivot_y = (int(v) for v in sprite.get('pivot', [w // 2, h // 2]))
+    radius = int(sprite.get('radius', min(w, h) // 2))
+    rotations = int(sprite.get('rotations', 0))
+
+    if w <= 0 or h <= 0 or w > 255 or h > 255:
+        sys.exit('{}: frame size must be 1-255 pixels'.format(name))
+    if frames < 1 or frames > 255 or columns < 1 or columns > frames:
+        sys.exit('{}: bad frames / columns'.format(name))
+    if not (-128 <= pivot_x < 128 and -128 <= pivot_y < 128) or not 0 <= radius < 256:
+        sys.exit('{}: pivot or radius out of range'.format(name))
+    if not 0 <= rotations < 256:
+        sys.exit('{}: rotations must be 0-255'.format(name))
+
+    rows = (frames + columns - 1) // columns
+    if x < 0 or y < 0 or x + w * columns > sheet_w or y + h * rows > sheet_h:
+        sys.exit('{}: frames run off the {}x{} sheet'.format(name, sheet_w, sheet_h))
+
+    return (x, y, w, h, pivot_x, pivot_y, radius, frames, columns, rotations)
+
+
+def main():
+    if len(sys.argv) != 3:
+        sys.exit('usage: {} <sprites.yml> <SpriteIndex.hpp>'.format(sys.argv[0]))
+
+    with open(sys.argv[1]) as source:
+        config = yaml.safe_load(source)
+
+    sheet = os.path.join(os.path.dirname(os.path.abspath(sys.argv[1])), config['sheet'])
+    sheet_w, sheet_h = sheet_size(sheet)
+
+    names = list(config.get('sprites') or {})
+    entries = [sprite_entry(n, config['sprites'][n], sheet_w, sheet_h) for n in names]
+
+    lines = [
+        '/*',
+        ' * SpriteIndex.hpp - generated from {} by sprite-index.py; do not edit.'.format(
+            os.path.basename(sys.argv[1])),
+        ' */',
+        '',
+        '#ifndef   _SPRITEINDEX_HPP_',
+        '#define   _SPRITEINDEX_HPP_',
+        '',
+        '#include "blitsprites.hpp"',
+        '',
+        '',
+        '/* Enums. */',
+        '',
+        'typedef enum',
+        '{',
+    ]
+    lines += ['  SPRITE_{},'.format(n.upper()) for n in names]
+    lines += [
+        '  SPRITE_MAX',
+        '} sprite_t;',
+        '',
+        '',
+        '/* Tables. */',
+        '',
+        '/* x, y, w, h, pivot x, pivot y, radius, frames, columns, rotations */',
+        'inline constexpr sprite_info_t g_sprite_index[SPRITE_MAX + 1] =',
+        '{',
+    ]
+    lines += ['  {{ {}, {}, {}, {}, {}, {}, {}, {}, {}, {} }},   /* {} */'.format(*e, n)
+              for n, e in zip(names, entries)]
+    lines += [
+        '  { 0, 0, 0, 0, 0, 0, 0, 1, 1, 0 }',
+        '};',
+        '',
+        '',
+        '#endif /* _SPRITEINDEX_HPP_ */',
+        '',
+        '/* End of file SpriteIndex.hpp */',
+        '',
+    ]
+
+    # Only touch the output if it has changed, to save needless rebuilds.
+    text = '\n'.join(lines)
+    try:
+        with open(sys.argv[2]) as existing:
+            if existing.read() == text:
+                return
+    except OSError:
+        pass
+    with open(sys.argv[2], 'w') as output:
+        output.write(text)
+
+
+if __name__ == '__main__':
+    main()
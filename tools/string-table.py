@@ -0,0 +1,338 @@
+#!/usr/bin/env python3
+#
+# string-table.py - part of Blitroids, a 32Blit game.
+#
+# Compiles the translations in strings/<code>.yml into blitstrings.hpp and
+# blitstrings.cpp; the string ids and languages as enums, the global string
+# table, and the layout of every string in every font listed in assets.yml,
+# so nothing needs measuring at runtime. Strings with a wrap width are broken
+# into lines here too, the same way the engine's wrap_text() would.
+#
+# Usage: string-table.py <strings dir> <assets.yml> <output dir>
+#
+# Copyright (C) 2021 Pete Favelle <pete@fsquared.co.uk>
+#
+# This file is released under the MIT License; see LICENSE for more details.
+
+import glob
+import os
+import struct
+import sys
+import zlib
+
+import yaml
+
+
+# Image fonts hold the printable ASCII characters, in a single row.
+FONT_FIRST_CHAR = 32
+FONT_NUM_CHARS = 96
+
+PRIMARY_LANGUAGE = 'en'
+
+
+def read_png(path):
+    """Decodes a (non-interlaced, 8 bit) PNG; returns width, height and a
+    function telling us whether a pixel is lit."""
+    with open(path, 'rb') as png:
+        data = png.read()
+    if data[:8] != b'\x89PNG\r\n\x1a\n':
+        sys.exit('{}: not a PNG'.format(path))
+
+    pos, idat, palette, trns = 8, b'', None, None
+    while pos < len(data):
+        length, kind = struct.unpack('>I4s', data[pos:pos + 8])
+        chunk = data[pos + 8:pos + 8 + length]
+        if kind == b'IHDR':
+            width, height, depth, colour, _, _, interlace = struct.unpack('>IIBBBBB', chunk)
+        elif kind == b'PLTE':
+            palette = chunk
+        elif kind == b'tRNS':
+            trns = chunk
+        elif kind == b'IDAT':
+            idat += chunk
+        pos += 12 + length
+
+    channels = {0: 1, 2: 3, 3: 1, 4: 2, 6: 4}.get(colour)
+    if depth != 8 or interlace != 0 or channels is None:
+        sys.exit('{}: only 8 bit, non-interlaced PNGs are supported'.format(path))
+
+    # Undo the per-row filters.
+    raw, stride = zlib.decompress(idat), width * channels
+    rows, prev, offset = [], bytearray(stride), 0
+    for _ in range(height):
+        kind, line = raw[offset], bytearray(raw[offset + 1:offset + 1 + stride])
+        offset += 1 + stride
+        for x in range(stride):
+            a = line[x - channels] if x >= channels else 0
+            b = prev[x]
+            c = prev[x - channels] if x >= channels else 0
+            if kind == 1:
+                line[x] = (line[x] + a) & 255
+            elif kind == 2:
+                line[x] = (line[x] + b) & 255
+            elif kind == 3:
+                line[x] = (line[x] + (a + b) // 2) & 255
+            elif kind == 4:
+                p = a + b - c
+                pa, pb, pc = abs(p - a), abs(p - b), abs(p - c)
+                line[x] = (line[x] + (a if pa <= pb and pa <= pc else b if pb <= pc else c)) & 255
+        rows.append(line)
+        prev = line
+
+    # Transparent pixels are unlit; so are black ones, in opaque images.
+    def lit(x, y):
+        pixel = rows[y][x * channels:(x + 1) * channels]
+        if colour == 6 or colour == 4:
+            return pixel[-1] > 0
+        if colour == 3:
+            alpha = trns[pixel[0]] if trns and pixel[0] < len(trns) else 255
+            return alpha > 0 and any(palette[pixel[0] * 3:pixel[0] * 3 + 3])
+        return any(pixel)
+
+    return width, height, lit
+
+
+class Font:
+    """The metrics of an image font, as the asset tool builds it."""
+
+    def __init__(self, name, path, options):
+        width, height, lit = read_png(path)
+        self.name = name
+        self.char_w = int(options.get('width', width // FONT_NUM_CHARS))
+        self.char_h = int(options.get('height', height))
+        self.spacing_x = int(options.get('horizontal_spacing', 1))
+        self.spacing_y = int(options.get('vertical_spacing', 1))
+
+        # Each character is as wide as its rightmost lit column, bar space.
+        self.widths = []
+        for char in range(FONT_NUM_CHARS):
+            used = [x for x in range(self.char_w) for y in range(self.char_h)
+                    if lit(char * self.char_w + x, y)]
+            self.widths.append(max(used) + 1 if used else 0)
+        self.widths[0] = int(options.get('space_width', self.widths[0] or self.char_w))
+
+    def line_width(self, line):
+        """The width of a single line of text."""
+        width = 0
+        for char in line:
+            index = ord(char) - FONT_FIRST_CHAR
+            if 0 <= index < FONT_NUM_CHARS:
+                width += self.widths[index] + self.spacing_x
+        return width
+
+    def wrap(self, text, limit):
+        """Breaks text into lines no wider than the limit, on spaces."""
+        lines = []
+        for paragraph in text.split('\n'):
+            line = ''
+            for word in paragraph.split(' '):
+                candidate = word if not line else line + ' ' + word
+                if line and self.line_width(candidate) > limit:
+                    lines.append(line)
+                    line = word
+                else:
+                    line = candidate
+            lines.append(line)
+        return '\n'.join(lines)
+
+    def layout(self, text, wrap):
+        """Returns the (possibly wrapped) text, its width, height and lines."""
+        if wrap:
+            text = self.wrap(text, wrap)
+        lines = text.split('\n')
+        width = max(self.line_width(line) for line in lines)
+        height = len(lines) * self.char_h + (len(lines) - 1) * self.spacing_y
+        return text, width, height, len(lines)
+
+
+def load_fonts(assets_path):
+    """Finds every image font in assets.yml."""
+    with open(assets_path) as source:
+        assets = yaml.safe_load(source)
+    base = os.path.dirname(os.path.abspath(assets_path))
+
+    fonts = []
+    for output in (assets or {}).values():
+        if not isinstance(output, dict):
+            continue
+        for path, options in output.items():
+            if isinstance(options, dict) and options.get('type') == 'font/image':
+                fonts.append(Font(options.get('name', os.path.splitext(os.path.basename(path))[0]),
+                                  os.path.join(base, path), options))
+    return fonts
+
+
+def parse_string(language, name, value):
+    """Splits a string entry into its desktop and hardware text, and wrap."""
+    if isinstance(value, dict):
+        if 'text' not in value:
+            sys.exit('{}: {} needs some text'.format(language, name))
+        text, wrap = str(value['text']), int(value.get('wrap', 0))
+        return text, str(value.get('hw', text)), wrap
+    return str(value), str(value), 0
+
+
+def load_languages(strings_dir):
+    """Loads every language, primary first; returns the ids and languages."""
+    paths = sorted(glob.glob(os.path.join(strings_dir, '*.yml')))
+    codes = [os.path.splitext(os.path.basename(p))[0] for p in paths]
+    if PRIMARY_LANGUAGE not in codes:
+        sys.exit('{}: no {}.yml'.format(strings_dir, PRIMARY_LANGUAGE))
+    codes.remove(PRIMARY_LANGUAGE)
+    codes.insert(0, PRIMARY_LANGUAGE)
+
+    languages = []
+    for code in codes:
+        with open(os.path.join(strings_dir, code + '.yml')) as source:
+            languages.append((code, yaml.safe_load(source) or {}))
+
+    names = list(languages[0][1])
+    for code, strings in languages[1:]:
+        for name in strings:
+            if name not in names:
+                sys.exit('{}: {} is not in {}.yml'.format(code, name, PRIMARY_LANGUAGE))
+
+    # Untranslated strings fall back to the primary language.
+    table = []
+    for code, strings in languages:
+        table.append((code, [parse_string(code, n, strings.get(n, languages[0][1][n])) for n in names]))
+    return names, table
+
+
+def c_string(text):
+    """Quotes text as a C string literal."""
+    escaped = text.replace('\\', '\\\\').replace('"', '\\"').replace('\n', '\\n')
+    return '"{}"'.format(escaped)
+
+
+def string_tables(names, table, fonts, variant):
+    """The string and layout tables for one platform; variant 0 is desktop,
+    variant 1 the hardware."""
+    lines = ['const char *g_blit_string[LANG_MAX][STR_MAX] = {', '']
+    for code, strings in table:
+        lines += ['  /* LANG_{} */'.format(code.upper()), '  {']
+        lines += ['    {},'.format(c_string(s[variant])) for s in strings]
+        lines += ['  },', '']
+    lines += ['};', '']
+
+    lines += ['const blit_layout_t g_blit_layout[FONT_MAX][LANG_MAX][STR_MAX] = {', '']
+    for font in fonts:
+        lines += ['  /* FONT_{} */'.format(font.name.upper()), '  {']
+        for code, strings in table:
+            lines += ['    /* LANG_{} */'.format(code.upper()), '    {']
+            for name, string in zip(names, strings):
+                text, width, height, count = font.layout(string[variant], string[2])
+                lines.append('      {{ {}, {}, {}, {} }},   /* STR_{} */'.format(
+                    c_string(text), width, height, count, name.upper()))
+            lines += ['    },']
+        lines += ['  },', '']
+    lines += ['};', '']
+    return lines
+
+
+def write_if_changed(path, lines):
+    """Only touch the output if it has changed, to save needless rebuilds."""
+    text = '\n'.join(lines)
+    try:
+        with open(path) as existing:
+            if existing.read() == text:
+                return
+    except OSError:
+        pass
+    with open(path, 'w') as output:
+        output.write(text)
+
+
+def main():
+    if len(sys.argv) != 4:
+        sys.exit('usage: {} <strings dir> <assets.yml> <output dir>'.format(sys.argv[0]))
+
+    names, table = load_languages(sys.argv[1])
+    fonts = load_fonts(sys.argv[2])
+    for font in fonts:
+        for code, strings in table:
+            for name, string in zip(names, strings):
+                for char in string[0] + string[1]:
+                    if char != '\n' and not 0 <= ord(char) - FONT_FIRST_CHAR < FONT_NUM_CHARS:
+                        print('warning: {} {} has {!r}, which {} cannot draw'.format(
+                              code, name, char, font.name), file=sys.stderr)
+
+    header = [
+        '/*',
+        ' * blitstrings.hpp - generated from strings/ by string-table.py; do not edit.',
+        ' *',
+        ' * This defines all the strings displayed to the user, in every language,',
+        ' * along with their layout in every font; the width and height they take',
+        ' * up, and the text broken into lines if it needs wrapping.',
+        ' */',
+        '',
+        '#ifndef   _BLITSTRINGS_HPP_',
+        '#define   _BLITSTRINGS_HPP_',
+        '',
+        '#include <stdint.h>',
+        '',
+        '',
+        '/* Enums. */',
+        '',
+        'typedef enum',
+        '{',
+    ]
+    header += ['  STR_{},'.format(n.upper()) for n in names]
+    header += ['  STR_MAX', '} blit_string_t;', '', 'typedef enum', '{']
+    header += ['  LANG_{},'.format(code.upper()) for code, _ in table]
+    header += ['  LANG_MAX', '} blit_lang_t;', '', 'typedef enum', '{']
+    header += ['  FONT_{},'.format(font.name.upper()) for font in fonts]
+    header += [
+        '  FONT_MAX',
+        '} blit_font_t;',
+        '',
+        '',
+        '/* Structs. */',
+        '',
+        'typedef struct',
+        '{',
+        '  const char   *text;',
+        '  uint16_t      width;',
+        '  uint16_t      height;',
+        '  uint8_t       lines;',
+        '} blit_layout_t;',
+        '',
+        '',
+        '/* The global string and layout lookup arrays. */',
+        '',
+        'extern const char *g_blit_string[LANG_MAX][STR_MAX];',
+        'extern const blit_layout_t g_blit_layout[FONT_MAX][LANG_MAX][STR_MAX];',
+        '',
+        '',
+        '#endif /* _BLITSTRINGS_HPP_ */',
+        '',
+        '/* End of file blitstrings.hpp */',
+        '',
+    ]
+
+    source = [
+        '/*',
+        ' * blitstrings.cpp - generated from strings/ by string-table.py; do not edit.',
+        ' */',
+        '',
+        '#include "blitstrings.hpp"',
+        '',
+        '/* The global string and layout lookup arrays. */',
+        '',
+    ]
+    desktop = string_tables(names, table, fonts, 0)
+    hardware = string_tables(names, table, fonts, 1)
+    if desktop == hardware:
+        source += desktop
+    else:
+        source += ['#ifdef    TARGET_32BLIT_HW', ''] + hardware
+        source += ['#else  /* TARGET_32BLIT_HW */', ''] + desktop
+        source += ['#endif /* TARGET_32BLIT_HW */', '']
+    source += ['', '/* End of file blitstrings.cpp */', '']
+
+    write_if_changed(os.path.join(sys.argv[3], 'blitstrings.hpp'), header)
+    write_if_changed(os.path.join(sys.argv[3], 'blitstrings.cpp'), source)
+
+
+if __name__ == '__main__':
+    main()